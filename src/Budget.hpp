@@ -0,0 +1,161 @@
+#ifndef SPROUT_BUDGET_HEADER
+#define SPROUT_BUDGET_HEADER
+
+#include <chrono>
+
+namespace sprout {
+
+/**
+ * Whether a parse stayed within its Budget, or which limit it exceeded.
+ */
+enum class BudgetStatus
+{
+    Within,
+    StepsExceeded,
+    DeadlineExceeded,
+    DepthExceeded
+};
+
+/**
+ * \brief Limits how much work a single parse may do.
+ *
+ * A budget limits the number of rule invocations, the time the parse may
+ * take, and how deeply rules may recurse. Rules that are wrapped by Limit
+ * count against it, which the grammar does for every named rule. Once any
+ * limit is exceeded, every limited rule fails without running, so the parse
+ * unwinds quickly, and status() says which limit was exceeded.
+ *
+ * Rules that fail because of the budget look like any other failure, so an
+ * optional rule may still let the parse match. The results of a parse that
+ * exceeded its budget must be discarded, so check status() afterwards.
+ *
+ * The deadline is only checked every few hundred steps, so a parse may run
+ * briefly past it. Limits that aren't set are unlimited.
+ */
+class Budget
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+private:
+    static const long CLOCK_INTERVAL = 256;
+
+    long _maxSteps;
+    int _maxDepth;
+    bool _hasDeadline;
+    Clock::time_point _deadline;
+
+    long _steps;
+    int _depth;
+    BudgetStatus _status;
+
+public:
+    Budget() :
+        _maxSteps(-1),
+        _maxDepth(-1),
+        _hasDeadline(false),
+        _steps(0),
+        _depth(0),
+        _status(BudgetStatus::Within)
+    {
+    }
+
+    /**
+     * Sets the maximum number of rule invocations, or -1 for no limit.
+     */
+    void setMaxSteps(const long steps)
+    {
+        _maxSteps = steps;
+    }
+
+    /**
+     * Sets how many limited rules may be running at once, or -1 for no limit.
+     */
+    void setMaxDepth(const int depth)
+    {
+        _maxDepth = depth;
+    }
+
+    void setDeadline(const Clock::time_point& deadline)
+    {
+        _hasDeadline = true;
+        _deadline = deadline;
+    }
+
+    /**
+     * Sets the deadline to the duration from now.
+     */
+    template <class Duration>
+    void setTimeout(const Duration& timeout)
+    {
+        setDeadline(Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout));
+    }
+
+    /**
+     * Counts a rule invocation, returning whether it may run. Rules that may
+     * run must call exit() when they finish.
+     */
+    bool enter()
+    {
+        if (_status != BudgetStatus::Within) {
+            return false;
+        }
+        ++_steps;
+        if (_maxSteps >= 0 && _steps > _maxSteps) {
+            _status = BudgetStatus::StepsExceeded;
+            return false;
+        }
+        if (_maxDepth >= 0 && _depth >= _maxDepth) {
+            _status = BudgetStatus::DepthExceeded;
+            return false;
+        }
+        if (_hasDeadline && _steps % CLOCK_INTERVAL == 1 && Clock::now() > _deadline) {
+            _status = BudgetStatus::DeadlineExceeded;
+            return false;
+        }
+        ++_depth;
+        return true;
+    }
+
+    void exit()
+    {
+        --_depth;
+    }
+
+    BudgetStatus status() const
+    {
+        return _status;
+    }
+
+    bool exceeded() const
+    {
+        return _status != BudgetStatus::Within;
+    }
+
+    long steps() const
+    {
+        return _steps;
+    }
+
+    int depth() const
+    {
+        return _depth;
+    }
+
+    /**
+     * Resets what was spent, so the budget can be used for another parse. The
+     * limits, including the deadline, are kept.
+     */
+    void reset()
+    {
+        _steps = 0;
+        _depth = 0;
+        _status = BudgetStatus::Within;
+    }
+};
+
+} // namespace sprout
+
+#endif // SPROUT_BUDGET_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
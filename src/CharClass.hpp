@@ -0,0 +1,117 @@
+#ifndef SPROUT_CHARCLASS_HEADER
+#define SPROUT_CHARCLASS_HEADER
+
+#include <QChar>
+
+#include <functional>
+#include <type_traits>
+
+namespace sprout {
+
+/**
+ * \brief A set of characters, which tests ASCII characters with a single bit.
+ *
+ * The class is built from a predicate, which is evaluated once for every ASCII
+ * character to fill a 128-bit table. Only characters outside of ASCII call the
+ * predicate, so the Unicode-aware QChar tests are only paid for where they're
+ * needed.
+ *
+ * A CharClass can be used wherever a predicate on a QChar is expected, such as
+ * with rule::simplePredicate or Grammar::setCharClass.
+ */
+class CharClass
+{
+public:
+    typedef std::function<bool(const QChar&)> Fallback;
+
+private:
+    quint64 _ascii[2];
+    Fallback _fallback;
+
+    void set(const ushort code)
+    {
+        _ascii[code >> 6] |= quint64(1) << (code & 63);
+    }
+
+public:
+    /**
+     * Constructs an empty class.
+     */
+    CharClass() :
+        _ascii()
+    {
+    }
+
+    template <
+        class Predicate,
+        class = typename std::enable_if<
+            !std::is_same<typename std::decay<Predicate>::type, CharClass>::value
+        >::type
+    >
+    CharClass(const Predicate& predicate) :
+        _ascii(),
+        _fallback(predicate)
+    {
+        for (ushort code = 0; code < 128; ++code) {
+            if (predicate(QChar(code))) {
+                set(code);
+            }
+        }
+    }
+
+    /**
+     * Returns a copy of this class that also contains the character.
+     */
+    CharClass with(const QChar& c) const
+    {
+        CharClass added(*this);
+        if (c.unicode() < 128) {
+            added.set(c.unicode());
+            return added;
+        }
+        auto fallback = _fallback;
+        added._fallback = [fallback, c](const QChar& input) {
+            return input == c || (fallback && fallback(input));
+        };
+        return added;
+    }
+
+    bool operator()(const QChar& c) const
+    {
+        const ushort code = c.unicode();
+        if (code < 128) {
+            return (_ascii[code >> 6] >> (code & 63)) & 1;
+        }
+        return _fallback && _fallback(c);
+    }
+
+    static const CharClass& letter()
+    {
+        static const CharClass letters([](const QChar& c) {
+            return c.isLetter();
+        });
+        return letters;
+    }
+
+    static const CharClass& letterOrNumber()
+    {
+        static const CharClass lettersOrNumbers([](const QChar& c) {
+            return c.isLetterOrNumber();
+        });
+        return lettersOrNumbers;
+    }
+
+    static const CharClass& space()
+    {
+        static const CharClass spaces([](const QChar& c) {
+            return c.isSpace();
+        });
+        return spaces;
+    }
+};
+
+} // namespace sprout
+
+#endif // SPROUT_CHARCLASS_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
@@ -1,23 +1,230 @@
 #ifndef SPROUT_CURSOR_HEADER
 #define SPROUT_CURSOR_HEADER
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 #include <memory>
 #include <cstring>
+#include <deque>
+#include <utility>
+#include <vector>
 
 #include "StreamIterator.hpp"
+#include "Failure.hpp"
+#include "Budget.hpp"
 
 namespace sprout {
 
+class StructuralIndex;
+
 template <class Data>
 class CursorData
 {
+    // Pairs of positions, ordered by the first of each pair
+    typedef std::deque<std::pair<int, int>> Runs;
+
+    // The runs of trivia that the skipper skipped, as pairs of where each
+    // run started and ended
+    const void* _skipper = nullptr;
+    Runs _skipped;
+
+    // The tokens that were read, as pairs of the position after each token
+    // and its trivia, and where the token itself ended
+    Runs _tokenEnds;
+
+    Failure _failure;
+
+    bool _cut = false;
+
+    Budget* _budget = nullptr;
+
+    static int findRun(const Runs& runs, const int from)
+    {
+        if (runs.empty()) {
+            return -1;
+        }
+        if (runs.back().first == from) {
+            return runs.back().second;
+        }
+        auto run = std::lower_bound(runs.begin(), runs.end(), std::make_pair(from, -1));
+        return run != runs.end() && run->first == from ? run->second : -1;
+    }
+
+    static void recordRun(Runs& runs, const int from, const int to)
+    {
+        // Parsers mostly move forward, so runs are usually recorded in order
+        if (runs.empty() || runs.back().first < from) {
+            runs.emplace_back(from, to);
+            return;
+        }
+        auto run = std::lower_bound(runs.begin(), runs.end(), std::make_pair(from, -1));
+        if (run != runs.end() && run->first == from) {
+            run->second = to;
+        } else {
+            runs.insert(run, std::make_pair(from, to));
+        }
+    }
+
+    static void forgetRunsBefore(Runs& runs, const int pos)
+    {
+        while (!runs.empty() && runs.front().first < pos) {
+            runs.pop_front();
+        }
+    }
+
 public:
     virtual Data get(int pos)=0;
     virtual bool atEnd()=0;
     virtual void advanceTo(int pos)=0;
     virtual int head() const=0;
+
+    /**
+     * Returns the structural index of the data, whose positions are those of
+     * the data, or nullptr if the data isn't indexed.
+     */
+    virtual const StructuralIndex* index() const
+    {
+        return nullptr;
+    }
+
+    /**
+     * Returns all of the elements, up to the head, if they are contiguous in
+     * memory and never move, or nullptr otherwise.
+     */
+    virtual const Data* contiguous() const
+    {
+        return nullptr;
+    }
+
+    /**
+     * Returns where the trivia that the skipper skipped from the position
+     * ended, or -1 if that isn't known.
+     */
+    int skipped(const void* skipper, const int pos) const
+    {
+        return skipper == _skipper ? findRun(_skipped, pos) : -1;
+    }
+
+    /**
+     * Records the trivia that the skipper skipped. Every run is kept until
+     * the data before it is discarded, so backtracking over any number of
+     * tokens never skips the same trivia twice. Only the most recent skipper's
+     * runs are kept.
+     */
+    void setSkipped(const void* skipper, const int from, const int to)
+    {
+        if (skipper != _skipper) {
+            _skipper = skipper;
+            _skipped.clear();
+        }
+        recordRun(_skipped, from, to);
+    }
+
+    /**
+     * Forgets every run of trivia, so the trivia rule runs again.
+     */
+    void clearSkipped()
+    {
+        _skipped.clear();
+    }
+
+    /**
+     * Forgets the runs of trivia and the tokens that were read before the
+     * position, which can't be read again once the data before it is
+     * discarded.
+     */
+    void forgetBefore(const int pos)
+    {
+        forgetRunsBefore(_skipped, pos);
+        forgetRunsBefore(_tokenEnds, pos);
+    }
+
+    /**
+     * Returns where the token that was read before the position ended, if
+     * the position is just past it and its trivia, or -1 if that isn't known.
+     */
+    int tokenEnd(const int pos) const
+    {
+        return findRun(_tokenEnds, pos);
+    }
+
+    /**
+     * Records that a token ended, and the position that its trivia reached.
+     * Like runs of trivia, every token is kept until the data before it is
+     * discarded, so rules that backtrack to the end of any earlier token
+     * still find where it ended.
+     */
+    void setTokenEnd(const int end, const int next)
+    {
+        recordRun(_tokenEnds, next, end);
+    }
+
+    /**
+     * Returns the farthest failure of the rules that have read this data.
+     */
+    Failure& failure()
+    {
+        return _failure;
+    }
+
+    /**
+     * Returns whether a cut was matched in the choice that's being tried.
+     */
+    bool isCut() const
+    {
+        return _cut;
+    }
+
+    /**
+     * Sets whether a cut was matched in the choice that's being tried,
+     * returning what it was.
+     */
+    bool setCut(const bool cut)
+    {
+        const bool previous = _cut;
+        _cut = cut;
+        return previous;
+    }
+
+    /**
+     * Records a cut in the choice that's being tried.
+     */
+    void cut()
+    {
+        _cut = true;
+    }
+
+    /**
+     * Returns the budget that limits parses of this data, or nullptr if they
+     * are unlimited.
+     */
+    Budget* budget() const
+    {
+        return _budget;
+    }
+
+    void setBudget(Budget* budget)
+    {
+        _budget = budget;
+    }
+
+    /**
+     * Reads the element at the position without throwing, returning why it
+     * couldn't be read, or FailureReason::None if it was.
+     */
+    virtual FailureReason read(int pos, Data& value)
+    {
+        if (pos < 0) {
+            return FailureReason::OutOfRange;
+        }
+        advanceTo(pos);
+        if (pos >= head()) {
+            return FailureReason::EndOfInput;
+        }
+        value = get(pos);
+        return FailureReason::None;
+    }
 };
 
 template <class Data, class Iterator>
@@ -128,6 +335,11 @@ public:
         return _str.size();
     }
 
+    const QChar* contiguous() const
+    {
+        return _str.constData();
+    }
+
     QChar get(int pos)
     {
         return _str.at(pos);
@@ -163,6 +375,11 @@ public:
         return _str.size();
     }
 
+    const char* contiguous() const
+    {
+        return _str.data();
+    }
+
     char get(int pos)
     {
         return _str.at(pos);
@@ -183,6 +400,189 @@ public:
     }
 };
 
+/**
+ * \brief Cursor data over a vector that's already in memory.
+ *
+ * Unlike iterator-based cursor data, nothing is buffered, so the vector must
+ * outlive the cursor and must not be modified while it's in use.
+ */
+template <class Data>
+class VectorCursorData : public CursorData<Data>
+{
+    const std::vector<Data>& _data;
+
+public:
+    VectorCursorData(const std::vector<Data>& data) :
+        _data(data)
+    {
+    }
+
+    int head() const
+    {
+        return _data.size();
+    }
+
+    const Data* contiguous() const
+    {
+        return _data.data();
+    }
+
+    Data get(int pos)
+    {
+        return _data.at(pos);
+    }
+
+    void advanceTo(int pos)
+    {
+        if (pos < 0) {
+            std::stringstream str;
+            str << "pos must be non-negative, but I was given " << pos << ". ";
+            throw std::range_error(str.str());
+        }
+    }
+
+    bool atEnd()
+    {
+        return true;
+    }
+};
+
+/**
+ * \brief Cursor data that is pushed to it in chunks, rather than pulled from a stream.
+ *
+ * Rules only ever see the input that has been fed so far. Instead of blocking
+ * when a rule runs off the end of the buffered input, the data records that it
+ * was starved; the caller can then discard that attempt and retry once more input
+ * has arrived. Once the input is closed, the end of the buffer is the real end of
+ * the input, and starvation is no longer recorded.
+ *
+ * Input before a committed position can be discarded, so memory is bounded by the
+ * size of the largest uncommitted match.
+ */
+template <class Data>
+class ChunkedCursorData : public CursorData<Data>
+{
+    std::deque<Data> _buffer;
+    int _tail;
+
+    bool _closed;
+    bool _starved;
+
+public:
+    ChunkedCursorData() :
+        _tail(0),
+        _closed(false),
+        _starved(false)
+    {
+    }
+
+    int head() const
+    {
+        return _tail + buffered();
+    }
+
+    int tail() const
+    {
+        return _tail;
+    }
+
+    int buffered() const
+    {
+        return _buffer.size();
+    }
+
+    bool closed() const
+    {
+        return _closed;
+    }
+
+    bool starved() const
+    {
+        return _starved;
+    }
+
+    void resetStarved()
+    {
+        _starved = false;
+    }
+
+    std::string state() const
+    {
+        std::stringstream str;
+        str << "[tail: " << tail() << ", head: " << head() << "]";
+        return str.str();
+    }
+
+    template <class Iterator>
+    void feed(Iterator begin, Iterator end)
+    {
+        if (_closed) {
+            throw std::logic_error("Input must not be fed after it has been closed");
+        }
+        _buffer.insert(_buffer.end(), begin, end);
+    }
+
+    void close()
+    {
+        _closed = true;
+    }
+
+    /**
+     * Discards all buffered elements before the specified position. Cursors
+     * must not refer to these positions afterwards.
+     */
+    void discardBefore(int pos)
+    {
+        while (_tail < pos && !_buffer.empty()) {
+            _buffer.pop_front();
+            ++_tail;
+        }
+        this->forgetBefore(pos);
+    }
+
+    FailureReason read(int pos, Data& value)
+    {
+        if (pos < tail()) {
+            return FailureReason::OutOfRange;
+        }
+        return CursorData<Data>::read(pos, value);
+    }
+
+    Data get(int pos)
+    {
+        if (pos < tail()) {
+            std::stringstream str;
+            str << "pos must not refer to discarded elements, but I was given " << pos << ". " << state();
+            throw std::range_error(str.str());
+        }
+        if (pos >= head()) {
+            advanceTo(pos);
+            std::stringstream str;
+            str << "pos must refer to buffered elements, but I was given " << pos << ". " << state();
+            throw std::range_error(str.str());
+        }
+        return _buffer[pos - _tail];
+    }
+
+    void advanceTo(int pos)
+    {
+        if (pos < 0) {
+            std::stringstream str;
+            str << "pos must be non-negative, but I was given " << pos << ". ";
+            throw std::range_error(str.str());
+        }
+        if (pos >= head() && !_closed) {
+            _starved = true;
+        }
+    }
+
+    bool atEnd()
+    {
+        // Nothing beyond the buffer can be read without another chunk
+        return true;
+    }
+};
+
 template <class Data>
 class Cursor
 {
@@ -228,9 +628,111 @@ public:
         return get();
     }
 
+    const StructuralIndex* index() const
+    {
+        return _data->index();
+    }
+
+    const Data* contiguous() const
+    {
+        return _data->contiguous();
+    }
+
+    /**
+     * Returns the position past the last element that the data holds.
+     */
+    int head() const
+    {
+        return _data->head();
+    }
+
+    int skipped(const void* skipper) const
+    {
+        return _data->skipped(skipper, pos());
+    }
+
+    void setSkipped(const void* skipper, const int from)
+    {
+        _data->setSkipped(skipper, from, pos());
+    }
+
+    /**
+     * Returns where the last token before the cursor ended, not including
+     * its trivia, or -1 if that isn't known.
+     */
+    int tokenEnd() const
+    {
+        return _data->tokenEnd(pos());
+    }
+
+    void setTokenEnd(const int end)
+    {
+        _data->setTokenEnd(end, pos());
+    }
+
+    Failure& failure() const
+    {
+        return _data->failure();
+    }
+
+    /**
+     * Reads the element at the cursor without throwing, returning why it
+     * couldn't be read, or FailureReason::None if it was. Unlike get(), this
+     * is safe to call at the end of the input.
+     */
+    FailureReason read(Data& value)
+    {
+        return _data->read(pos(), value);
+    }
+
+    /**
+     * Commits to the choice that's being tried, so that if it fails, the
+     * choice point that's trying it fails too.
+     */
+    void cut()
+    {
+        _data->cut();
+    }
+
+    bool isCut() const
+    {
+        return _data->isCut();
+    }
+
+    bool setCut(const bool cut)
+    {
+        return _data->setCut(cut);
+    }
+
+    Budget* budget() const
+    {
+        return _data->budget();
+    }
+
+    /**
+     * Limits parses from this cursor, and every cursor that shares its data,
+     * to the budget. The budget must outlive the parse.
+     */
+    void setBudget(Budget* budget)
+    {
+        _data->setBudget(budget);
+    }
+
+    /**
+     * Records that a rule failed here for the reason, and returns false, so
+     * rules can fail with "return iter.fail(reason);" instead of throwing.
+     */
+    bool fail(const FailureReason reason)
+    {
+        _data->failure().fail(pos(), reason);
+        return false;
+    }
+
     operator bool() const
     {
-        return !_data->atEnd() || pos() < _data->head();
+        // Only ask whether the data has ended once everything it holds was read,
+        // since that can wait for more input
+        return pos() < _data->head() || !_data->atEnd();
     }
 
     Cursor& operator++()
@@ -340,6 +842,22 @@ Cursor<Data> makeCursor(std::string* stream)
     );
 }
 
+template <class Data>
+Cursor<Data> makeCursor(const std::vector<Data>* data)
+{
+    return Cursor<Data>(
+        new VectorCursorData<Data>(*data)
+    );
+}
+
+template <class Data>
+Cursor<Data> makeCursor(std::vector<Data>* data)
+{
+    return Cursor<Data>(
+        new VectorCursorData<Data>(*data)
+    );
+}
+
 template <class Data>
 Cursor<Data> makeCursor(const char* stream)
 {
@@ -0,0 +1,177 @@
+#ifndef SPROUT_FAILURE_HEADER
+#define SPROUT_FAILURE_HEADER
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace sprout {
+
+/**
+ * Why a rule failed, so that rules can report failures by returning them
+ * rather than by throwing.
+ */
+enum class FailureReason
+{
+    None,
+
+    /**
+     * The input didn't match what the rule expected.
+     */
+    Mismatch,
+
+    /**
+     * The input ended before the rule could match.
+     */
+    EndOfInput,
+
+    /**
+     * The rule read before the start of the input, or input that was discarded.
+     */
+    OutOfRange
+};
+
+/**
+ * \brief The farthest position at which a parse failed, and what it expected there.
+ *
+ * Rules that match tokens record what they expected whenever they fail. Only
+ * the farthest position is kept, since that's almost always where the input
+ * is wrong. Failures before it are a single comparison, and nothing is
+ * recorded when rules succeed. Rules that fail for other reasons record
+ * only the reason, which is kept if it's the first at the farthest position.
+ */
+class Failure
+{
+    int _pos;
+    FailureReason _reason;
+    std::vector<std::string> _expected;
+
+public:
+    Failure() :
+        _pos(-1),
+        _reason(FailureReason::None)
+    {
+    }
+
+    /**
+     * Records that a rule failed at the position, returning whether it's the
+     * farthest failure.
+     */
+    bool fail(const int pos, const FailureReason reason)
+    {
+        if (pos < _pos) {
+            return false;
+        }
+        if (pos > _pos) {
+            _pos = pos;
+            _reason = reason;
+            _expected.clear();
+        }
+        return true;
+    }
+
+    /**
+     * Records that the token was expected at the position.
+     */
+    void expect(const int pos, const std::string& token)
+    {
+        if (!fail(pos, FailureReason::Mismatch)) {
+            return;
+        }
+        if (std::find(_expected.begin(), _expected.end(), token) == _expected.end()) {
+            _expected.push_back(token);
+        }
+    }
+
+    void clear()
+    {
+        _pos = -1;
+        _reason = FailureReason::None;
+        _expected.clear();
+    }
+
+    int pos() const
+    {
+        return _pos;
+    }
+
+    FailureReason reason() const
+    {
+        return _reason;
+    }
+
+    const std::vector<std::string>& expected() const
+    {
+        return _expected;
+    }
+
+    explicit operator bool() const
+    {
+        return _pos >= 0;
+    }
+
+    /**
+     * Finds the zero-based line and column of the position in the text.
+     */
+    template <class Text>
+    void locate(const Text& text, int& line, int& column) const
+    {
+        line = 0;
+        column = 0;
+        int pos = 0;
+        for (auto c : text) {
+            if (pos++ == _pos) {
+                break;
+            }
+            if (c == '\n') {
+                ++line;
+                column = 0;
+            } else {
+                ++column;
+            }
+        }
+    }
+
+    /**
+     * Describes the failure, such as "line 2, column 5: expected 'then' or name".
+     */
+    template <class Text>
+    std::string describe(const Text& text) const
+    {
+        int line;
+        int column;
+        locate(text, line, column);
+
+        std::stringstream str;
+        str << "line " << (line + 1) << ", column " << (column + 1) << ": ";
+        if (_expected.empty()) {
+            switch (_reason) {
+                case FailureReason::EndOfInput:
+                    str << "unexpected end of input";
+                    break;
+                case FailureReason::OutOfRange:
+                    str << "input out of range";
+                    break;
+                default:
+                    str << "unexpected input";
+                    break;
+            }
+            return str.str();
+        }
+        str << "expected ";
+        for (unsigned i = 0; i < _expected.size(); ++i) {
+            if (i > 0) {
+                str << (i + 1 == _expected.size() ? " or " : ", ");
+            }
+            str << _expected[i];
+        }
+        return str.str();
+    }
+};
+
+} // namespace sprout
+
+#endif // SPROUT_FAILURE_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
@@ -0,0 +1,367 @@
+#ifndef SPROUT_INCREMENTALPARSER_HEADER
+#define SPROUT_INCREMENTALPARSER_HEADER
+
+#include "Cursor.hpp"
+#include "Result.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <cstring>
+#include <vector>
+
+namespace sprout {
+
+/**
+ * \brief Cursor data over a vector that records how far rules have looked.
+ *
+ * Rules can only see elements through get(), so that every element that a
+ * match depended on is recorded, including the end of the input.
+ */
+template <class Data>
+class LookaheadCursorData : public VectorCursorData<Data>
+{
+    int _lookahead;
+
+public:
+    LookaheadCursorData(const std::vector<Data>& data) :
+        VectorCursorData<Data>(data),
+        _lookahead(0)
+    {
+    }
+
+    /**
+     * Returns the position past the last element that was looked at, where
+     * looking for the end of the input counts as looking one past it.
+     */
+    int lookahead() const
+    {
+        return _lookahead;
+    }
+
+    void resetLookahead(const int pos)
+    {
+        _lookahead = pos;
+    }
+
+    Data get(int pos)
+    {
+        _lookahead = std::max(_lookahead, pos + 1);
+        return VectorCursorData<Data>::get(pos);
+    }
+
+    bool atEnd()
+    {
+        _lookahead = std::max(_lookahead, this->head() + 1);
+        return true;
+    }
+
+    FailureReason read(int pos, Data& value)
+    {
+        _lookahead = std::max(_lookahead, std::min(pos, this->head()) + 1);
+        return VectorCursorData<Data>::read(pos, value);
+    }
+
+    const Data* contiguous() const
+    {
+        // Reads in place wouldn't be recorded
+        return nullptr;
+    }
+};
+
+/**
+ * Moves the spans of the token and all of its children by the delta, for
+ * tokens with spans, such as grammar::Node.
+ */
+template <class Token>
+auto shiftSpans(Token& token, const int delta, int) -> decltype(token.setSpan(0, 0), token.children(), void())
+{
+    std::vector<Token*> pending { &token };
+    while (!pending.empty()) {
+        Token* node = pending.back();
+        pending.pop_back();
+        node->setSpan(node->start() + delta, node->end() + delta);
+        for (auto& child : node->children()) {
+            pending.push_back(&child);
+        }
+    }
+}
+
+/**
+ * Tokens without spans are left as they are.
+ */
+template <class Token>
+void shiftSpans(Token&, const int, long)
+{
+}
+
+/**
+ * \brief An edit to the text, in the positions of the text before it was made.
+ */
+template <class Input>
+struct TextEdit
+{
+    int start;
+    int removed;
+    std::vector<Input> inserted;
+};
+
+/**
+ * \brief Reparses text after it's edited, reusing every match that the edit didn't touch.
+ *
+ * Like PushParser, the rule matches a single item of the text, such as one
+ * statement, and is run repeatedly until the text is exhausted. Each item
+ * remembers its range and how far past it the rule looked. After an edit,
+ * items that never looked at the edited range are kept as they are, and
+ * parsing resumes at the first item that did. Once parsing reaches the
+ * start of an old item that lies wholly after the edit, the rest of the
+ * text is unchanged from there, so every remaining item is reused by
+ * shifting it. The cost of an edit is proportional to the items that
+ * overlap it, rather than to the size of the text.
+ *
+ * Tokens with spans, such as the nodes that a grammar builds, keep the spans
+ * from when they were parsed, and are moved by how far their item was shifted
+ * when they're returned by results().
+ *
+ * The rule must not depend on anything but the text at and after the
+ * position it's run from.
+ */
+template <
+    class Rule,
+    class Input = typename Rule::input_type,
+    class Token = typename Rule::token_type
+>
+class IncrementalParser
+{
+    struct Item
+    {
+        int start;
+        int end;
+        int lookahead;
+        std::vector<Token> results;
+
+        // How far the item has moved since its results were parsed
+        int shift;
+    };
+
+    const Rule _rule;
+
+    std::vector<Input> _text;
+    std::vector<Item> _items;
+    bool _successful;
+    int _reparsed;
+
+    /**
+     * Parses items from the end of the kept items until the end of the text,
+     * reusing the old items from the given index once parsing reaches the
+     * first of them, shifted by the delta.
+     */
+    bool parseFrom(std::vector<Item>& old, unsigned reusable, const int delta)
+    {
+        auto data = new LookaheadCursorData<Input>(_text);
+        Cursor<Input> cursor(data);
+        cursor += _items.empty() ? 0 : _items.back().end;
+
+        _reparsed = 0;
+        while (cursor) {
+            while (reusable < old.size() && old[reusable].start + delta < cursor.pos()) {
+                ++reusable;
+            }
+            if (reusable < old.size() && old[reusable].start + delta == cursor.pos()) {
+                for (; reusable < old.size(); ++reusable) {
+                    Item& item = old[reusable];
+                    item.start += delta;
+                    item.end += delta;
+                    item.lookahead += delta;
+                    item.shift += delta;
+                    _items.push_back(std::move(item));
+                }
+                // The old parse failed or succeeded from here, and would again
+                return _successful;
+            }
+
+            data->resetLookahead(cursor.pos());
+            // Skipping remembered trivia wouldn't be recorded as lookahead
+            data->clearSkipped();
+
+            auto iter = cursor;
+            Result<Token> matched;
+            ++_reparsed;
+            if (!_rule(iter, matched) || iter.pos() == cursor.pos()) {
+                return _successful = false;
+            }
+
+            Item item;
+            item.start = cursor.pos();
+            item.end = iter.pos();
+            item.lookahead = data->lookahead();
+            item.shift = 0;
+            while (matched) {
+                item.results.push_back(*matched++);
+            }
+            _items.push_back(std::move(item));
+            cursor = iter;
+        }
+        return _successful = true;
+    }
+
+public:
+    IncrementalParser(const Rule& rule) :
+        _rule(rule),
+        _successful(true),
+        _reparsed(0)
+    {
+    }
+
+    /**
+     * Parses the text from scratch, discarding any earlier parse.
+     */
+    template <class Iterator>
+    bool parse(Iterator begin, Iterator end)
+    {
+        _text.assign(begin, end);
+        _items.clear();
+        std::vector<Item> old;
+        return parseFrom(old, 0, 0);
+    }
+
+    template <class Container>
+    bool parse(const Container& text)
+    {
+        return parse(std::begin(text), std::end(text));
+    }
+
+    bool parse(const char* text)
+    {
+        return parse(text, text + strlen(text));
+    }
+
+    /**
+     * Replaces the removed elements at the start with the inserted ones, and
+     * reparses the text that the edit could have changed.
+     */
+    bool edit(const TextEdit<Input>& edit)
+    {
+        if (edit.start < 0 || edit.removed < 0 || edit.start + edit.removed > static_cast<int>(_text.size())) {
+            throw std::range_error("The edit is outside of the text");
+        }
+        _text.erase(_text.begin() + edit.start, _text.begin() + edit.start + edit.removed);
+        _text.insert(_text.begin() + edit.start, edit.inserted.begin(), edit.inserted.end());
+
+        // Keep the items that never looked at the edit
+        unsigned kept = 0;
+        while (kept < _items.size() && _items[kept].lookahead <= edit.start) {
+            ++kept;
+        }
+
+        std::vector<Item> old(
+            std::make_move_iterator(_items.begin() + kept),
+            std::make_move_iterator(_items.end())
+        );
+        _items.resize(kept);
+
+        // Items that start after the removed text see the same text as before,
+        // so reaching one of them means the old parse from there still holds
+        unsigned reusable = 0;
+        while (reusable < old.size() && old[reusable].start < edit.start + edit.removed) {
+            ++reusable;
+        }
+        return parseFrom(old, reusable, static_cast<int>(edit.inserted.size()) - edit.removed);
+    }
+
+    /**
+     * Applies each edit in turn, so each must be in the positions of the text
+     * after the edits before it.
+     */
+    bool edit(const std::vector<TextEdit<Input>>& edits)
+    {
+        for (auto& each : edits) {
+            edit(each);
+        }
+        return _successful;
+    }
+
+    template <class Container>
+    bool edit(const int start, const int removed, const Container& inserted)
+    {
+        return edit(TextEdit<Input>{
+            start,
+            removed,
+            std::vector<Input>(std::begin(inserted), std::end(inserted))
+        });
+    }
+
+    bool edit(const int start, const int removed, const char* inserted)
+    {
+        return edit(TextEdit<Input>{
+            start,
+            removed,
+            std::vector<Input>(inserted, inserted + strlen(inserted))
+        });
+    }
+
+    /**
+     * Returns whether the whole text was matched.
+     */
+    bool successful() const
+    {
+        return _successful;
+    }
+
+    /**
+     * Returns the position of the first element that has not been matched.
+     */
+    int pos() const
+    {
+        return _items.empty() ? 0 : _items.back().end;
+    }
+
+    const std::vector<Input>& text() const
+    {
+        return _text;
+    }
+
+    /**
+     * Returns the number of items that the rule was run for by the last parse
+     * or edit, rather than being reused.
+     */
+    int reparsed() const
+    {
+        return _reparsed;
+    }
+
+    Result<Token> results() const
+    {
+        Result<Token> results;
+        for (auto& item : _items) {
+            for (auto& token : item.results) {
+                if (item.shift == 0) {
+                    results << token;
+                    continue;
+                }
+                Token shifted(token);
+                shiftSpans(shifted, item.shift, 0);
+                results.insert(std::move(shifted));
+            }
+        }
+        return results;
+    }
+};
+
+template <class Rule>
+IncrementalParser<Rule> incrementalParser(const Rule& rule)
+{
+    return IncrementalParser<Rule>(rule);
+}
+
+template <class Input, class Token, class Rule>
+IncrementalParser<Rule, Input, Token> incrementalParser(const Rule& rule)
+{
+    return IncrementalParser<Rule, Input, Token>(rule);
+}
+
+} // namespace sprout
+
+#endif // SPROUT_INCREMENTALPARSER_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
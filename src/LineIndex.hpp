@@ -0,0 +1,89 @@
+#ifndef SPROUT_LINEINDEX_HEADER
+#define SPROUT_LINEINDEX_HEADER
+
+#include <algorithm>
+#include <vector>
+
+namespace sprout {
+
+/**
+ * \brief Converts offsets in a text into zero-based lines and columns.
+ *
+ * The offsets where each line starts are found the first time that an offset
+ * is located, and every lookup after that is a binary search, so the spans of
+ * many nodes can be located without rescanning the text. The text must
+ * outlive the index, and must not change.
+ */
+template <class Text>
+class LineIndex
+{
+    const Text& _text;
+    mutable std::vector<int> _lineStarts;
+
+    const std::vector<int>& lineStarts() const
+    {
+        if (_lineStarts.empty()) {
+            _lineStarts.push_back(0);
+            int pos = 0;
+            for (auto c : _text) {
+                ++pos;
+                if (c == '\n') {
+                    _lineStarts.push_back(pos);
+                }
+            }
+        }
+        return _lineStarts;
+    }
+
+public:
+    LineIndex(const Text& text) :
+        _text(text)
+    {
+    }
+
+    /**
+     * Finds the zero-based line and column of the offset, as Failure::locate does.
+     */
+    void locate(const int offset, int& line, int& column) const
+    {
+        const std::vector<int>& starts = lineStarts();
+        line = std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin() - 1;
+        column = offset - starts[line];
+    }
+
+    int line(const int offset) const
+    {
+        int line;
+        int column;
+        locate(offset, line, column);
+        return line;
+    }
+
+    int column(const int offset) const
+    {
+        int line;
+        int column;
+        locate(offset, line, column);
+        return column;
+    }
+
+    /**
+     * Returns the number of lines in the text.
+     */
+    int lines() const
+    {
+        return lineStarts().size();
+    }
+};
+
+template <class Text>
+LineIndex<Text> lineIndex(const Text& text)
+{
+    return LineIndex<Text>(text);
+}
+
+} // namespace sprout
+
+#endif // SPROUT_LINEINDEX_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
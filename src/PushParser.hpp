@@ -0,0 +1,186 @@
+#ifndef SPROUT_PUSHPARSER_HEADER
+#define SPROUT_PUSHPARSER_HEADER
+
+#include "Cursor.hpp"
+#include "Result.hpp"
+
+#include <iterator>
+#include <cstring>
+
+namespace sprout {
+
+enum class PushStatus
+{
+    /**
+     * Everything that could be decided from the buffered input has been matched, and the
+     * parser is waiting for another chunk.
+     */
+    NeedMoreInput,
+
+    /**
+     * The input was closed, and all of it was matched.
+     */
+    Done,
+
+    /**
+     * The rule failed to match the input at the committed position.
+     */
+    Failed
+};
+
+/**
+ * \brief Drives a rule over input that is pushed to it in chunks.
+ *
+ * PushParser repeatedly matches its rule against the buffered input, committing
+ * each match as soon as it could be decided without looking past the end of the
+ * buffer. If the rule runs off the end of the buffer, that attempt is thrown away
+ * and resumed from the last committed position once the next chunk arrives, so a
+ * host never has to block a thread waiting for input. Input is discarded as
+ * matches are committed.
+ *
+ * The rule should match a single item of the input, such as one statement. Each
+ * item is retried at most once per chunk, so it is best kept small.
+ */
+template <
+    class Rule,
+    class Input = typename Rule::input_type,
+    class Token = typename Rule::token_type
+>
+class PushParser
+{
+    const Rule _rule;
+
+    // Owned by the cursor
+    ChunkedCursorData<Input>* _data;
+    Cursor<Input> _committed;
+
+    Result<Token> _results;
+    PushStatus _status;
+
+    PushStatus parseAvailable()
+    {
+        while (_status == PushStatus::NeedMoreInput) {
+            if (!_committed) {
+                if (_data->closed()) {
+                    _status = PushStatus::Done;
+                }
+                break;
+            }
+
+            _data->resetStarved();
+
+            auto iter = _committed;
+            Result<Token> matched;
+            auto successful = _rule(iter, matched);
+
+            if (_data->starved()) {
+                // The rule wanted input we don't have yet, so its outcome can't be trusted.
+                break;
+            }
+
+            if (!successful || iter.pos() == _committed.pos()) {
+                _status = PushStatus::Failed;
+                break;
+            }
+
+            while (matched) {
+                _results << *matched++;
+            }
+            _committed = iter;
+            _data->discardBefore(_committed.pos());
+        }
+        return _status;
+    }
+
+public:
+    PushParser(const Rule& rule) :
+        _rule(rule),
+        _data(new ChunkedCursorData<Input>),
+        _committed(_data),
+        _status(PushStatus::NeedMoreInput)
+    {
+    }
+
+    template <class Iterator>
+    PushStatus feed(Iterator begin, Iterator end)
+    {
+        if (_status != PushStatus::NeedMoreInput) {
+            return _status;
+        }
+        _data->feed(begin, end);
+        return parseAvailable();
+    }
+
+    template <class Container>
+    PushStatus feed(const Container& chunk)
+    {
+        return feed(std::begin(chunk), std::end(chunk));
+    }
+
+    PushStatus feed(const char* chunk)
+    {
+        return feed(chunk, chunk + strlen(chunk));
+    }
+
+    /**
+     * Indicates that no more input will be fed, so any pending input will be
+     * matched against the real end of the input.
+     */
+    PushStatus close()
+    {
+        if (_status != PushStatus::NeedMoreInput) {
+            return _status;
+        }
+        _data->close();
+        return parseAvailable();
+    }
+
+    PushStatus status() const
+    {
+        return _status;
+    }
+
+    /**
+     * Returns the position of the first element that has not been matched.
+     */
+    int pos() const
+    {
+        return _committed.pos();
+    }
+
+    Result<Token>& results()
+    {
+        return _results;
+    }
+
+    /**
+     * Returns all committed results, removing them from this parser.
+     */
+    Result<Token> take()
+    {
+        Result<Token> taken;
+        while (_results) {
+            taken << *_results++;
+        }
+        _results.clear();
+        return taken;
+    }
+};
+
+template <class Rule>
+PushParser<Rule> pushParser(const Rule& rule)
+{
+    return PushParser<Rule>(rule);
+}
+
+template <class Input, class Token, class Rule>
+PushParser<Rule, Input, Token> pushParser(const Rule& rule)
+{
+    return PushParser<Rule, Input, Token>(rule);
+}
+
+} // namespace sprout
+
+#endif // SPROUT_PUSHPARSER_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
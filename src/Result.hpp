@@ -4,6 +4,7 @@
 #include <vector>
 #include <iterator>
 #include <algorithm>
+#include <utility>
 
 #include "Cursor.hpp"
 
@@ -127,6 +128,19 @@ public:
         ++_insertionPos;
     }
 
+    void insert(Token&& value)
+    {
+        if (suppressed()) {
+            return;
+        }
+        if (_insertionPos >= _data.size()) {
+            _data.push_back(std::move(value));
+        } else {
+            _data[_insertionPos] = std::move(value);
+        }
+        ++_insertionPos;
+    }
+
     template <class T>
     void insert(const Result<T>& value)
     {
@@ -0,0 +1,187 @@
+#include <StructuralIndex.hpp>
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace sprout {
+
+namespace {
+
+const int WORD_BITS = 64;
+
+enum Bit {
+    QUOTE,
+    BACKSLASH,
+    NEWLINE,
+    DASH,
+    HASH,
+    SPACE,
+    BITS
+};
+
+void classify(const ushort c, const int bit, quint64* bits)
+{
+    const quint64 mask = quint64(1) << bit;
+    if (c == '\'' || c == '"') {
+        bits[QUOTE] |= mask;
+    } else if (c == '\\') {
+        bits[BACKSLASH] |= mask;
+    } else if (c == '\n') {
+        bits[NEWLINE] |= mask;
+    } else if (c == '-') {
+        bits[DASH] |= mask;
+    } else if (c == '#') {
+        bits[HASH] |= mask;
+    }
+    if (c == ' ' || (c >= '\t' && c <= '\r')) {
+        bits[SPACE] |= mask;
+    }
+}
+
+#ifdef __SSE2__
+
+/**
+ * Returns one bit for each of the sixteen characters in a pair of comparisons.
+ */
+quint64 movemask(const __m128i low, const __m128i high)
+{
+    return static_cast<unsigned int>(_mm_movemask_epi8(_mm_packs_epi16(low, high)));
+}
+
+__m128i equal(const __m128i chars, const char c)
+{
+    return _mm_cmpeq_epi16(chars, _mm_set1_epi16(c));
+}
+
+__m128i space(const __m128i chars)
+{
+    // Tabs through carriage returns are the five characters from '\t'
+    const __m128i control = _mm_sub_epi16(chars, _mm_set1_epi16('\t'));
+    return _mm_or_si128(
+        equal(chars, ' '),
+        _mm_cmpeq_epi16(_mm_subs_epu16(control, _mm_set1_epi16(4)), _mm_setzero_si128())
+    );
+}
+
+void classify(const ushort* chars, const int bit, quint64* bits)
+{
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + 8));
+
+    bits[QUOTE] |= movemask(
+        _mm_or_si128(equal(low, '\''), equal(low, '"')),
+        _mm_or_si128(equal(high, '\''), equal(high, '"'))
+    ) << bit;
+    bits[BACKSLASH] |= movemask(equal(low, '\\'), equal(high, '\\')) << bit;
+    bits[NEWLINE] |= movemask(equal(low, '\n'), equal(high, '\n')) << bit;
+    bits[DASH] |= movemask(equal(low, '-'), equal(high, '-')) << bit;
+    bits[HASH] |= movemask(equal(low, '#'), equal(high, '#')) << bit;
+    bits[SPACE] |= movemask(space(low), space(high)) << bit;
+}
+
+#endif
+
+/**
+ * Returns the bitmap of the kind, which is its bit within the kinds.
+ */
+int bitmap(const StructuralIndex::Kind kind)
+{
+    return __builtin_ctz(kind);
+}
+
+} // namespace anonymous
+
+StructuralIndex::StructuralIndex(const QString& str) :
+    _str(str)
+{
+    const int size = str.size();
+    const int words = (size + WORD_BITS - 1) / WORD_BITS;
+    for (auto& kindBitmap : _bitmaps) {
+        kindBitmap.resize(words);
+    }
+    _lines.resize(words + 1);
+
+    const ushort* chars = reinterpret_cast<const ushort*>(str.constData());
+    std::vector<quint64> dashes(words + 1);
+    for (int index = 0; index < words; ++index) {
+        const int start = index * WORD_BITS;
+        const int end = std::min(start + WORD_BITS, size);
+
+        quint64 bits[BITS] = {0};
+        int pos = start;
+#ifdef __SSE2__
+        for (; pos + 16 <= end; pos += 16) {
+            classify(chars + pos, pos - start, bits);
+        }
+#endif
+        for (; pos < end; ++pos) {
+            classify(chars[pos], pos - start, bits);
+        }
+
+        const quint64 valid = end - start == WORD_BITS ? ~quint64(0) : (quint64(1) << (end - start)) - 1;
+        _bitmaps[bitmap(Quote)][index] = bits[QUOTE];
+        _bitmaps[bitmap(Backslash)][index] = bits[BACKSLASH];
+        _bitmaps[bitmap(Newline)][index] = bits[NEWLINE];
+        _bitmaps[bitmap(CommentStart)][index] = bits[HASH];
+        _bitmaps[bitmap(NonSpace)][index] = ~bits[SPACE] & valid;
+        dashes[index] = bits[DASH];
+        _lines[index + 1] = _lines[index] + __builtin_popcountll(bits[NEWLINE]);
+    }
+
+    // A dash only starts a comment if the next character is also a dash, which
+    // may be in the next word
+    for (int index = 0; index < words; ++index) {
+        const quint64 following = (dashes[index] >> 1) | (dashes[index + 1] << (WORD_BITS - 1));
+        _bitmaps[bitmap(CommentStart)][index] |= dashes[index] & following;
+    }
+}
+
+int StructuralIndex::next(const int kinds, const int pos) const
+{
+    if (pos >= size()) {
+        return size();
+    }
+    int index = pos / WORD_BITS;
+    quint64 bits = word(kinds, index) & (~quint64(0) << (pos % WORD_BITS));
+    while (!bits) {
+        if (++index >= static_cast<int>(_lines.size()) - 1) {
+            return size();
+        }
+        bits = word(kinds, index);
+    }
+    return index * WORD_BITS + __builtin_ctzll(bits);
+}
+
+int StructuralIndex::line(const int pos) const
+{
+    const int index = pos / WORD_BITS;
+    if (index >= static_cast<int>(_lines.size()) - 1) {
+        return _lines.back();
+    }
+    const quint64 before = (quint64(1) << (pos % WORD_BITS)) - 1;
+    return _lines[index] + __builtin_popcountll(_bitmaps[bitmap(Newline)][index] & before);
+}
+
+int StructuralIndex::column(const int pos) const
+{
+    int index = pos / WORD_BITS;
+    quint64 bits = 0;
+    if (index < static_cast<int>(_lines.size()) - 1) {
+        bits = _bitmaps[bitmap(Newline)][index] & ((quint64(1) << (pos % WORD_BITS)) - 1);
+    }
+    while (!bits) {
+        if (--index < 0) {
+            return pos;
+        }
+        bits = _bitmaps[bitmap(Newline)][index];
+    }
+    const int newline = index * WORD_BITS + WORD_BITS - 1 - __builtin_clzll(bits);
+    return pos - newline - 1;
+}
+
+} // namespace sprout
+
+// vim: set ts=4 sw=4 :
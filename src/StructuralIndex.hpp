@@ -0,0 +1,130 @@
+#ifndef SPROUT_STRUCTURALINDEX_HEADER
+#define SPROUT_STRUCTURALINDEX_HEADER
+
+#include "Cursor.hpp"
+
+#include <QString>
+#include <QChar>
+
+#include <vector>
+
+namespace sprout {
+
+/**
+ * \brief Bitmaps of the characters in a string that rules look for while skipping over text.
+ *
+ * The string is scanned once, several characters at a time, and each kind of
+ * character is recorded as one bit per position. Rules that would otherwise
+ * test every character, such as those for strings, comments and whitespace,
+ * can then jump straight to the next character that matters.
+ *
+ * Only ASCII characters are classified. Whitespace is recorded by marking the
+ * characters that are not ASCII whitespace, so a rule that skips whitespace
+ * must still check each marked character that is outside of ASCII.
+ *
+ * The string must outlive the index and must not be modified while it's used.
+ */
+class StructuralIndex
+{
+public:
+    enum Kind {
+        Quote = 1 << 0,
+        Backslash = 1 << 1,
+        Newline = 1 << 2,
+
+        /**
+         * The first character of a "--" or "#" comment marker.
+         */
+        CommentStart = 1 << 3,
+
+        NonSpace = 1 << 4
+    };
+
+private:
+    static const int KINDS = 5;
+
+    const QString& _str;
+
+    std::vector<quint64> _bitmaps[KINDS];
+
+    /**
+     * The number of newlines before each word of the bitmaps.
+     */
+    std::vector<int> _lines;
+
+    quint64 word(const int kinds, const int index) const
+    {
+        quint64 bits = 0;
+        for (int kind = 0; kind < KINDS; ++kind) {
+            if (kinds & (1 << kind)) {
+                bits |= _bitmaps[kind][index];
+            }
+        }
+        return bits;
+    }
+
+public:
+    StructuralIndex(const QString& str);
+
+    const QString& string() const
+    {
+        return _str;
+    }
+
+    int size() const
+    {
+        return _str.size();
+    }
+
+    /**
+     * Returns the position of the first character of any of the given kinds
+     * at or after the position, or the size of the string if there is none.
+     */
+    int next(const int kinds, const int pos) const;
+
+    /**
+     * Returns the zero-based line of the position.
+     */
+    int line(const int pos) const;
+
+    /**
+     * Returns the zero-based column of the position.
+     */
+    int column(const int pos) const;
+};
+
+/**
+ * \brief Cursor data over a string, along with its structural index.
+ */
+class IndexedStringCursorData : public QStringCursorData
+{
+    StructuralIndex _index;
+
+public:
+    IndexedStringCursorData(const QString& str) :
+        QStringCursorData(str),
+        _index(str)
+    {
+    }
+
+    const StructuralIndex* index() const
+    {
+        return &_index;
+    }
+};
+
+/**
+ * Returns a cursor over the string that indexes it first, so that rules can
+ * skip over strings, comments and whitespace without testing every character.
+ */
+template <class Data>
+Cursor<Data> makeIndexedCursor(const QString* stream)
+{
+    return Cursor<Data>(new IndexedStringCursorData(*stream));
+}
+
+} // namespace sprout
+
+#endif // SPROUT_STRUCTURALINDEX_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
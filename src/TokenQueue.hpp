@@ -0,0 +1,272 @@
+#ifndef SPROUT_TOKENQUEUE_HEADER
+#define SPROUT_TOKENQUEUE_HEADER
+
+#include "Cursor.hpp"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace sprout {
+
+/**
+ * \brief A bounded queue that passes elements from one thread to another without locking.
+ *
+ * Exactly one thread may push, and exactly one other thread may pop. Each side
+ * only ever writes its own index, so the queue needs no locks; a side waits by
+ * yielding its thread when the ring is full or empty.
+ *
+ * The producer closes the queue once it's done, and the consumer can cancel it
+ * to tell the producer that nothing more will be read.
+ */
+template <class Data>
+class TokenQueue
+{
+    std::vector<Data> _slots;
+    const std::size_t _mask;
+
+    /**
+     * The next slot to be written, which is only changed by the producer.
+     */
+    std::atomic<std::size_t> _head;
+
+    // Keep the indices on separate cache lines, so the threads don't contend for them
+    char _padding[64];
+
+    /**
+     * The next slot to be read, which is only changed by the consumer.
+     */
+    std::atomic<std::size_t> _tail;
+
+    std::atomic<bool> _closed;
+    std::atomic<bool> _cancelled;
+
+    static std::size_t roundCapacity(const std::size_t capacity)
+    {
+        std::size_t rounded = 1;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+
+public:
+    TokenQueue(const std::size_t capacity = 4096) :
+        _slots(roundCapacity(capacity)),
+        _mask(_slots.size() - 1),
+        _head(0),
+        _tail(0),
+        _closed(false),
+        _cancelled(false)
+    {
+    }
+
+    std::size_t capacity() const
+    {
+        return _slots.size();
+    }
+
+    /**
+     * Pushes the value, waiting while the queue is full. Returns false,
+     * dropping the value, if the queue was cancelled.
+     */
+    bool push(const Data& value)
+    {
+        const std::size_t head = _head.load(std::memory_order_relaxed);
+        while (head - _tail.load(std::memory_order_acquire) == _slots.size()) {
+            if (cancelled()) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        _slots[head & _mask] = value;
+        _head.store(head + 1, std::memory_order_release);
+        return !cancelled();
+    }
+
+    /**
+     * Moves every available value to the end of the container, waiting while
+     * the queue is empty. Returns false if the queue was closed and every value
+     * has already been popped.
+     */
+    template <class Container>
+    bool popAll(Container& values)
+    {
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        std::size_t head = _head.load(std::memory_order_acquire);
+        while (head == tail) {
+            if (closed()) {
+                // Values pushed before the queue was closed are now visible
+                head = _head.load(std::memory_order_acquire);
+                if (head == tail) {
+                    return false;
+                }
+                break;
+            }
+            std::this_thread::yield();
+            head = _head.load(std::memory_order_acquire);
+        }
+        for (; tail != head; ++tail) {
+            values.push_back(std::move(_slots[tail & _mask]));
+        }
+        _tail.store(tail, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Indicates that nothing more will be pushed.
+     */
+    void close()
+    {
+        _closed.store(true, std::memory_order_release);
+    }
+
+    bool closed() const
+    {
+        return _closed.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Indicates that nothing more will be popped, so the producer may stop.
+     */
+    void cancel()
+    {
+        _cancelled.store(true, std::memory_order_release);
+    }
+
+    bool cancelled() const
+    {
+        return _cancelled.load(std::memory_order_acquire);
+    }
+};
+
+/**
+ * \brief Cursor data that is read from a TokenQueue as it's filled by another thread.
+ *
+ * Reading past the received elements blocks until the producer pushes more, or
+ * closes the queue. Received elements are retained so rules can backtrack over
+ * them, until they're discarded by the consumer once a match is committed.
+ */
+template <class Data>
+class QueueCursorData : public CursorData<Data>
+{
+    std::shared_ptr<TokenQueue<Data>> _queue;
+
+    std::deque<Data> _buffer;
+    int _tail;
+    bool _ended;
+
+    /**
+     * Waits for more elements from the queue. Returns false if it ended instead.
+     */
+    bool receive()
+    {
+        if (_ended) {
+            return false;
+        }
+        if (!_queue->popAll(_buffer)) {
+            _ended = true;
+        }
+        return !_ended;
+    }
+
+public:
+    QueueCursorData(const std::shared_ptr<TokenQueue<Data>>& queue) :
+        _queue(queue),
+        _tail(0),
+        _ended(false)
+    {
+    }
+
+    int head() const
+    {
+        return _tail + buffered();
+    }
+
+    int tail() const
+    {
+        return _tail;
+    }
+
+    int buffered() const
+    {
+        return _buffer.size();
+    }
+
+    std::string state() const
+    {
+        std::stringstream str;
+        str << "[tail: " << tail() << ", head: " << head() << "]";
+        return str.str();
+    }
+
+    /**
+     * Discards all received elements before the specified position. Cursors
+     * must not refer to these positions afterwards.
+     */
+    void discardBefore(int pos)
+    {
+        while (_tail < pos && !_buffer.empty()) {
+            _buffer.pop_front();
+            ++_tail;
+        }
+        this->forgetBefore(pos);
+    }
+
+    FailureReason read(int pos, Data& value)
+    {
+        if (pos < tail()) {
+            return FailureReason::OutOfRange;
+        }
+        while (pos >= head()) {
+            if (!receive()) {
+                return FailureReason::EndOfInput;
+            }
+        }
+        value = _buffer[pos - _tail];
+        return FailureReason::None;
+    }
+
+    Data get(int pos)
+    {
+        if (pos < tail()) {
+            std::stringstream str;
+            str << "pos must not refer to discarded elements, but I was given " << pos << ". " << state();
+            throw std::range_error(str.str());
+        }
+        while (pos >= head()) {
+            if (!receive()) {
+                std::stringstream str;
+                str << "pos must not be past the end of the queue, but I was given " << pos << ". " << state();
+                throw std::range_error(str.str());
+            }
+        }
+        return _buffer[pos - _tail];
+    }
+
+    void advanceTo(int pos)
+    {
+        // Elements are received lazily, so moving a cursor never waits
+        if (pos < 0) {
+            std::stringstream str;
+            str << "pos must be non-negative, but I was given " << pos << ". ";
+            throw std::range_error(str.str());
+        }
+    }
+
+    bool atEnd()
+    {
+        // Cursors only ask once they've read everything received, so wait for more
+        return !receive();
+    }
+};
+
+} // namespace sprout
+
+#endif // SPROUT_TOKENQUEUE_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
@@ -0,0 +1,231 @@
+#include "bench/Harness.hpp"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <algorithm>
+#include <iomanip>
+#include <cmath>
+#include <map>
+
+namespace sprout {
+namespace bench {
+
+namespace {
+
+double percentile(const std::vector<double>& sorted, const double fraction)
+{
+    // Nearest-rank percentile
+    int rank = static_cast<int>(std::ceil(fraction * sorted.size()));
+    if (rank < 1) {
+        rank = 1;
+    }
+    return sorted.at(rank - 1);
+}
+
+} // namespace anonymous
+
+Measurement summarize(std::vector<double> samples)
+{
+    Measurement measurement = Measurement();
+    measurement.samples = samples.size();
+    if (samples.empty()) {
+        return measurement;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    double sum = 0;
+    for (auto sample : samples) {
+        sum += sample;
+    }
+    measurement.mean = sum / samples.size();
+
+    double squares = 0;
+    for (auto sample : samples) {
+        squares += (sample - measurement.mean) * (sample - measurement.mean);
+    }
+    measurement.stddev = samples.size() > 1 ? std::sqrt(squares / (samples.size() - 1)) : 0;
+
+    auto middle = samples.size() / 2;
+    if (samples.size() % 2 == 0) {
+        measurement.median = (samples[middle - 1] + samples[middle]) / 2;
+    } else {
+        measurement.median = samples[middle];
+    }
+
+    measurement.min = samples.front();
+    measurement.max = samples.back();
+    measurement.p95 = percentile(samples, 0.95);
+    measurement.p99 = percentile(samples, 0.99);
+
+    return measurement;
+}
+
+Harness::Harness(std::ostream& out) :
+    _samples(30),
+    _warmup(3),
+    _minSampleTime(1000000),
+    _out(out)
+{
+}
+
+void Harness::setGroup(const std::string& group)
+{
+    if (!_group.empty()) {
+        _out << std::endl;
+    }
+    _group = group;
+    _out << "=== " << group << " ===\n";
+}
+
+void Harness::record(const char* name, const long long bytes, const long long iterations, const std::vector<double>& samples)
+{
+    Measurement measurement = summarize(samples);
+    measurement.group = _group;
+    measurement.name = name;
+    measurement.bytes = bytes;
+    measurement.iterations = iterations;
+    _measurements.push_back(measurement);
+
+    auto flags = _out.flags();
+    _out << std::fixed << std::setprecision(1)
+        << std::left << std::setw(12) << name << std::right
+        << " median " << std::setw(10) << measurement.median << " ns"
+        << "  p95 " << std::setw(10) << measurement.p95
+        << "  p99 " << std::setw(10) << measurement.p99
+        << "  sd " << std::setw(8) << measurement.stddev;
+    if (bytes > 0) {
+        _out << std::setprecision(2) << "  " << measurement.nsPerByte() << " ns/byte";
+    }
+    _out << "\n";
+    _out.flags(flags);
+}
+
+bool Harness::writeJson(const QString& path) const
+{
+    QJsonArray benchmarks;
+    for (auto& measurement : _measurements) {
+        QJsonObject object;
+        object["group"] = QString::fromStdString(measurement.group);
+        object["name"] = QString::fromStdString(measurement.name);
+        object["bytes"] = static_cast<double>(measurement.bytes);
+        object["samples"] = measurement.samples;
+        object["iterations"] = static_cast<double>(measurement.iterations);
+        object["median"] = measurement.median;
+        object["mean"] = measurement.mean;
+        object["stddev"] = measurement.stddev;
+        object["min"] = measurement.min;
+        object["max"] = measurement.max;
+        object["p95"] = measurement.p95;
+        object["p99"] = measurement.p99;
+        object["nsPerByte"] = measurement.nsPerByte();
+        if (!measurement.metrics.empty()) {
+            QJsonObject metrics;
+            for (auto& metric : measurement.metrics) {
+                metrics[QString::fromStdString(metric.first)] = metric.second;
+            }
+            object["metrics"] = metrics;
+        }
+        benchmarks.append(object);
+    }
+
+    QJsonObject root;
+    root["benchmarks"] = benchmarks;
+
+    QFile file(path);
+    if (!file.open(QFile::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson());
+    return true;
+}
+
+bool Harness::readJson(const QString& path, std::vector<Measurement>& measurements)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    auto document = QJsonDocument::fromJson(file.readAll());
+    if (!document.isObject()) {
+        return false;
+    }
+    for (auto value : document.object()["benchmarks"].toArray()) {
+        auto object = value.toObject();
+
+        Measurement measurement = Measurement();
+        measurement.group = object["group"].toString().toStdString();
+        measurement.name = object["name"].toString().toStdString();
+        measurement.bytes = object["bytes"].toDouble();
+        measurement.samples = object["samples"].toInt();
+        measurement.iterations = object["iterations"].toDouble();
+        measurement.median = object["median"].toDouble();
+        measurement.mean = object["mean"].toDouble();
+        measurement.stddev = object["stddev"].toDouble();
+        measurement.min = object["min"].toDouble();
+        measurement.max = object["max"].toDouble();
+        measurement.p95 = object["p95"].toDouble();
+        measurement.p99 = object["p99"].toDouble();
+        auto metrics = object["metrics"].toObject();
+        for (auto key : metrics.keys()) {
+            measurement.metrics[key.toStdString()] = metrics[key].toDouble();
+        }
+        measurements.push_back(measurement);
+    }
+    return true;
+}
+
+int compare(
+    const std::vector<Measurement>& baseline,
+    const std::vector<Measurement>& current,
+    const double threshold,
+    std::ostream& out)
+{
+    std::map<std::string, Measurement> baselineByKey;
+    for (auto& measurement : baseline) {
+        baselineByKey[measurement.key()] = measurement;
+    }
+
+    int regressions = 0;
+
+    auto flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+    for (auto& measurement : current) {
+        auto match = baselineByKey.find(measurement.key());
+        out << std::left << std::setw(40) << measurement.key() << std::right;
+        if (match == baselineByKey.end()) {
+            out << "        (new)\n";
+            continue;
+        }
+        const Measurement& base = match->second;
+        out << std::setw(12) << base.median << " -> " << std::setw(12) << measurement.median << " ns";
+        if (base.median <= 0) {
+            // A baseline that took no time can't be compared against
+            out << std::setw(10) << "n/a" << "\n";
+            continue;
+        }
+        double change = 100 * (measurement.median - base.median) / base.median;
+        out << std::showpos << std::setw(9) << change << "%" << std::noshowpos;
+        // Changes within the spread of the baseline's own samples are noise
+        if (change > threshold && measurement.median > base.p95) {
+            out << "  REGRESSION";
+            ++regressions;
+        } else if (change < -threshold && measurement.median < base.min) {
+            out << "  improved";
+        }
+        out << "\n";
+    }
+    out.flags(flags);
+
+    out << regressions << " regression" << (regressions == 1 ? "" : "s")
+        << " beyond " << threshold << "%\n";
+    return regressions;
+}
+
+} // namespace bench
+} // namespace sprout
+
+// vim: set ts=4 sw=4 :
@@ -0,0 +1,182 @@
+#ifndef SPROUT_BENCH_HARNESS_HEADER
+#define SPROUT_BENCH_HARNESS_HEADER
+
+#include <QElapsedTimer>
+#include <QString>
+
+#include <map>
+#include <string>
+#include <vector>
+#include <iostream>
+
+namespace sprout {
+namespace bench {
+
+/**
+ * The summarized timings of a single benchmark. All times are in nanoseconds
+ * per iteration.
+ */
+struct Measurement
+{
+    std::string group;
+    std::string name;
+
+    long long bytes;
+    int samples;
+    long long iterations;
+
+    double median;
+    double mean;
+    double stddev;
+    double min;
+    double max;
+    double p95;
+    double p99;
+
+    /**
+     * Additional named results of a benchmark, such as its throughput.
+     */
+    std::map<std::string, double> metrics;
+
+    std::string key() const
+    {
+        return group + "/" + name;
+    }
+
+    double nsPerByte() const
+    {
+        return bytes > 0 ? median / bytes : 0;
+    }
+};
+
+/**
+ * Summarizes the per-iteration times of a set of samples.
+ */
+Measurement summarize(std::vector<double> samples);
+
+/**
+ * \brief Runs benchmarks with warm-up and repeated sampling.
+ *
+ * The number of iterations per sample is first calibrated so that a sample
+ * takes at least the minimum sample time, which keeps timer overhead out of
+ * the results. The benchmark is then warmed up with a number of discarded
+ * samples. Finally, the configured number of samples is taken, and their
+ * distribution is summarized.
+ */
+class Harness
+{
+    int _samples;
+    int _warmup;
+    qint64 _minSampleTime;
+
+    std::string _group;
+    std::vector<Measurement> _measurements;
+
+    std::ostream& _out;
+
+    void record(const char* name, const long long bytes, const long long iterations, const std::vector<double>& samples);
+
+public:
+    Harness(std::ostream& out = std::cout);
+
+    void setSamples(const int samples)
+    {
+        _samples = samples;
+    }
+
+    void setWarmup(const int warmup)
+    {
+        _warmup = warmup;
+    }
+
+    void setMinSampleTime(const qint64 nanoseconds)
+    {
+        _minSampleTime = nanoseconds;
+    }
+
+    /**
+     * Sets the group of the following benchmarks, printing a header for them.
+     */
+    void setGroup(const std::string& group);
+
+    const std::vector<Measurement>& measurements() const
+    {
+        return _measurements;
+    }
+
+    /**
+     * Records an additional named result for the most recent benchmark.
+     */
+    void setMetric(const std::string& name, const double value)
+    {
+        if (!_measurements.empty()) {
+            _measurements.back().metrics[name] = value;
+        }
+    }
+
+    /**
+     * Runs the specified benchmark, where bytes is the size of the input that a
+     * single iteration processes.
+     */
+    template <class Runner>
+    void run(const char* name, Runner runner, const long long bytes = 0)
+    {
+        QElapsedTimer timer;
+
+        // Calibrate the iterations per sample, then warm up with full samples
+        long long iterations = 1;
+        int warmed = 0;
+        while (true) {
+            timer.start();
+            for (long long j = 0; j < iterations; ++j) {
+                runner();
+            }
+            if (timer.nsecsElapsed() < _minSampleTime) {
+                iterations *= 2;
+                continue;
+            }
+            if (++warmed >= _warmup) {
+                break;
+            }
+        }
+
+        std::vector<double> samples;
+        samples.reserve(_samples);
+        for (int i = 0; i < _samples; ++i) {
+            timer.start();
+            for (long long j = 0; j < iterations; ++j) {
+                runner();
+            }
+            samples.push_back(static_cast<double>(timer.nsecsElapsed()) / iterations);
+        }
+
+        record(name, bytes, iterations, samples);
+    }
+
+    /**
+     * Writes all measurements as JSON to the specified file.
+     */
+    bool writeJson(const QString& path) const;
+
+    static bool readJson(const QString& path, std::vector<Measurement>& measurements);
+};
+
+/**
+ * Compares the medians of two sets of measurements, printing a table of their
+ * changes. Benchmarks whose median slowed down by more than the threshold
+ * percentage, and beyond the 95th percentile of the baseline, are flagged as
+ * regressions. Returns the number of regressions.
+ */
+int compare(
+    const std::vector<Measurement>& baseline,
+    const std::vector<Measurement>& current,
+    const double threshold,
+    std::ostream& out
+);
+
+} // namespace bench
+} // namespace sprout
+
+#endif // SPROUT_BENCH_HARNESS_HEADER
+
+// vim: set ts=4 sw=4 :
@@ -11,6 +11,10 @@
 #include <rule/Reduce.hpp>
 
 #include <StreamIterator.hpp>
+#include <CharClass.hpp>
+#include <StructuralIndex.hpp>
+
+#include "bench/Harness.hpp"
 
 #include <QString>
 #include <QChar>
@@ -27,43 +31,119 @@
 
 #include <iostream>
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
 
 using namespace sprout;
 
-const int RUNS = 1e5;
-
-template <class Runner>
-void runBenchmark(const char* name, Runner runner)
+/**
+ * The number parser that parseFloating replaced, kept as a baseline. It uses
+ * QChar::digitValue, allocates a result for the whole number, and scales the
+ * fraction with std::pow.
+ */
+bool legacyParseFloating(Cursor<QChar>& orig, Result<double>& tokens)
 {
-    QElapsedTimer timer;
-    timer.start();
+    auto iter = orig;
 
-    for (int i = 0; i < RUNS; ++i) {
-        runner();
+    int sign = 1;
+    long whole = 0;
+    if (*iter == '-') {
+        sign = -1;
+        ++iter;
+    }
+    Result<long> nums;
+    while (iter && (*iter).digitValue() >= 0) {
+        whole = whole * 10 + (*iter++).digitValue();
+    }
+    nums << sign * whole;
+    whole = *nums;
+
+    double fractionValue = 0;
+    if (iter && *iter == '.') {
+        ++iter;
+        long fraction = 0;
+        int magnitude = 0;
+        while (iter && (*iter).digitValue() >= 0) {
+            fraction = fraction * 10 + (*iter++).digitValue();
+            ++magnitude;
+        }
+        fractionValue = fraction * std::pow(10, -magnitude);
     }
 
-    std::cout << name << " took " << timer.elapsed() << " ms\n";
+    orig = iter;
+    tokens << (whole + fractionValue);
+    return true;
 }
 
-int main()
+int usage(const char* program)
+{
+    std::cerr << "usage: " << program << " [--samples N] [--warmup N] [--json FILE]\n"
+        << "       " << program << " --compare BASELINE CURRENT [--threshold PERCENT]\n";
+    return 2;
+}
+
+int compareResults(const QString& baselinePath, const QString& currentPath, const double threshold)
+{
+    std::vector<bench::Measurement> baseline;
+    if (!bench::Harness::readJson(baselinePath, baseline)) {
+        std::cerr << "I couldn't read benchmark results from " << baselinePath.toUtf8().constData() << "\n";
+        return 2;
+    }
+    std::vector<bench::Measurement> current;
+    if (!bench::Harness::readJson(currentPath, current)) {
+        std::cerr << "I couldn't read benchmark results from " << currentPath.toUtf8().constData() << "\n";
+        return 2;
+    }
+    return bench::compare(baseline, current, threshold, std::cout) > 0 ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
 {
     using namespace rule;
 
+    bench::Harness harness;
+    QString jsonPath;
+    QString comparePaths[2];
+    double threshold = 5;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if (arg == "--samples" && hasValue) {
+            harness.setSamples(std::stoi(argv[++i]));
+        } else if (arg == "--warmup" && hasValue) {
+            harness.setWarmup(std::stoi(argv[++i]));
+        } else if (arg == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (arg == "--threshold" && hasValue) {
+            threshold = std::stod(argv[++i]);
+        } else if (arg == "--compare" && i + 2 < argc) {
+            comparePaths[0] = argv[++i];
+            comparePaths[1] = argv[++i];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    if (!comparePaths[0].isNull()) {
+        return compareResults(comparePaths[0], comparePaths[1], threshold);
+    }
+
+    const auto nameChar = CharClass::letter().with('_');
+
     auto name = aggregate<QString>(
-        multiple(simplePredicate<QChar>([](const QChar& input) {
-            return input.isLetter() || input == '_';
-        })),
+        multiple(simplePredicate<QChar>(nameChar)),
         [](QString& aggregate, const QChar& c) {
             aggregate += c;
         }
     );
 
-    auto fastName = [](Cursor<QChar>& orig, Result<QString>& result) {
+    auto fastName = [&nameChar](Cursor<QChar>& orig, Result<QString>& result) {
         auto iter = orig;
         QString aggr;
         while (iter) {
             auto input = *iter++;
-            if (input.isLetter() || input == '_') {
+            if (nameChar(input)) {
                 aggr += input;
             } else {
                 break;
@@ -77,21 +157,18 @@ int main()
         return true;
     };
 
-    std::cout << "Running " << RUNS << " iteration" << (RUNS == 1 ? "" : "s") << "\n";
-    std::cout << std::endl;
-
     {
-        std::cout << "=== Parser Benchmarks ===\n";
+        harness.setGroup("Parser");
 
         const QString inputString("var bar");
         const QString targetString("bar");
 
         {
             QRegExp re("^var\\s+(\\w+)");
-            runBenchmark("RegExp", [&]() {
+            harness.run("RegExp", [&]() {
                 assert(re.indexIn(inputString, 0) == 0);
                 assert(re.cap(1) == targetString);
-            });
+            }, inputString.size());
         }
 
         {
@@ -105,13 +182,13 @@ int main()
             Result<QString> results;
             auto head = results.head();
 
-            runBenchmark("Sprout", [&]() {
+            harness.run("Sprout", [&]() {
                 results.moveHead(head);
                 auto iter = orig;
 
                 assert(benchmark(iter, results));
                 assert(targetString == *results);
-            });
+            }, inputString.size());
         }
 
         {
@@ -125,17 +202,17 @@ int main()
             Result<QString> results;
             auto head = results.head();
 
-            runBenchmark("Spfast", [&]() {
+            harness.run("Spfast", [&]() {
                 results.moveHead(head);
                 auto iter = orig;
 
                 assert(benchmark(iter, results));
                 assert(targetString == results.get());
-            });
+            }, inputString.size());
         }
 
         {
-            runBenchmark("Inline", [&]() {
+            harness.run("Inline", [&]() {
                 QString result;
 
                 if (!inputString.startsWith("var")) {
@@ -150,24 +227,22 @@ int main()
                     aggr += inputString.at(mark++);
                 }
                 assert(aggr == targetString);
-            });
+            }, inputString.size());
         }
-
-        std::cout << std::endl;
     }
 
     {
-        std::cout << "=== Direct Match Benchmarks ===\n";
+        harness.setGroup("Direct Match");
 
         const QString inputString("var");
         const QString targetString("var");
 
         {
             QRegExp re("^var");
-            runBenchmark("RegExp", [&]() {
+            harness.run("RegExp", [&]() {
                 assert(re.indexIn(inputString, 0) == 0);
                 assert(re.cap(0) == targetString);
-            });
+            }, inputString.size());
         }
 
         {
@@ -176,13 +251,13 @@ int main()
             Result<QString> results;
             auto head = results.head();
 
-            runBenchmark("Sprout", [&]() {
+            harness.run("Sprout", [&]() {
                 results.moveHead(head);
                 auto iter = orig;
 
                 assert(benchmark(iter, results));
                 assert(results.get() == targetString);
-            });
+            }, inputString.size());
         }
 
         {
@@ -203,20 +278,20 @@ int main()
             Result<QString> results;
             auto head = results.head();
 
-            runBenchmark("Spfast", [&]() {
+            harness.run("Spfast", [&]() {
                 auto iter = orig;
                 results.moveHead(head);
 
                 assert(benchmark(iter, results));
                 assert(results.get() == targetString);
-            });
+            }, inputString.size());
         }
 
         #ifdef HAVE_BOOST
         {
             std::string input("varbar");
             std::string target("bar");
-            runBenchmark("Booost", [&]() {
+            harness.run("Booost", [&]() {
                 namespace qi = boost::spirit::qi;
                 namespace ascii = boost::spirit::ascii;
                 namespace phoenix = boost::phoenix;
@@ -235,26 +310,24 @@ int main()
 
                 assert(result);
                 assert(word == target);
-            });
+            }, input.size());
         }
         #endif
-
-        std::cout << std::endl;
     }
 
 
     {
-        std::cout << "=== Aggregating Match Benchmarks ===\n";
+        harness.setGroup("Aggregating Match");
 
         const QString inputString("varbar");
         const QString targetString("bar");
 
         {
             QRegExp re("^var(\\w+)");
-            runBenchmark("RegExp", [&]() {
+            harness.run("RegExp", [&]() {
                 assert(re.indexIn(inputString, 0) == 0);
                 assert(re.cap(1) == targetString);
-            });
+            }, inputString.size());
         }
 
         {
@@ -267,13 +340,13 @@ int main()
             Result<QString> results;
             auto head = results.head();
 
-            runBenchmark("Sprout", [&]() {
+            harness.run("Sprout", [&]() {
                 results.moveHead(head);
                 auto iter = orig;
 
                 assert(benchmark(iter, results));
                 assert(results.get() == targetString);
-            });
+            }, inputString.size());
         }
 
         {
@@ -286,20 +359,20 @@ int main()
             Result<QString> results;
             auto head = results.head();
 
-            runBenchmark("Spfast", [&]() {
+            harness.run("Spfast", [&]() {
                 results.moveHead(head);
                 auto iter = orig;
 
                 assert(benchmark(iter, results));
                 assert(results.get() == targetString);
-            });
+            }, inputString.size());
         }
 
         #ifdef HAVE_BOOST
         {
             std::string inputString = "varbar";
             std::string targetString = "bar";
-            runBenchmark("Booost", [&]() {
+            harness.run("Booost", [&]() {
                 namespace qi = boost::spirit::qi;
                 namespace ascii = boost::spirit::ascii;
                 namespace phoenix = boost::phoenix;
@@ -320,25 +393,23 @@ int main()
 
                 assert(result);
                 assert(word == targetString);
-            });
+            }, inputString.size());
         }
         #endif
-
-        std::cout << std::endl;
     }
 
     {
-        std::cout << "=== Whitespace Match Benchmarks ===\n";
+        harness.setGroup("Whitespace Match");
 
         const QString inputString(" foo");
         const QString targetString("foo");
 
         {
             QRegExp re("^\\s+(foo)");
-            runBenchmark("RegExp", [&]() {
+            harness.run("RegExp", [&]() {
                 assert(re.indexIn(inputString, 0) == 0);
                 assert(re.cap(1) == targetString);
-            });
+            }, inputString.size());
         }
 
         {
@@ -355,13 +426,13 @@ int main()
             Result<QString> results;
             auto head = results.head();
 
-            runBenchmark("Sprout", [&]() {
+            harness.run("Sprout", [&]() {
                 auto iter = orig;
                 results.moveHead(head);
 
                 assert(benchmark(iter, results));
                 assert(results.get() == targetString);
-            });
+            }, inputString.size());
         }
 
         {
@@ -374,20 +445,20 @@ int main()
             auto head = results.head();
             auto orig = makeCursor<QChar>(&inputString);
 
-            runBenchmark("Spfast", [&]() {
+            harness.run("Spfast", [&]() {
                 results.moveHead(head);
                 auto iter = orig;
 
                 assert(benchmark(iter, results));
                 assert(*results == targetString);
-            });
+            }, inputString.size());
         }
 
         #ifdef HAVE_BOOST
         {
             std::string input(" foo");
             std::string target("foo");
-            runBenchmark("Booost", [&]() {
+            harness.run("Booost", [&]() {
                 namespace qi = boost::spirit::qi;
                 namespace ascii = boost::spirit::ascii;
                 namespace phoenix = boost::phoenix;
@@ -406,25 +477,23 @@ int main()
 
                 assert(result);
                 assert(word == target);
-            });
+            }, input.size());
         }
         #endif
-
-        std::cout << std::endl;
     }
 
     {
-        std::cout << "=== Lazy Match Benchmarks ===\n";
+        harness.setGroup("Lazy Match");
 
         const QString inputString("foo #notime");
         const QString targetString("foo");
 
         {
             QRegExp re("^(foo)\\s*(#.*)?$");
-            runBenchmark("RegExp", [&]() {
+            harness.run("RegExp", [&]() {
                 assert(re.indexIn(inputString, 0) == 0);
                 assert(re.cap(1) == targetString);
-            });
+            }, inputString.size());
         }
 
         {
@@ -447,13 +516,13 @@ int main()
             Result<QString> results;
             auto head = results.head();
 
-            runBenchmark("Sprout", [&]() {
+            harness.run("Sprout", [&]() {
                 results.moveHead(head);
                 auto iter = orig;
 
                 assert(benchmark(iter, results));
                 assert(results.get() == targetString);
-            });
+            }, inputString.size());
         }
 
         {
@@ -476,20 +545,20 @@ int main()
             Result<QString> results;
             auto head = results.head();
 
-            runBenchmark("Spfast", [&]() {
+            harness.run("Spfast", [&]() {
                 auto iter = orig;
                 results.moveHead(head);
 
                 assert(benchmark(iter, results));
                 assert(results.get() == targetString);
-            });
+            }, inputString.size());
         }
 
         #ifdef HAVE_BOOST
         {
             auto input = inputString.toStdString();
             auto target = targetString.toStdString();
-            runBenchmark("Booost", [&]() {
+            harness.run("Booost", [&]() {
                 namespace qi = boost::spirit::qi;
                 namespace ascii = boost::spirit::ascii;
                 namespace phoenix = boost::phoenix;
@@ -509,33 +578,113 @@ int main()
 
                 assert(result);
                 assert(word == target);
-            });
+            }, input.size());
         }
         #endif
+    }
+
+    {
+        harness.setGroup("Number Match");
+
+        const QString inputString("3.14159265358979");
+        const double target = 3.14159265358979;
+
+        {
+            auto orig = makeCursor<QChar>(&inputString);
+            harness.run("Legacy", [&]() {
+                auto iter = orig;
+                Result<double> results;
+                assert(legacyParseFloating(iter, results));
+                assert(std::abs(*results - target) < 1e-12);
+            }, inputString.size());
+        }
 
-        std::cout << std::endl;
+        {
+            auto orig = makeCursor<QChar>(&inputString);
+            harness.run("Sprout", [&]() {
+                auto iter = orig;
+                Result<double> results;
+                assert(rule::parseFloating(iter, results));
+                assert(*results == target);
+            }, inputString.size());
+        }
+
+        {
+            auto orig = makeIndexedCursor<QChar>(&inputString);
+            harness.run("Indexed", [&]() {
+                auto iter = orig;
+                Result<double> results;
+                assert(rule::parseFloating(iter, results));
+                assert(*results == target);
+            }, inputString.size());
+        }
+
+        {
+            auto input = inputString.toStdString();
+            harness.run("strtod", [&]() {
+                assert(std::strtod(input.c_str(), nullptr) == target);
+            }, input.size());
+        }
     }
 
     {
-        std::cout << "=== Cursor Benchmarks ===\n";
+        harness.setGroup("String Match");
+
+        const QString inputString("'a string literal of the kind that fills Lua data tables'");
+        const QString targetString("a string literal of the kind that fills Lua data tables");
+
+        {
+            auto orig = makeCursor<QChar>(&inputString);
+            harness.run("Sprout", [&]() {
+                auto iter = orig;
+                Result<QString> results;
+                assert(rule::parseQuotedString(iter, results));
+                assert(*results == targetString);
+            }, inputString.size());
+        }
+
+        {
+            auto orig = makeIndexedCursor<QChar>(&inputString);
+            harness.run("Indexed", [&]() {
+                auto iter = orig;
+                Result<QString> results;
+                assert(rule::parseQuotedString(iter, results));
+                assert(*results == targetString);
+            }, inputString.size());
+        }
+
+        {
+            harness.run("Stream", [&]() {
+                QString copy(inputString);
+                QTextStream stream(&copy);
+                auto iter = makeCursor<QChar>(&stream);
+                Result<QString> results;
+                assert(rule::parseQuotedString(iter, results));
+                assert(*results == targetString);
+            }, inputString.size());
+        }
+    }
+
+    {
+        harness.setGroup("Cursor");
 
         {
             QString target("var foo");
             QString str("var foo");
-            runBenchmark("Sprout", [&]() {
+            harness.run("Sprout", [&]() {
                 auto cursor = makeCursor<QChar>(&str);
                 for (int j = 0; j < target.size(); ++j) {
                     if (target.at(j) != *cursor++) {
                         assert(false);
                     }
                 }
-            });
+            }, str.size());
         }
 
         {
             QString target("var foo");
             QString str("var foo");
-            runBenchmark("Inline", [&]() {
+            harness.run("Inline", [&]() {
                 QString result;
                 auto cursor = makeCursor<QChar>(&str);
                 result = "foo";
@@ -544,10 +693,15 @@ int main()
                         result = "";
                     }
                 }
-            });
+            }, str.size());
         }
     }
 
+    if (!jsonPath.isNull() && !harness.writeJson(jsonPath)) {
+        std::cerr << "I couldn't write benchmark results to " << jsonPath.toUtf8().constData() << "\n";
+        return 1;
+    }
+
     return 0;
 }
 
@@ -0,0 +1,258 @@
+#include <grammar/Grammar.hpp>
+#include <grammar/Node.hpp>
+#include <grammar/Generator.hpp>
+#include <grammar/pass/Flatten.hpp>
+#include <grammar/pass/LeftRecursion.hpp>
+
+#include <rule/rules.hpp>
+#include <rule/Proxy.hpp>
+#include <rule/Discard.hpp>
+#include <rule/Optional.hpp>
+#include <rule/Multiple.hpp>
+#include <rule/Alternative.hpp>
+#include <rule/Profile.hpp>
+
+#include <QString>
+#include <QTextStream>
+#include <QFile>
+
+#include <iostream>
+
+using namespace sprout;
+using namespace grammar;
+
+typedef Grammar<QString, QString> LuaGrammar;
+typedef LuaGrammar::PNode PNode;
+
+namespace {
+
+/**
+ * The number of rejected chunks in a row before generation is abandoned.
+ */
+const int MAX_REJECTED = 1000;
+
+/**
+ * The number of rejected chunks in a row before the previous chunk is discarded.
+ */
+const int BACKTRACK_REJECTED = 10;
+
+/**
+ * How much extra work a chunk may cause while the text that follows it is
+ * parsed, as a fraction of the work to parse that text alone.
+ */
+const double MAX_READ_AHEAD = 0.5;
+
+bool readFile(const char* filename, QString& contents)
+{
+    QFile file(filename);
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    QTextStream stream(&file);
+    stream.setCodec("UTF-8");
+    contents = stream.readAll();
+    return true;
+}
+
+/**
+ * Parses the text, returning whether it was read completely. The number of rule
+ * invocations that were needed is written to work.
+ */
+template <class Parser>
+bool parse(Parser& parser, rule::Profiler& profiler, const QString& text, long& work)
+{
+    profiler.clear();
+
+    auto cursor = makeCursor<QChar>(&text);
+    Result<PNode> nodes;
+    bool parsed = parser(cursor, nodes) && !cursor;
+
+    work = 0;
+    for (auto& stats : profiler.sorted()) {
+        work += stats.invocations;
+    }
+    return parsed;
+}
+
+} // namespace anonymous
+
+int usage(const char* program)
+{
+    std::cerr << "usage: " << program << " GRAMMAR OUTPUT [--rule NAME] [--size BYTES] [--seed N]\n"
+        << "    [--depth N] [--repeat N] [--optional CHANCE] [--weight RULE=WEIGHT]... [--no-verify]\n";
+    return 2;
+}
+
+/**
+ * Writes a random program of at least the requested size, generated from the
+ * specified grammar.
+ *
+ * The program is generated in chunks, each an instance of the starting rule
+ * on its own line. The starting rule must therefore be one that can be
+ * repeated, such as a list of statements.
+ *
+ * Unless disabled, every chunk is parsed with the built grammar, together with
+ * the chunk before it, and any chunk that isn't read completely is rejected. A
+ * chunk is also rejected if it's misread in a way that makes the parser read
+ * far past it, such as when a keyword is taken for a name. Each of these
+ * chunks makes the parse of the whole program slower by the length of the
+ * text that follows it, so they're detected by parsing the chunk before some
+ * known-good text and counting the extra rule invocations.
+ */
+int main(int argc, char* argv[])
+{
+    QString ruleName("main");
+    int minimumSize = 1 << 20;
+    unsigned int seed = 0;
+    bool verify = true;
+
+    QHash<QString, double> weights;
+    int depth = -1;
+    int repeat = -1;
+    double optionalChance = -1;
+
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if (arg == "--rule" && hasValue) {
+            ruleName = argv[++i];
+        } else if (arg == "--size" && hasValue) {
+            minimumSize = std::stoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            seed = std::stoul(argv[++i]);
+        } else if (arg == "--depth" && hasValue) {
+            depth = std::stoi(argv[++i]);
+        } else if (arg == "--repeat" && hasValue) {
+            repeat = std::stoi(argv[++i]);
+        } else if (arg == "--optional" && hasValue) {
+            optionalChance = std::stod(argv[++i]);
+        } else if (arg == "--weight" && hasValue) {
+            std::string weight(argv[++i]);
+            auto equals = weight.find('=');
+            if (equals == std::string::npos) {
+                return usage(argv[0]);
+            }
+            weights[QString::fromStdString(weight.substr(0, equals))] = std::stod(weight.substr(equals + 1));
+        } else if (arg == "--no-verify") {
+            verify = false;
+        } else if (arg.substr(0, 2) == "--") {
+            return usage(argv[0]);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.size() != 2) {
+        return usage(argv[0]);
+    }
+
+    LuaGrammar grammar;
+    {
+        QString text;
+        if (!readFile(files[0], text)) {
+            std::cerr << "I couldn't open " << files[0] << " for reading\n";
+            return 1;
+        }
+        QTextStream stream(&text);
+        auto cursor = makeCursor<QChar>(&stream);
+        grammar.readGrammar(cursor);
+    }
+
+    // The generator reads the rules as they were written, before any passes
+    Generator generator(grammar.parsedRules(), seed);
+    if (depth >= 0) {
+        generator.setMaxDepth(depth);
+    }
+    if (repeat >= 0) {
+        generator.setMaxRepeat(repeat);
+    }
+    if (optionalChance >= 0) {
+        generator.setOptionalChance(optionalChance);
+    }
+    for (auto iter = weights.begin(); iter != weights.end(); ++iter) {
+        generator.setWeight(iter.key(), iter.value());
+    }
+
+    auto flattenPass = pass::Flatten<TokenType, QString>({
+        TokenType::Alternative,
+        TokenType::Sequence
+    });
+    flattenPass(grammar);
+    pass::LeftRecursion()(grammar);
+    flattenPass(grammar);
+
+    // Invocations are counted rather than timed, so that verification is deterministic
+    auto profiler = std::make_shared<rule::Profiler>();
+    grammar.setProfiler(profiler);
+    grammar.build();
+
+    auto ws = rule::discard(rule::optional(rule::multiple(rule::tupleAlternative<QChar, PNode>(
+        rule::whitespace<PNode>(),
+        rule::convert<PNode>(rule::lineComment("--"), [](const QString&) {
+            return PNode();
+        })
+    ))));
+    auto parser = rule::proxySequence<QChar, PNode>(
+        ws,
+        grammar[ruleName.toUtf8().constData()]
+    );
+
+    std::vector<QString> chunks;
+    int size = 0;
+    int rejected = 0;
+    int rejectedInRow = 0;
+    while (size < minimumSize) {
+        QString chunk = generator.generate(ruleName) + "\n";
+        if (verify) {
+            // Chunks are checked with their predecessor, since a chunk can change how the
+            // end of the previous one is read
+            QString previous = chunks.empty() ? QString() : chunks.back();
+            QString probe = chunks.empty() ? chunk : previous;
+
+            long work, probeWork, followedWork;
+            bool valid = parse(parser, *profiler, previous + chunk, work)
+                && parse(parser, *profiler, probe, probeWork)
+                && parse(parser, *profiler, previous + chunk + probe, followedWork)
+                && followedWork - work - probeWork <= probeWork * MAX_READ_AHEAD;
+            if (!valid) {
+                ++rejected;
+                if (++rejectedInRow >= MAX_REJECTED) {
+                    std::cerr << "I couldn't generate a valid '" << ruleName.toUtf8().constData()
+                        << "' after " << MAX_REJECTED << " attempts\n";
+                    return 1;
+                }
+                if (rejectedInRow % BACKTRACK_REJECTED == 0 && !chunks.empty()) {
+                    // Some chunks are only read completely when nothing follows them
+                    size -= chunks.back().size();
+                    chunks.pop_back();
+                }
+                continue;
+            }
+        }
+        rejectedInRow = 0;
+        chunks.push_back(chunk);
+        size += chunk.size();
+    }
+
+    QString program;
+    for (auto& chunk : chunks) {
+        program += chunk;
+    }
+
+    QFile output(files[1]);
+    if (!output.open(QFile::WriteOnly)) {
+        std::cerr << "I couldn't open " << files[1] << " for writing\n";
+        return 1;
+    }
+    output.write(program.toUtf8());
+
+    std::cout << "Generated " << program.size() << " characters in " << chunks.size() << " chunks";
+    if (verify) {
+        std::cout << ", rejecting " << rejected;
+    }
+    std::cout << "\n";
+
+    return 0;
+}
+
+// vim: set ts=4 sw=4 :
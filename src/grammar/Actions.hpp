@@ -0,0 +1,200 @@
+#ifndef SPROUT_GRAMMAR_ACTIONS_HEADER
+#define SPROUT_GRAMMAR_ACTIONS_HEADER
+
+#include <QHash>
+#include <QString>
+
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <typeinfo>
+
+namespace sprout {
+namespace grammar {
+
+/**
+ * \brief A value of any type that was produced by a semantic action, or a token.
+ */
+class SemanticValue
+{
+    std::shared_ptr<void> _value;
+    const std::type_info* _type;
+
+public:
+    SemanticValue() :
+        _type(nullptr)
+    {
+    }
+
+    template <class T>
+    static SemanticValue make(const T& value)
+    {
+        SemanticValue rv;
+        rv._value = std::make_shared<T>(value);
+        rv._type = &typeid(T);
+        return rv;
+    }
+
+    template <class T>
+    bool is() const
+    {
+        return _type && *_type == typeid(T);
+    }
+
+    /**
+     * Returns the value, which must be of the specified type.
+     */
+    template <class T>
+    T& as() const
+    {
+        if (!is<T>()) {
+            std::stringstream str;
+            str << "A semantic value of type " << (_type ? _type->name() : "void")
+                << " was used as a " << typeid(T).name();
+            throw std::runtime_error(str.str());
+        }
+        return *static_cast<T*>(_value.get());
+    }
+};
+
+/**
+ * \brief The values that a rule matched, which are passed to its semantic action.
+ *
+ * Values are those of the actions of the rule's subrules, and the tokens that
+ * it matched, which are nodes. Rules without an action pass their values
+ * through to the rule that used them, as groups do.
+ */
+template <class Node>
+class ActionValues
+{
+    const SemanticValue* _values;
+    const int _size;
+    const int _start;
+    const int _end;
+
+public:
+    ActionValues(const SemanticValue* values, const int size, const int start, const int end) :
+        _values(values),
+        _size(size),
+        _start(start),
+        _end(end)
+    {
+    }
+
+    int size() const
+    {
+        return _size;
+    }
+
+    template <class T>
+    bool is(const int index) const
+    {
+        return index >= 0 && index < _size && _values[index].template is<T>();
+    }
+
+    template <class T>
+    T& get(const int index) const
+    {
+        if (index < 0 || index >= _size) {
+            throw std::out_of_range("The rule did not match that many values");
+        }
+        return _values[index].template as<T>();
+    }
+
+    /**
+     * Returns the token at the index.
+     */
+    const Node& token(const int index) const
+    {
+        return get<Node>(index);
+    }
+
+    /**
+     * Returns the value of the token at the index, such as the text of a name.
+     */
+    typename Node::value_type text(const int index) const
+    {
+        return token(index).value();
+    }
+
+    /**
+     * Returns where the rule started.
+     */
+    int start() const
+    {
+        return _start;
+    }
+
+    /**
+     * Returns the end of the last token that the rule matched.
+     */
+    int end() const
+    {
+        return _end;
+    }
+};
+
+/**
+ * \brief Semantic actions that construct typed values from named rules.
+ *
+ * An action is bound to a named rule, and is called with the values that
+ * the rule matched once it matches, returning the rule's value. Actions for
+ * Token and opaque rules are called with the single token that they matched.
+ *
+ * Actions may be called for matches that are later backtracked over, and
+ * their values discarded, so they shouldn't have side effects.
+ */
+template <class Node>
+class Actions
+{
+public:
+    typedef std::function<SemanticValue(const ActionValues<Node>&)> Action;
+
+private:
+    QHash<QString, Action> _actions;
+
+public:
+    /**
+     * Binds the action to the named rule. The action takes the rule's
+     * ActionValues, and returns a T.
+     */
+    template <class T, class Function>
+    void on(const QString& name, const Function& action)
+    {
+        _actions[name] = [action](const ActionValues<Node>& values) {
+            return SemanticValue::make<T>(action(values));
+        };
+    }
+
+    void remove(const QString& name)
+    {
+        _actions.remove(name);
+    }
+
+    bool contains(const QString& name) const
+    {
+        return _actions.contains(name);
+    }
+
+    /**
+     * Returns the action for the named rule, or nullptr if it has none.
+     */
+    const Action* find(const QString& name) const
+    {
+        auto iter = _actions.find(name);
+        return iter == _actions.end() ? nullptr : &iter.value();
+    }
+
+    bool empty() const
+    {
+        return _actions.isEmpty();
+    }
+};
+
+} // namespace grammar
+} // namespace sprout
+
+#endif // SPROUT_GRAMMAR_ACTIONS_HEADER
+
+// vim: set ts=4 sw=4 :
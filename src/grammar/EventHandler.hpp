@@ -0,0 +1,45 @@
+#ifndef SPROUT_GRAMMAR_EVENTHANDLER_HEADER
+#define SPROUT_GRAMMAR_EVENTHANDLER_HEADER
+
+namespace sprout {
+namespace grammar {
+
+/**
+ * \brief Receives the structure of a parse as a stream of events, instead of a tree.
+ *
+ * The events describe the nodes that the grammar would have built, in the
+ * order that a walk of the tree would visit them. A node with children is
+ * an enterRule() and an exitRule() around the events of its children, and
+ * every other node is a token(). Spans are the positions of the cursor, where
+ * the end is past the last token of the node, not including trailing trivia.
+ *
+ * Events are only sent once no backtracking can undo them, so a handler never
+ * sees a match that's later discarded.
+ */
+template <class Type, class Value>
+class EventHandler
+{
+public:
+    virtual ~EventHandler()
+    {
+    }
+
+    virtual void enterRule(const Type& name, const int start)
+    {
+    }
+
+    virtual void exitRule(const Type& name, const int start, const int end)
+    {
+    }
+
+    virtual void token(const Type& type, const Value& value, const int start, const int end)
+    {
+    }
+};
+
+} // namespace grammar
+} // namespace sprout
+
+#endif // SPROUT_GRAMMAR_EVENTHANDLER_HEADER
+
+// vim: set ts=4 sw=4 :
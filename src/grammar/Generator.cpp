@@ -0,0 +1,349 @@
+#include <grammar/Generator.hpp>
+
+#include <sstream>
+#include <stdexcept>
+
+namespace sprout {
+namespace grammar {
+
+namespace {
+
+/**
+ * The depth of a rule that can never terminate.
+ */
+const int UNBOUNDED = 1 << 20;
+
+/**
+ * The number of times a token is regenerated before giving up on avoiding the
+ * grammar's reserved words.
+ */
+const int TOKEN_ATTEMPTS = 100;
+
+const char* LETTERS = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+const char* DIGITS = "0123456789";
+
+bool isWord(const QString& text)
+{
+    if (text.isEmpty() || !(text[0].isLetter() || text[0] == '_')) {
+        return false;
+    }
+    for (auto c : text) {
+        if (!c.isLetterOrNumber() && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+void collectWords(const GNode& node, QSet<QString>& words)
+{
+    if (node.type() == TokenType::Literal && isWord(node.value())) {
+        words << node.value();
+    }
+    for (auto& child : node.children()) {
+        collectWords(child, words);
+    }
+}
+
+} // namespace anonymous
+
+Generator::Generator(const QHash<QString, GNode>& rules, const unsigned int seed) :
+    _rules(rules),
+    _engine(seed),
+    _maxDepth(8),
+    _maxRepeat(3),
+    _optionalChance(0.5),
+    _repeatChance(0.5)
+{
+    _opaqueRules["alpha"] = [](Generator& generator) {
+        return QString(LETTERS[generator.random(52)]);
+    };
+    _opaqueRules["alnum"] = [](Generator& generator) {
+        if (generator.random(4) == 0) {
+            return QString(DIGITS[generator.random(10)]);
+        }
+        return QString(LETTERS[generator.random(52)]);
+    };
+    _opaqueRules["string"] = [](Generator& generator) {
+        QString str("\"");
+        int length = generator.random(12);
+        for (int i = 0; i < length; ++i) {
+            str += LETTERS[generator.random(26)];
+        }
+        return str + "\"";
+    };
+    _opaqueRules["number"] = [](Generator& generator) {
+        QString number = QString::number(generator.random(1000));
+        if (generator.random(4) == 0) {
+            number += "." + QString::number(generator.random(100));
+        }
+        return number;
+    };
+
+    for (auto& rule : _rules) {
+        collectWords(rule, _reserved);
+    }
+
+    computeMinDepths();
+}
+
+void Generator::computeMinDepths()
+{
+    for (auto iter = _rules.begin(); iter != _rules.end(); ++iter) {
+        _minDepths[iter.key()] = UNBOUNDED;
+    }
+
+    // Depths only decrease, so repeat until they settle
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto iter = _rules.begin(); iter != _rules.end(); ++iter) {
+            int depth = nodeDepth(iter.value()[0]);
+            if (depth < _minDepths[iter.key()]) {
+                _minDepths[iter.key()] = depth;
+                changed = true;
+            }
+        }
+    }
+}
+
+int Generator::nodeDepth(const GNode& node) const
+{
+    switch (node.type()) {
+        case TokenType::Literal:
+        case TokenType::Opaque:
+        case TokenType::Cut:
+            return 0;
+        case TokenType::Name:
+        {
+            int depth = _minDepths.value(node.value(), UNBOUNDED);
+            return depth >= UNBOUNDED ? UNBOUNDED : depth + 1;
+        }
+        case TokenType::Sequence:
+        {
+            int depth = 0;
+            for (auto& child : node.children()) {
+                depth = std::max(depth, nodeDepth(child));
+            }
+            return depth;
+        }
+        case TokenType::Alternative:
+        {
+            int depth = UNBOUNDED;
+            for (auto& child : node.children()) {
+                depth = std::min(depth, nodeDepth(child));
+            }
+            return depth;
+        }
+        case TokenType::Optional:
+        case TokenType::ZeroOrMore:
+            return 0;
+        case TokenType::Join:
+            return std::max(nodeDepth(node[0]), nodeDepth(node[1]));
+        case TokenType::OneOrMore:
+        case TokenType::Discard:
+        case TokenType::Recursive:
+            return nodeDepth(node[0]);
+        default:
+        {
+            std::stringstream str;
+            str << "I don't know how to generate a " << node.type() << " rule";
+            throw std::runtime_error(str.str());
+        }
+    }
+}
+
+int Generator::minDepth(const QString& name) const
+{
+    return _minDepths.value(name, UNBOUNDED);
+}
+
+bool Generator::isReserved(const QString& text) const
+{
+    for (auto& word : _reserved) {
+        if (text.startsWith(word)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+double Generator::weight(const GNode& node) const
+{
+    if (node.type() == TokenType::Name) {
+        return _weights.value(node.value(), 1);
+    }
+    return 1;
+}
+
+unsigned int Generator::random(const unsigned int bound)
+{
+    return _engine() % bound;
+}
+
+double Generator::chance()
+{
+    return _engine() / 4294967296.0;
+}
+
+void Generator::emit(const QString& text, const bool token, QString& out)
+{
+    if (!token && !out.isEmpty() && !text.isEmpty() && !out[out.size() - 1].isSpace()) {
+        out += ' ';
+    }
+    out += text;
+}
+
+QString Generator::generate(const QString& name)
+{
+    if (!_rules.contains(name)) {
+        std::stringstream str;
+        str << "The named rule '" << name.toUtf8().constData() << "' could not be resolved";
+        throw std::runtime_error(str.str());
+    }
+    if (minDepth(name) >= UNBOUNDED) {
+        std::stringstream str;
+        str << "The named rule '" << name.toUtf8().constData() << "' can never terminate";
+        throw std::runtime_error(str.str());
+    }
+
+    QString out;
+    generateRule(name, std::max(_maxDepth, minDepth(name)), false, out);
+    return out;
+}
+
+void Generator::generateRule(const QString& name, const int depth, const bool token, QString& out)
+{
+    const GNode& rule = _rules[name];
+    if (token || rule.type() != TokenType::TokenRule) {
+        generate(rule[0], depth, token, out);
+        return;
+    }
+
+    for (int i = 0; i < TOKEN_ATTEMPTS; ++i) {
+        QString text;
+        generate(rule[0], depth, true, text);
+        if (!isReserved(text)) {
+            emit(text, token, out);
+            return;
+        }
+    }
+
+    std::stringstream str;
+    str << "I couldn't generate a '" << name.toUtf8().constData() << "' token that avoids the grammar's reserved words";
+    throw std::runtime_error(str.str());
+}
+
+void Generator::generate(const GNode& node, const int depth, const bool token, QString& out)
+{
+    auto repeat = [&](const GNode& child, const int minimum) {
+        int count = minimum;
+        while (count < _maxRepeat && nodeDepth(child) <= depth && chance() < _repeatChance) {
+            ++count;
+        }
+        return count;
+    };
+
+    switch (node.type()) {
+        case TokenType::Literal:
+            emit(node.value(), token, out);
+            break;
+        case TokenType::Opaque:
+        {
+            if (!_opaqueRules.contains(node.value())) {
+                std::stringstream str;
+                str << "I don't know how to generate the opaque rule '" << node.value().toUtf8().constData() << "'";
+                throw std::runtime_error(str.str());
+            }
+            emit(_opaqueRules[node.value()](*this), token, out);
+            break;
+        }
+        case TokenType::Name:
+            generateRule(node.value(), depth - 1, token, out);
+            break;
+        case TokenType::Sequence:
+            for (auto& child : node.children()) {
+                generate(child, depth, token, out);
+            }
+            break;
+        case TokenType::Alternative:
+        {
+            std::vector<const GNode*> choices;
+            double total = 0;
+            for (auto& child : node.children()) {
+                if (nodeDepth(child) <= depth) {
+                    choices.push_back(&child);
+                    total += weight(child);
+                }
+            }
+
+            const GNode* choice = choices.back();
+            if (total > 0) {
+                double target = chance() * total;
+                for (auto candidate : choices) {
+                    target -= weight(*candidate);
+                    if (target < 0) {
+                        choice = candidate;
+                        break;
+                    }
+                }
+            } else {
+                choice = choices[random(choices.size())];
+            }
+            generate(*choice, depth, token, out);
+            break;
+        }
+        case TokenType::Optional:
+            if (nodeDepth(node[0]) <= depth && chance() < _optionalChance) {
+                generate(node[0], depth, token, out);
+            }
+            break;
+        case TokenType::Discard:
+            generate(node[0], depth, token, out);
+            break;
+        case TokenType::Cut:
+            // Cuts don't match any input
+            break;
+        case TokenType::ZeroOrMore:
+        case TokenType::OneOrMore:
+        {
+            int count = repeat(node[0], node.type() == TokenType::OneOrMore ? 1 : 0);
+            for (int i = 0; i < count; ++i) {
+                generate(node[0], depth, token, out);
+            }
+            break;
+        }
+        case TokenType::Join:
+        {
+            int count = repeat(node[0], 1);
+            for (int i = 0; i < count; ++i) {
+                if (i > 0) {
+                    generate(node[1], depth, token, out);
+                }
+                generate(node[0], depth, token, out);
+            }
+            break;
+        }
+        case TokenType::Recursive:
+        {
+            // The terminal is followed by any number of the recursive suffix
+            generate(node[0], depth, token, out);
+            int count = repeat(node[1], 0);
+            for (int i = 0; i < count; ++i) {
+                generate(node[1], depth, token, out);
+            }
+            break;
+        }
+        default:
+        {
+            std::stringstream str;
+            str << "I don't know how to generate a " << node.type() << " rule";
+            throw std::runtime_error(str.str());
+        }
+    }
+}
+
+} // namespace grammar
+} // namespace sprout
+
+// vim: set ts=4 sw=4 :
@@ -0,0 +1,152 @@
+#ifndef SPROUT_GRAMMAR_GENERATOR_HEADER
+#define SPROUT_GRAMMAR_GENERATOR_HEADER
+
+#include "Grammar.hpp"
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+#include <functional>
+#include <random>
+
+namespace sprout {
+namespace grammar {
+
+/**
+ * \brief Generates random input that is described by a grammar.
+ *
+ * The generator walks the parsed rules of a grammar, choosing randomly among
+ * alternatives, optional subrules and repetitions. Every named rule is given a
+ * minimum depth, which is the fewest nested rules it needs to terminate. Once
+ * the depth limit is approached, only the choices that can still terminate are
+ * taken, so generation always finishes.
+ *
+ * Output is deterministic for a given seed and set of options. The random
+ * engine is a std::mt19937, whose sequence is fixed by the standard, and no
+ * standard distributions are used, since their results vary between
+ * implementations.
+ *
+ * Literals are matched without regard to word boundaries, so an identifier
+ * like "endless" would be read as the 'end' literal. Token rules therefore
+ * never produce text that begins with a word-like literal of the grammar.
+ *
+ * The generator reads rules as they are parsed, though it also understands the
+ * recursive rules created by the LeftRecursion pass. Since it follows the
+ * grammar's structure rather than its ordered-choice semantics, text may still
+ * be generated that the built parser reads differently, so callers that need
+ * valid input should verify it with the parser.
+ */
+class Generator
+{
+public:
+    typedef std::function<QString(Generator&)> OpaqueGenerator;
+
+private:
+    QHash<QString, GNode> _rules;
+    QHash<QString, int> _minDepths;
+    QHash<QString, double> _weights;
+    QHash<QString, OpaqueGenerator> _opaqueRules;
+    QSet<QString> _reserved;
+
+    std::mt19937 _engine;
+
+    int _maxDepth;
+    int _maxRepeat;
+    double _optionalChance;
+    double _repeatChance;
+
+    void computeMinDepths();
+    int nodeDepth(const GNode& node) const;
+
+    void generate(const GNode& node, const int depth, const bool token, QString& out);
+    void generateRule(const QString& name, const int depth, const bool token, QString& out);
+    void emit(const QString& text, const bool token, QString& out);
+
+    bool isReserved(const QString& text) const;
+    double weight(const GNode& node) const;
+
+public:
+    Generator(const QHash<QString, GNode>& rules, const unsigned int seed = 0);
+
+    void setSeed(const unsigned int seed)
+    {
+        _engine.seed(seed);
+    }
+
+    /**
+     * Sets the number of nested rules that may be expanded before only the
+     * shortest choices are taken.
+     */
+    void setMaxDepth(const int depth)
+    {
+        _maxDepth = depth;
+    }
+
+    /**
+     * Sets the most times that a repeated subrule is generated.
+     */
+    void setMaxRepeat(const int repeat)
+    {
+        _maxRepeat = repeat;
+    }
+
+    void setOptionalChance(const double chance)
+    {
+        _optionalChance = chance;
+    }
+
+    /**
+     * Sets the chance that a repeated subrule is generated again.
+     */
+    void setRepeatChance(const double chance)
+    {
+        _repeatChance = chance;
+    }
+
+    /**
+     * Sets the relative weight of the named rule when it's one of several
+     * alternatives. Rules are weighted 1 by default, and a rule with a weight
+     * of 0 is only chosen when no other alternative remains.
+     */
+    void setWeight(const QString& name, const double weight)
+    {
+        _weights[name] = weight;
+    }
+
+    /**
+     * Sets how text is generated for the named opaque rule. Generators for
+     * alpha, alnum, string and number are provided by default.
+     */
+    void setOpaque(const QString& name, const OpaqueGenerator& generator)
+    {
+        _opaqueRules[name] = generator;
+    }
+
+    /**
+     * Returns the fewest nested rules that the named rule needs to terminate.
+     */
+    int minDepth(const QString& name) const;
+
+    /**
+     * Generates a random instance of the named rule.
+     */
+    QString generate(const QString& name);
+
+    /**
+     * Returns a random number in [0, bound).
+     */
+    unsigned int random(const unsigned int bound);
+
+    /**
+     * Returns a random number in [0, 1).
+     */
+    double chance();
+};
+
+} // namespace grammar
+} // namespace sprout
+
+#endif // SPROUT_GRAMMAR_GENERATOR_HEADER
+
+// vim: set ts=4 sw=4 :
@@ -22,6 +22,7 @@ std::ostream& operator<<(std::ostream& stream, const sprout::grammar::TokenType&
         { TokenType::Alternative, "Alternative" },
         { TokenType::Sequence, "Sequence" },
         { TokenType::Recursive, "Recursive" },
+        { TokenType::Cut, "Cut" },
 
         { TokenType::ZeroOrMore, "ZeroOrMore" },
         { TokenType::Join, "Join" },
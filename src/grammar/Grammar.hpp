@@ -2,6 +2,9 @@
 #define SPROUT_GRAMMAR_HEADER
 
 #include "Node.hpp"
+#include "Lexer.hpp"
+#include "TokenDfa.hpp"
+#include "Actions.hpp"
 
 #include <rule/rules.hpp>
 #include <rule/Proxy.hpp>
@@ -17,8 +20,18 @@
 #include <rule/Reduce.hpp>
 #include <rule/Join.hpp>
 #include <rule/Recursive.hpp>
+#include <rule/Profile.hpp>
+#include <rule/Skip.hpp>
+#include <rule/Expect.hpp>
+#include <rule/Cut.hpp>
+#include <rule/Limit.hpp>
+#include <rule/Span.hpp>
 
 #include <unordered_map>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <set>
 #include <QElapsedTimer>
 #include <QSet>
 #include <QString>
@@ -76,6 +89,12 @@ enum class TokenType {
      */
     Discard,
 
+    /**
+     * A rule that commits to the current choice, written as ^. If the choice fails
+     * after it, the alternative or repetition that was trying it fails too.
+     */
+    Cut,
+
     // Convenience rules. These could be implemented using our primitives.
     Join,
     ZeroOrMore,
@@ -116,6 +135,9 @@ public:
     typedef Node<Type, Value> PNode;
     typedef rule::Proxy<QChar, PNode> PRule;
 
+    typedef grammar::Lexeme<PNode> LexemeType;
+    typedef rule::Proxy<LexemeType, PNode> LRule;
+
 private:
     typedef QHash<QString, rule::Shared<GRule>> RulesMap;
 
@@ -123,6 +145,25 @@ private:
     rule::Proxy<QChar, GNode> _grammarParser;
     QHash<QString, GNode> _parsedRules;
 
+    std::shared_ptr<rule::Profiler> _profiler;
+    QHash<QString, PRule> _opaqueRules;
+
+    Lexer<PNode> _lexer;
+    QHash<QString, rule::Shared<LRule>> _lexedRules;
+
+    QHash<QString, TokenDfa::CharClass> _charClasses;
+    bool _compileTokens;
+
+    /**
+     * Whether any rule has a cut, so choice points must respect them.
+     */
+    bool _cuts;
+
+    PRule _trivia;
+    rule::Skipper<QChar, PNode> _skipper;
+
+    Actions<PNode> _actions;
+
     rule::Proxy<QChar, GNode>& grammarParser()
     {
         return _grammarParser;
@@ -130,25 +171,561 @@ private:
 
     rule::Proxy<QChar, GNode> createGrammarParser();
 
-public:
-    Grammar()
+    void profileOpaqueRules()
     {
+        for (auto iter = _rules.begin(); iter != _rules.end(); ++iter) {
+            if (_parsedRules.contains(iter.key())) {
+                continue;
+            }
+            if (!_opaqueRules.contains(iter.key())) {
+                // Keep the original, so rebuilding doesn't profile a profiled rule
+                _opaqueRules[iter.key()] = *iter.value();
+            }
+            iter.value() = rule::profile(
+                iter.key().toStdString(),
+                _profiler,
+                _opaqueRules[iter.key()]
+            );
+        }
+    }
 
-        _rules["alpha"] = rule::Proxy<QChar, PNode>([](Cursor<QChar>& iter, Result<PNode>& result) {
-            if (iter && (*iter).isLetter()) {
-                result << PNode("", *iter++);
+    rule::Proxy<QChar, PNode> whitespace() const
+    {
+        return rule::discard(rule::optional(rule::multiple(rule::tupleAlternative<QChar, QString>(
+            rule::whitespace<QString>(),
+            rule::lineComment("--")
+        ))));
+    }
+
+    // These overloads build the parts of a rule that depend on whether it reads
+    // characters or lexemes.
+
+    /**
+     * Returns how a failure names the token, which quotes literals.
+     */
+    static std::string expectedName(const GNode& node)
+    {
+        if (node.type() == TokenType::Literal) {
+            return "'" + node.value().toStdString() + "'";
+        }
+        return node.value().toStdString();
+    }
+
+    /**
+     * Records the token as expected when it fails, and skips trivia after it,
+     * unless it's part of a Token rule.
+     */
+    rule::Proxy<QChar, PNode> buildToken(const rule::Proxy<QChar, PNode>& token, const GNode& node, const TokenType& ruleType) const
+    {
+        if (ruleType == TokenType::TokenRule) {
+            return token;
+        }
+        return rule::skip(rule::expect(rule::span(token), expectedName(node)), _skipper);
+    }
+
+    rule::Proxy<LexemeType, PNode> buildToken(const rule::Proxy<LexemeType, PNode>& token, const GNode& node, const TokenType&) const
+    {
+        // Trivia was already skipped by the lexer
+        return rule::expect(token, expectedName(node));
+    }
+
+    rule::Proxy<QChar, PNode> buildLiteral(const QString& value, const QChar*) const
+    {
+        return rule::qLiteral(value, PNode("", value));
+    }
+
+    rule::Proxy<LexemeType, PNode> buildLiteral(const QString& value, const LexemeType*) const
+    {
+        return matchLexeme(_lexer.literalKind(value), PNode("", value));
+    }
+
+    rule::Proxy<QChar, PNode> buildReference(const QString& name, const QChar*)
+    {
+        return _rules[name];
+    }
+
+    rule::Proxy<LexemeType, PNode> buildReference(const QString& name, const LexemeType*)
+    {
+        int kind = _lexer.ruleKind(name);
+        if (kind >= 0) {
+            return matchLexeme(kind);
+        }
+        return _lexedRules[name];
+    }
+
+    /**
+     * Returns a rule that matches a single lexeme of the specified kind,
+     * producing the lexeme's node.
+     */
+    static rule::Proxy<LexemeType, PNode> matchLexeme(const int kind)
+    {
+        return [kind](Cursor<LexemeType>& iter, Result<PNode>& result) {
+            if (!iter) {
+                return false;
+            }
+            LexemeType lexeme = *iter;
+            if (lexeme.kind != kind) {
+                return false;
+            }
+            lexeme.node.setSpan(lexeme.start, lexeme.end);
+            result << lexeme.node;
+            ++iter;
+            iter.setTokenEnd(lexeme.end);
+            return true;
+        };
+    }
+
+    /**
+     * Returns a rule that matches a single lexeme of the specified kind,
+     * producing the given node instead.
+     */
+    static rule::Proxy<LexemeType, PNode> matchLexeme(const int kind, const PNode& produced)
+    {
+        return [kind, produced](Cursor<LexemeType>& iter, Result<PNode>& result) {
+            if (!iter) {
+                return false;
+            }
+            LexemeType lexeme = *iter;
+            if (lexeme.kind != kind) {
+                return false;
+            }
+            PNode token(produced);
+            token.setSpan(lexeme.start, lexeme.end);
+            result << token;
+            ++iter;
+            iter.setTokenEnd(lexeme.end);
+            return true;
+        };
+    }
+
+    /**
+     * Returns the kind of the lexeme at the cursor, or the given end kind if
+     * there are no more lexemes. Lexemes in memory are read in place, rather
+     * than copying their nodes.
+     */
+    static int lexemeKind(Cursor<LexemeType>& iter, const int end)
+    {
+        if (!iter) {
+            return end;
+        }
+        const LexemeType* lexemes = iter.contiguous();
+        return lexemes ? lexemes[iter.pos()].kind : (*iter).kind;
+    }
+
+    /**
+     * \brief The kinds of lexemes that a rule can begin with.
+     */
+    struct FirstLexemes
+    {
+        std::set<int> kinds;
+
+        /**
+         * Whether the rule can match without reading any lexemes.
+         */
+        bool empty;
+
+        /**
+         * Whether the kinds could be determined. If not, the rule could begin
+         * with any lexeme.
+         */
+        bool known;
+
+        FirstLexemes() :
+            empty(false),
+            known(true)
+        {
+        }
+
+        void insert(const FirstLexemes& other)
+        {
+            kinds.insert(other.kinds.begin(), other.kinds.end());
+            known = known && other.known;
+        }
+    };
+
+    /**
+     * Returns the kinds of lexemes that the node can begin with when it's
+     * built to read lexemes. Rules that are already being visited are unknown,
+     * so left-recursive references can begin with anything.
+     */
+    FirstLexemes firstLexemes(const GNode& node, QSet<QString>& visiting) const
+    {
+        FirstLexemes first;
+        switch (node.type()) {
+            case TokenType::Literal:
+            {
+                const int kind = _lexer.literalKind(node.value());
+                if (kind < 0) {
+                    first.known = false;
+                } else {
+                    first.kinds.insert(kind);
+                }
+                return first;
+            }
+            case TokenType::Opaque:
+            case TokenType::Name:
+            {
+                const QString& name = node.value();
+                const int kind = _lexer.ruleKind(name);
+                if (kind >= 0) {
+                    first.kinds.insert(kind);
+                    return first;
+                }
+                if (!_parsedRules.contains(name) || visiting.contains(name)) {
+                    first.known = false;
+                    return first;
+                }
+                visiting << name;
+                first = firstLexemes(_parsedRules[name][0], visiting);
+                visiting.remove(name);
+                return first;
+            }
+            case TokenType::Sequence:
+            {
+                first.empty = true;
+                for (auto& child : node.children()) {
+                    if (!first.empty) {
+                        break;
+                    }
+                    FirstLexemes childFirst = firstLexemes(child, visiting);
+                    first.insert(childFirst);
+                    first.empty = childFirst.empty;
+                }
+                return first;
+            }
+            case TokenType::Alternative:
+            {
+                for (auto& child : node.children()) {
+                    FirstLexemes childFirst = firstLexemes(child, visiting);
+                    first.insert(childFirst);
+                    first.empty = first.empty || childFirst.empty;
+                }
+                return first;
+            }
+            case TokenType::ZeroOrMore:
+            case TokenType::Optional:
+            {
+                first = firstLexemes(node[0], visiting);
+                first.empty = true;
+                return first;
+            }
+            case TokenType::Cut:
+            {
+                first.empty = true;
+                return first;
+            }
+            case TokenType::Recursive:
+            case TokenType::Join:
+            case TokenType::Discard:
+            case TokenType::OneOrMore:
+            {
+                return firstLexemes(node[0], visiting);
+            }
+            default:
+            {
+                first.known = false;
+                return first;
+            }
+        }
+    }
+
+    static bool hasCut(const GNode& node)
+    {
+        if (node.type() == TokenType::Cut) {
+            return true;
+        }
+        for (auto& child : node.children()) {
+            if (hasCut(child)) {
                 return true;
             }
+        }
+        return false;
+    }
+
+    /**
+     * Returns an alternative over the choices, which fails as soon as a choice
+     * fails after a cut.
+     */
+    template <class Input>
+    static rule::Proxy<Input, PNode> buildChoices(const std::vector<rule::Proxy<Input, PNode>>& choices)
+    {
+        return [choices](Cursor<Input>& iter, Result<PNode>& result) {
+            for (auto& choice : choices) {
+                bool committed = false;
+                if (rule::choose(choice, iter, result, committed)) {
+                    return true;
+                }
+                if (committed) {
+                    return false;
+                }
+            }
             return false;
-        });
+        };
+    }
 
-        _rules["alnum"] = rule::Proxy<QChar, PNode>([](Cursor<QChar>& iter, Result<PNode>& result) {
-            if (iter && (*iter).isLetterOrNumber()) {
-                result << PNode("", *iter++);
-                return true;
+    /**
+     * Returns a rule that matches the repeated rule between min and max times,
+     * or any number of times if max is negative, which fails if a repetition
+     * fails after a cut.
+     */
+    template <class Input>
+    static rule::Proxy<Input, PNode> buildRepetition(const rule::Proxy<Input, PNode>& repeated, const int min, const int max)
+    {
+        return [repeated, min, max](Cursor<Input>& iter, Result<PNode>& result) {
+            int count = 0;
+            while (max < 0 || count < max) {
+                bool committed = false;
+                if (!rule::choose(repeated, iter, result, committed)) {
+                    if (committed) {
+                        return false;
+                    }
+                    break;
+                }
+                ++count;
+            }
+            return count >= min;
+        };
+    }
+
+    rule::Proxy<QChar, PNode> buildAlternative(const GNode& node, const TokenType& ruleType, const QChar*)
+    {
+        if (_cuts) {
+            std::vector<PRule> choices;
+            for (auto child : node.children()) {
+                choices.push_back(buildRule<QChar>(child, ruleType));
+            }
+            return buildChoices(choices);
+        }
+        rule::ProxyAlternative<QChar, PNode> rule;
+        for (auto child : node.children()) {
+            rule << buildRule<QChar>(child, ruleType);
+        }
+        return rule;
+    }
+
+    /**
+     * Builds an alternative that reads lexemes. Each choice is only tried if
+     * it can begin with the kind of the next lexeme, so alternatives that are
+     * led by keywords pick their choice with a single lookup. Choices whose
+     * first lexemes are unknown, or that can match nothing, are always tried.
+     *
+     * Choices that aren't tried can't record what they expected, so if every
+     * choice fails, the first lexemes of all of them are recorded instead.
+     */
+    rule::Proxy<LexemeType, PNode> buildAlternative(const GNode& node, const TokenType& ruleType, const LexemeType*)
+    {
+        std::vector<LRule> choices;
+        const int end = _lexer.kinds();
+
+        // The choices to try for each kind, and then for the end of the input
+        auto table = std::make_shared<std::vector<std::vector<LRule>>>(end + 1);
+        std::set<int> dispatchedKinds;
+        bool dispatched = false;
+        for (auto child : node.children()) {
+            LRule choice = buildRule<LexemeType>(child, ruleType);
+            choices.push_back(choice);
+
+            QSet<QString> visiting;
+            FirstLexemes first = firstLexemes(child, visiting);
+            if (!first.known || first.empty) {
+                for (auto& candidates : *table) {
+                    candidates.push_back(choice);
+                }
+                continue;
+            }
+            dispatched = true;
+            for (int kind : first.kinds) {
+                (*table)[kind].push_back(choice);
+                dispatchedKinds.insert(kind);
+            }
+        }
+
+        if (!dispatched && _cuts) {
+            return buildChoices(choices);
+        }
+        if (!dispatched) {
+            rule::ProxyAlternative<LexemeType, PNode> rule;
+            for (auto& choice : choices) {
+                rule << choice;
+            }
+            return rule;
+        }
+
+        auto expected = std::make_shared<std::vector<std::string>>();
+        for (int kind : dispatchedKinds) {
+            const QString& name = _lexer.name(kind);
+            if (_lexer.literalKind(name) == kind) {
+                expected->push_back("'" + name.toStdString() + "'");
+            } else {
+                expected->push_back(name.toStdString());
+            }
+        }
+
+        const bool cuts = _cuts;
+        return [table, end, expected, cuts](Cursor<LexemeType>& iter, Result<PNode>& result) {
+            for (auto& choice : (*table)[lexemeKind(iter, end)]) {
+                bool committed = false;
+                if (cuts ? rule::choose(choice, iter, result, committed) : choice(iter, result)) {
+                    return true;
+                }
+                if (committed) {
+                    return false;
+                }
+            }
+            for (auto& name : *expected) {
+                iter.failure().expect(iter.pos(), name);
             }
             return false;
-        });
+        };
+    }
+
+    /**
+     * Collects the literals and opaque rules that are used outside of Token
+     * rules, since these are lexed in two-stage mode.
+     */
+    void collectLexemes(const GNode& node, QSet<QString>& literals, QSet<QString>& opaqueRules) const
+    {
+        if (node.type() == TokenType::Literal) {
+            literals << node.value();
+        } else if (node.type() == TokenType::Opaque) {
+            opaqueRules << node.value();
+        }
+        for (auto& child : node.children()) {
+            collectLexemes(child, literals, opaqueRules);
+        }
+    }
+
+    /**
+     * Returns a rule that runs the Token rule as a compiled DFA, or an empty
+     * rule if the Token rule is not regular.
+     */
+    PRule buildCompiledToken(const GNode& node)
+    {
+        auto dfa = std::make_shared<TokenDfa>();
+        if (!dfa->compile(node.value(), _parsedRules, _charClasses)) {
+            return PRule();
+        }
+        QString name = node.value();
+        return [dfa, name](Cursor<QChar>& iter, Result<PNode>& result) {
+            const int start = iter.pos();
+            QString text;
+            if (!(*dfa)(iter, text)) {
+                return false;
+            }
+            PNode token(name, text);
+            token.setSpan(start, iter.pos());
+            result << token;
+            return true;
+        };
+    }
+
+    /**
+     * Returns the offset of the input at the cursor.
+     */
+    static int startOffset(Cursor<QChar>& iter)
+    {
+        return iter.pos();
+    }
+
+    static int startOffset(Cursor<LexemeType>& iter)
+    {
+        if (!iter) {
+            const int end = iter.tokenEnd();
+            return end >= 0 ? end : 0;
+        }
+        const LexemeType* lexemes = iter.contiguous();
+        return lexemes ? lexemes[iter.pos()].start : (*iter).start;
+    }
+
+    /**
+     * Returns the offset past the last token that was read since the rule
+     * started from the position, without its trailing trivia. Tokens record
+     * their ends in the cursor as they're read, so the end is found even if
+     * the rule backtracked over tokens after it. If the token didn't record
+     * its end, the trivia is included.
+     */
+    static int endOffset(Cursor<QChar>& iter, const int from, const int start)
+    {
+        if (iter.pos() == from) {
+            return start;
+        }
+        const int end = iter.tokenEnd();
+        return end >= start ? end : iter.pos();
+    }
+
+    static int endOffset(Cursor<LexemeType>& iter, const int from, const int start)
+    {
+        if (iter.pos() == from) {
+            return start;
+        }
+        const LexemeType* lexemes = iter.contiguous();
+        if (lexemes) {
+            return lexemes[iter.pos() - 1].end;
+        }
+        const int end = iter.tokenEnd();
+        return end >= start ? end : start;
+    }
+
+    /**
+     * Builds the named rule from its parsed node, which reduces the rule's
+     * results according to whether it's a Rule, Token or Group. Nodes that it
+     * creates span from where it started to the end of its last token. Named
+     * rules count against the cursor's Budget, if it has one.
+     */
+    template <class Input>
+    rule::Proxy<Input, PNode> buildNamedRule(const GNode& node)
+    {
+        auto body = rule::limit(buildRule<Input>(node[0], node.type()));
+        return [node, body](Cursor<Input>& iter, Result<PNode>& dest) {
+            const int from = iter.pos();
+            const int start = startOffset(iter);
+            Result<PNode> src;
+            if (!body(iter, src)) {
+                return false;
+            }
+            switch (node.type()) {
+                case TokenType::GroupRule:
+                    dest.insert(src);
+                    break;
+                case TokenType::TokenRule:
+                    if (src.size() == 1 && src[0].type() == "") {
+                        src[0].setType(node.value());
+                        src[0].setSpan(start, endOffset(iter, from, start));
+                        dest << src[0];
+                        break;
+                    }
+                    // Otherwise, fall through
+                case TokenType::Rule:
+                {
+                    if (node[0].type() == TokenType::Recursive) {
+                        // Recursive rules already create a group node, so don't double-nest it
+                        dest.insert(src);
+                        break;
+                    }
+                    PNode rv(node.value());
+                    for (auto token = src.begin() + src.pos(); token != src.begin() + src.head(); ++token) {
+                        rv.insert(std::move(*token));
+                    }
+                    rv.setSpan(start, endOffset(iter, from, start));
+                    dest.insert(std::move(rv));
+                    break;
+                }
+                default:
+                    throw std::logic_error("Unexpected rule type");
+            }
+            return true;
+        };
+    }
+
+public:
+    Grammar() :
+        _compileTokens(false),
+        _cuts(false)
+    {
+        setTrivia(whitespace());
+
+        setCharClass("alpha", CharClass::letter());
+        setCharClass("alnum", CharClass::letterOrNumber());
 
         _rules["string"] = rule::convert<PNode>(
             rule::wrap<QChar, QString>(&rule::parseQuotedString),
@@ -159,7 +736,7 @@ public:
 
         _rules["number"] = rule::convert<PNode>(
             rule::wrap<QChar, double>(&rule::parseFloating),
-            [](const float& value) {
+            [](const double& value) {
                 return PNode("number", QString::number(value));
             }
         );
@@ -167,29 +744,29 @@ public:
         _grammarParser = createGrammarParser();
     }
 
-    rule::Proxy<QChar, PNode> buildRule(const GNode& node, const TokenType& ruleType)
+    /**
+     * Builds a rule from the specified node. Rules that read characters skip
+     * trivia once after each token, which is a literal or a reference to a
+     * Token or opaque rule, unless they are Token rules themselves. Rules that
+     * read lexemes match those tokens as single lexemes, so they must be built
+     * after the lexer.
+     */
+    template <class Input = QChar>
+    rule::Proxy<Input, PNode> buildRule(const GNode& node, const TokenType& ruleType)
     {
-        bool excludeWhitespace = ruleType != TokenType::TokenRule;
-
-        auto ws = rule::discard(rule::optional(rule::multiple(rule::tupleAlternative<QChar, QString>(
-            rule::whitespace<QString>(),
-            rule::lineComment("--")
-        ))));
+        const Input* input = nullptr;
 
         switch (node.type()) {
             case TokenType::Sequence:
             {
-                rule::ProxySequence<QChar, PNode> rule;
+                rule::ProxySequence<Input, PNode> rule;
                 for (auto child : node.children()) {
-                    auto childRule = buildRule(child, ruleType);
+                    auto childRule = buildRule<Input>(child, ruleType);
                     if (child.type() == TokenType::Literal) {
                         rule << discard(childRule);
                     } else {
                         rule << childRule;
                     }
-                    if (excludeWhitespace) {
-                        rule << ws;
-                    }
                 }
                 if (ruleType == TokenType::TokenRule) {
                     return rule::reduce<PNode>(
@@ -208,21 +785,17 @@ public:
             }
             case TokenType::Recursive:
             {
-                rule::Proxy<QChar, PNode> terminal = buildRule(node[0], ruleType);
-                if (excludeWhitespace) {
-                    terminal = rule::tupleSequence<QChar, PNode>(
-                        terminal,
-                        ws
-                    );
-                }
                 return rule::recursive(
-                    terminal,
-                    buildRule(node[1], ruleType),
+                    buildRule<Input>(node[0], ruleType),
+                    buildRule<Input>(node[1], ruleType),
                     [node](Result<PNode>& result) {
                         PNode recursiveNode(node.value());
                         while (result) {
                             recursiveNode.insert(*result++);
                         }
+                        if (recursiveNode.size() > 0) {
+                            recursiveNode.setSpan(recursiveNode[0].start(), recursiveNode[recursiveNode.size() - 1].end());
+                        }
                         result.clear();
                         result.insert(recursiveNode);
                     }
@@ -230,49 +803,62 @@ public:
             }
             case TokenType::Alternative:
             {
-                rule::ProxyAlternative<QChar, PNode> rule;
-                for (auto child : node.children()) {
-                    rule << buildRule(child, ruleType);
-                }
-                return rule;
+                return buildAlternative(node, ruleType, input);
             }
             case TokenType::Join:
             {
-                auto content = buildRule(node[0], ruleType);
-                auto separator = buildRule(node[1], ruleType);
+                auto content = buildRule<Input>(node[0], ruleType);
+                auto separator = buildRule<Input>(node[1], ruleType);
                 if (node[1].type() == TokenType::Literal) {
                     separator = discard(separator);
                 }
-                if (excludeWhitespace) {
-                    content = rule::tupleSequence<QChar, PNode>(content, ws);
-                    separator = rule::tupleSequence<QChar, PNode>(separator, ws);
-                }
                 return rule::join(content, separator);
             }
             case TokenType::ZeroOrMore:
             {
-                return rule::optional(rule::multiple(buildRule(node[0], ruleType)));
+                if (_cuts) {
+                    return buildRepetition(buildRule<Input>(node[0], ruleType), 0, -1);
+                }
+                return rule::optional(rule::multiple(buildRule<Input>(node[0], ruleType)));
             }
             case TokenType::Optional:
             {
-                return rule::optional(buildRule(node[0], ruleType));
+                if (_cuts) {
+                    return buildRepetition(buildRule<Input>(node[0], ruleType), 0, 1);
+                }
+                return rule::optional(buildRule<Input>(node[0], ruleType));
             }
             case TokenType::Discard:
             {
-                return rule::discard(buildRule(node[0], ruleType));
+                return rule::discard(buildRule<Input>(node[0], ruleType));
             }
             case TokenType::OneOrMore:
             {
-                return rule::multiple(buildRule(node[0], ruleType));
+                if (_cuts) {
+                    return buildRepetition(buildRule<Input>(node[0], ruleType), 1, -1);
+                }
+                return rule::multiple(buildRule<Input>(node[0], ruleType));
+            }
+            case TokenType::Cut:
+            {
+                return rule::cut<Input, PNode>();
             }
             case TokenType::Opaque:
+            {
+                return buildToken(buildReference(node.value(), input), node, ruleType);
+            }
             case TokenType::Name:
             {
-                return _rules[node.value()];
+                auto reference = buildReference(node.value(), input);
+                if (_parsedRules.contains(node.value()) && _parsedRules[node.value()].type() != TokenType::TokenRule) {
+                    // The rule skips trivia after its own tokens
+                    return reference;
+                }
+                return buildToken(reference, node, ruleType);
             }
             case TokenType::Literal:
             {
-                return rule::qLiteral(node.value(), PNode("", node.value()));
+                return buildToken(buildLiteral(node.value(), input), node, ruleType);
             }
             default:
             {
@@ -298,48 +884,179 @@ public:
 
         for (GNode& node : nodes) {
             _parsedRules[node.value()] = node;
+            _cuts = _cuts || hasCut(node);
         }
     }
 
+    /**
+     * Records statistics for every named rule into the specified profiler. This
+     * must be set before the grammar is built.
+     */
+    void setProfiler(const std::shared_ptr<rule::Profiler>& profiler)
+    {
+        _profiler = profiler;
+    }
+
+    std::shared_ptr<rule::Profiler> profiler() const
+    {
+        return _profiler;
+    }
+
+    /**
+     * Adds an opaque rule that matches a single character that satisfies the
+     * predicate. Unlike other opaque rules, character classes can be used in
+     * compiled Token rules.
+     */
+    void setCharClass(const QString& name, const TokenDfa::CharClass& predicate)
+    {
+        _charClasses[name] = predicate;
+        _rules[name] = rule::Proxy<QChar, PNode>([predicate](Cursor<QChar>& iter, Result<PNode>& result) {
+            if (iter && predicate(*iter)) {
+                result << PNode("", *iter++);
+                return true;
+            }
+            return false;
+        });
+    }
+
+    const QHash<QString, TokenDfa::CharClass>& charClasses() const
+    {
+        return _charClasses;
+    }
+
+    /**
+     * Sets whether regular Token rules are compiled into DFAs when the grammar
+     * is built. This is disabled by default, since it changes what tokens
+     * match: compiled Token rules take the longest match, where combinators
+     * take the first choice that matches and never give back what a
+     * repetition read. A Token rule like ('a' | 'ab') matches "ab" when it's
+     * compiled, but only "a" otherwise.
+     */
+    void setCompileTokens(const bool compile)
+    {
+        _compileTokens = compile;
+    }
+
+    /**
+     * Sets the rule for trivia, such as whitespace and comments, that is skipped
+     * between tokens. This must be set before the grammar is built.
+     */
+    void setTrivia(const PRule& trivia)
+    {
+        _trivia = trivia;
+        _skipper = rule::Skipper<QChar, PNode>(trivia);
+    }
+
+    const PRule& trivia() const
+    {
+        return _trivia;
+    }
+
+    /**
+     * Binds a semantic action to the named rule, so that it's parsed directly
+     * into a T by a StackEvaluator that's created afterwards. The action is
+     * called with the rule's ActionValues, and returns the T:
+     *
+     * grammar.on<FuncDecl>("functionDefinition", [](const ActionValues<PNode>& values) {
+     *     return FuncDecl(values.text(0), values.get<Block>(1));
+     * });
+     *
+     * Rules that are built by build() still produce nodes.
+     */
+    template <class T, class Function>
+    void on(const QString& name, const Function& action)
+    {
+        _actions.template on<T>(name, action);
+    }
+
+    const Actions<PNode>& actions() const
+    {
+        return _actions;
+    }
+
     void build()
     {
+        if (_profiler) {
+            profileOpaqueRules();
+        }
         for (GNode& node : _parsedRules.values()) {
-            _rules[node.value()] = rule::reduce<PNode>(
-                buildRule(node[0], node.type()),
-                [node](Result<PNode>& dest, Result<PNode>& src) {
-                    switch (node.type()) {
-                        case TokenType::GroupRule:
-                            dest.insert(src);
-                            break;
-                        case TokenType::TokenRule:
-                            if (src.size() == 1 && src[0].type() == "") {
-                                src[0].setType(node.value());
-                                dest << src[0];
-                                break;
-                            }
-                            // Otherwise, fall through
-                        case TokenType::Rule:
-                        {
-                            if (node[0].type() == TokenType::Recursive) {
-                                // Recursive rules already create a group node, so don't double-nest it
-                                dest.insert(src);
-                                break;
-                            }
-                            PNode rv(node.value());
-                            while (src) {
-                                rv.insert(*src++);
-                            }
-                            dest << rv;
-                            break;
-                        }
-                        default:
-                            throw std::logic_error("Unexpected rule type");
-                    }
-                }
-            );
+            PRule built;
+            if (_compileTokens && node.type() == TokenType::TokenRule) {
+                built = buildCompiledToken(node);
+            }
+            if (!built) {
+                built = buildNamedRule<QChar>(node);
+            }
+            if (_profiler) {
+                built = rule::profile(node.value().toStdString(), _profiler, built);
+            }
+            _rules[node.value()] = built;
         }
     }
 
+    /**
+     * Builds the grammar for two-stage parsing, where input is first split
+     * into lexemes by lexer(), and then parsed by the rules from lexed().
+     *
+     * Every Token rule, and every literal and opaque rule that's used outside
+     * of a Token rule, becomes a kind of lexeme. Whitespace and comments are
+     * skipped by the lexer, so parser rules only ever compare lexemes, which
+     * makes backtracking much cheaper than rescanning characters. The grammar
+     * must already be built, since the lexer uses its Token rules.
+     */
+    void buildLexer()
+    {
+        _lexer = Lexer<PNode>();
+        _lexer.setTrivia(_trivia);
+
+        std::vector<QString> tokenRules;
+        QSet<QString> literals;
+        QSet<QString> opaqueRules;
+        for (GNode& node : _parsedRules.values()) {
+            if (node.type() == TokenType::TokenRule) {
+                tokenRules.push_back(node.value());
+            } else {
+                collectLexemes(node, literals, opaqueRules);
+            }
+        }
+        for (auto& name : opaqueRules) {
+            tokenRules.push_back(name);
+        }
+        // Rules that match the same length are resolved by their order, so keep it stable
+        std::sort(tokenRules.begin(), tokenRules.end());
+
+        for (auto& name : tokenRules) {
+            _lexer.addRule(name, _rules[name]);
+        }
+        for (auto& literal : literals) {
+            _lexer.addLiteral(literal);
+        }
+
+        for (GNode& node : _parsedRules.values()) {
+            if (node.type() == TokenType::TokenRule) {
+                continue;
+            }
+            LRule built = buildNamedRule<LexemeType>(node);
+            if (_profiler) {
+                built = rule::profile(node.value().toStdString(), _profiler, built);
+            }
+            _lexedRules[node.value()] = built;
+        }
+    }
+
+    const Lexer<PNode>& lexer() const
+    {
+        return _lexer;
+    }
+
+    /**
+     * Returns the named rule that reads lexemes. The lexer must be built first.
+     */
+    rule::Shared<LRule> lexed(const char* name)
+    {
+        return _lexedRules[name];
+    }
+
     rule::Shared<PRule> operator[](const char* name)
     {
         return _rules[name];
@@ -373,9 +1090,7 @@ rule::Proxy<QChar, GNode> Grammar<Type, Value>::createGrammarParser()
 
     auto name = rule::convert<GNode>(
         rule::aggregate<QString>(
-            rule::multiple(rule::simplePredicate<QChar>([](const QChar& input) {
-                return input.isLetter() || input == '_';
-            })),
+            rule::multiple(rule::simplePredicate<QChar>(CharClass::letter().with('_'))),
             [](QString& target, const QChar& c) {
                 target += c;
             }
@@ -404,6 +1119,7 @@ rule::Proxy<QChar, GNode> Grammar<Type, Value>::createGrammarParser()
             rule::tupleAlternative<QChar, GNode>(
                 literal,
                 name,
+                rule::qLiteral<GNode>("^", TokenType::Cut),
                 rule::reduce<GNode>(
                     rule::tupleSequence<QChar, GNode>(
                         rule::discard(rule::qLiteral("{")),
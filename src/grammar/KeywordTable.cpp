@@ -0,0 +1,112 @@
+#include <grammar/KeywordTable.hpp>
+
+#include <stdexcept>
+
+namespace sprout {
+namespace grammar {
+
+namespace {
+
+/**
+ * The seeds that are tried for each table size before the table is doubled.
+ */
+const quint32 SEEDS_PER_SIZE = 256;
+
+/**
+ * The largest table that is searched for a perfect hash.
+ */
+const int MAX_SIZE = 1 << 20;
+
+} // namespace anonymous
+
+KeywordTable::KeywordTable() :
+    _slots(1),
+    _seed(0),
+    _mask(0),
+    _longest(0)
+{
+    _slots[0].kind = -1;
+}
+
+quint32 KeywordTable::hash(const QString& word, const quint32 seed)
+{
+    quint32 hashed = start(seed);
+    for (const QChar& c : word) {
+        hashed = step(hashed, c);
+    }
+    return finish(hashed, word.size());
+}
+
+bool KeywordTable::isKeyword(const QString& literal)
+{
+    if (literal.isEmpty() || literal.size() > MAX_LENGTH || !isWordStart(literal[0])) {
+        return false;
+    }
+    for (const QChar& c : literal) {
+        if (!isWordPart(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool KeywordTable::place(const quint32 seed, const int size)
+{
+    std::vector<Slot> slots(size);
+    for (auto& slot : slots) {
+        slot.kind = -1;
+    }
+    for (auto& keyword : _keywords) {
+        Slot& slot = slots[hash(keyword.first, seed) & (size - 1)];
+        if (slot.kind >= 0) {
+            return false;
+        }
+        slot.keyword = keyword.first;
+        slot.kind = keyword.second;
+    }
+    _slots.swap(slots);
+    _seed = seed;
+    _mask = size - 1;
+    return true;
+}
+
+void KeywordTable::rebuild()
+{
+    // Start with a table at least twice as large as the keywords, so that
+    // a seed without collisions is quick to find
+    int size = 8;
+    while (size < 2 * static_cast<int>(_keywords.size())) {
+        size *= 2;
+    }
+    for (; size <= MAX_SIZE; size *= 2) {
+        for (quint32 seed = 0; seed < SEEDS_PER_SIZE; ++seed) {
+            if (place(seed, size)) {
+                return;
+            }
+        }
+    }
+    throw std::logic_error("No perfect hash was found for the keywords");
+}
+
+void KeywordTable::add(const QString& keyword, const int kind)
+{
+    if (!isKeyword(keyword)) {
+        throw std::logic_error("Keywords must be words");
+    }
+    _keywords.push_back(std::make_pair(keyword, kind));
+    if (keyword.size() > _longest) {
+        _longest = keyword.size();
+    }
+    rebuild();
+}
+
+int KeywordTable::find(const QString& word) const
+{
+    const Slot& slot = _slots[hash(word, _seed) & _mask];
+    return slot.kind >= 0 && slot.keyword == word ? slot.kind : -1;
+}
+
+} // namespace grammar
+} // namespace sprout
+
+// vim: set ts=4 sw=4 :
@@ -0,0 +1,154 @@
+#ifndef SPROUT_GRAMMAR_KEYWORDTABLE_HEADER
+#define SPROUT_GRAMMAR_KEYWORDTABLE_HEADER
+
+#include <Cursor.hpp>
+#include <CharClass.hpp>
+
+#include <QString>
+#include <QChar>
+
+#include <vector>
+
+namespace sprout {
+namespace grammar {
+
+/**
+ * \brief A perfect hash table of keywords, which classifies a word in a single lookup.
+ *
+ * Keywords are literals that look like identifiers. Whenever a keyword is
+ * added, the table searches for a seed that hashes every keyword into its own
+ * slot, so a lookup hashes the word, compares it against at most one keyword,
+ * and never probes.
+ *
+ * Keywords only match whole words, so "localx" is not the keyword "local"
+ * followed by "x".
+ */
+class KeywordTable
+{
+public:
+    /**
+     * The longest keyword that the table holds. Longer literals must be
+     * matched some other way.
+     */
+    static const int MAX_LENGTH = 32;
+
+private:
+    struct Slot
+    {
+        QString keyword;
+        int kind;
+    };
+
+    std::vector<std::pair<QString, int>> _keywords;
+
+    std::vector<Slot> _slots;
+    quint32 _seed;
+    quint32 _mask;
+    int _longest;
+
+    static quint32 start(const quint32 seed)
+    {
+        return seed * 0x9e3779b9u;
+    }
+
+    static quint32 step(const quint32 hash, const QChar& c)
+    {
+        return (hash ^ c.unicode()) * 16777619u;
+    }
+
+    static quint32 finish(const quint32 hash, const int length)
+    {
+        const quint32 mixed = hash ^ static_cast<quint32>(length);
+        return mixed ^ (mixed >> 15);
+    }
+
+    static quint32 hash(const QString& word, const quint32 seed);
+
+    /**
+     * Tries to place every keyword into a table of the given size, returning
+     * false if two keywords collide.
+     */
+    bool place(const quint32 seed, const int size);
+
+    void rebuild();
+
+public:
+    KeywordTable();
+
+    static bool isWordStart(const QChar& c)
+    {
+        static const CharClass wordStart = CharClass::letter().with('_');
+        return wordStart(c);
+    }
+
+    static bool isWordPart(const QChar& c)
+    {
+        static const CharClass wordPart = CharClass::letterOrNumber().with('_');
+        return wordPart(c);
+    }
+
+    /**
+     * Returns whether the literal can be held as a keyword.
+     */
+    static bool isKeyword(const QString& literal);
+
+    /**
+     * Adds the keyword, which must satisfy isKeyword().
+     */
+    void add(const QString& keyword, const int kind);
+
+    bool empty() const
+    {
+        return _keywords.empty();
+    }
+
+    /**
+     * Returns the kind of the keyword, or -1 if it isn't one.
+     */
+    int find(const QString& word) const;
+
+    /**
+     * Returns the kind of the keyword that is the whole word at the cursor,
+     * or -1 if the word isn't a keyword. The length of the keyword is written
+     * to length.
+     */
+    int match(Cursor<QChar> input, int& length) const
+    {
+        if (empty() || !input || !isWordStart(*input)) {
+            return -1;
+        }
+
+        QChar word[MAX_LENGTH];
+        quint32 hashed = start(_seed);
+        int size = 0;
+        while (input && isWordPart(*input)) {
+            if (size == _longest) {
+                // Longer than any keyword
+                return -1;
+            }
+            word[size] = *input;
+            hashed = step(hashed, word[size]);
+            ++size;
+            ++input;
+        }
+
+        const Slot& slot = _slots[finish(hashed, size) & _mask];
+        if (slot.kind < 0 || slot.keyword.size() != size) {
+            return -1;
+        }
+        for (int i = 0; i < size; ++i) {
+            if (slot.keyword[i] != word[i]) {
+                return -1;
+            }
+        }
+        length = size;
+        return slot.kind;
+    }
+};
+
+} // namespace grammar
+} // namespace sprout
+
+#endif // SPROUT_GRAMMAR_KEYWORDTABLE_HEADER
+
+// vim: set ts=4 sw=4 :
@@ -0,0 +1,269 @@
+#ifndef SPROUT_GRAMMAR_LEXER_HEADER
+#define SPROUT_GRAMMAR_LEXER_HEADER
+
+#include "KeywordTable.hpp"
+
+#include <Cursor.hpp>
+#include <Result.hpp>
+#include <rule/Proxy.hpp>
+
+#include <QHash>
+#include <QString>
+#include <QChar>
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace sprout {
+namespace grammar {
+
+/**
+ * \brief A token produced by a Lexer.
+ *
+ * The kind is assigned by the lexer to each literal and each lexed rule, so
+ * that parser rules can match lexemes with a single comparison.
+ */
+template <class Node>
+struct Lexeme
+{
+    int kind;
+
+    /**
+     * The node produced by the lexed rule, or an empty node for literals.
+     */
+    Node node;
+
+    /**
+     * The offsets of the first and past-the-last characters of this lexeme
+     * in the input.
+     */
+    int start;
+    int end;
+};
+
+/**
+ * \brief Splits character input into lexemes ahead of parsing.
+ *
+ * At each position, trivia such as whitespace and comments is skipped, and
+ * then every literal and rule is tried. The longest match wins, and a literal
+ * wins over a rule that matches the same length, so keywords are never read
+ * as names. A literal that isn't a word also wins over any longer rule match
+ * that it begins, so the '-' in "a-1" is an operator rather than part of a
+ * negative number.
+ *
+ * Literals that look like identifiers are keywords, which are found with a
+ * single lookup in a KeywordTable. Keywords only match whole words, so with
+ * no rule for names, "localx" can't be lexed as 'local' followed by 'x'.
+ */
+template <class Node>
+class Lexer
+{
+public:
+    typedef rule::Proxy<QChar, Node> CharRule;
+
+private:
+    std::vector<std::pair<int, CharRule>> _rules;
+
+    /**
+     * Literals that aren't keywords, grouped by their first character, with
+     * the longest first.
+     */
+    QHash<ushort, std::vector<std::pair<QString, int>>> _literals;
+
+    KeywordTable _keywords;
+
+    QHash<QString, int> _ruleKinds;
+    QHash<QString, int> _literalKinds;
+    std::vector<QString> _names;
+
+    CharRule _trivia;
+
+    static bool isWord(const QString& text)
+    {
+        return !text.isEmpty() && (text[0].isLetter() || text[0] == '_');
+    }
+
+    /**
+     * Returns the kind of the longest literal at the cursor, or -1 if none
+     * match. The length of the match is written to length.
+     */
+    int matchLiteral(Cursor<QChar> input, int& length) const
+    {
+        auto candidates = _literals.find((*input).unicode());
+        if (candidates == _literals.end()) {
+            return -1;
+        }
+        for (auto& candidate : *candidates) {
+            auto iter = input;
+            const QString& literal = candidate.first;
+            int matched = 0;
+            while (matched < literal.size() && iter && *iter == literal[matched]) {
+                ++iter;
+                ++matched;
+            }
+            if (matched == literal.size()) {
+                length = matched;
+                return candidate.second;
+            }
+        }
+        return -1;
+    }
+
+public:
+    /**
+     * Adds a rule whose matches become lexemes of a new kind. When rules
+     * match the same length, the first one added wins.
+     */
+    int addRule(const QString& name, const CharRule& rule)
+    {
+        int kind = _names.size();
+        _names.push_back(name);
+        _ruleKinds[name] = kind;
+        _rules.push_back(std::make_pair(kind, rule));
+        return kind;
+    }
+
+    int addLiteral(const QString& literal)
+    {
+        if (literal.isEmpty()) {
+            throw std::logic_error("Literals must not be empty");
+        }
+        if (_literalKinds.contains(literal)) {
+            return _literalKinds[literal];
+        }
+
+        int kind = _names.size();
+        _names.push_back(literal);
+        _literalKinds[literal] = kind;
+
+        if (KeywordTable::isKeyword(literal)) {
+            _keywords.add(literal, kind);
+            return kind;
+        }
+
+        auto& candidates = _literals[literal[0].unicode()];
+        candidates.push_back(std::make_pair(literal, kind));
+        std::stable_sort(candidates.begin(), candidates.end(), [](
+                const std::pair<QString, int>& a,
+                const std::pair<QString, int>& b) {
+            return a.first.size() > b.first.size();
+        });
+        return kind;
+    }
+
+    /**
+     * Sets the rule for input that is skipped between lexemes.
+     */
+    void setTrivia(const CharRule& trivia)
+    {
+        _trivia = trivia;
+    }
+
+    /**
+     * Returns the kind of the named rule, or -1 if it isn't lexed.
+     */
+    int ruleKind(const QString& name) const
+    {
+        return _ruleKinds.value(name, -1);
+    }
+
+    /**
+     * Returns the kind of the literal, or -1 if it isn't lexed.
+     */
+    int literalKind(const QString& literal) const
+    {
+        return _literalKinds.value(literal, -1);
+    }
+
+    /**
+     * Returns the number of kinds of lexemes.
+     */
+    int kinds() const
+    {
+        return _names.size();
+    }
+
+    /**
+     * Returns the rule name or literal text of the specified kind.
+     */
+    const QString& name(const int kind) const
+    {
+        return _names.at(kind);
+    }
+
+    /**
+     * Lexes all of the input, appending its lexemes. Returns false if some
+     * input could not be lexed, leaving the input at the offending position.
+     */
+    bool operator()(Cursor<QChar>& input, std::vector<Lexeme<Node>>& lexemes) const
+    {
+        return lex(input, [&lexemes](const Lexeme<Node>& lexeme) {
+            lexemes.push_back(lexeme);
+            return true;
+        });
+    }
+
+    /**
+     * Lexes all of the input, passing each lexeme to the sink. Lexing stops if
+     * the sink returns false. Returns false if lexing stopped before the end of
+     * the input.
+     *
+     * If a limit is given, lexing also stops once the next lexeme would start
+     * at or after it, leaving the input at that lexeme.
+     */
+    template <class Sink>
+    bool lex(Cursor<QChar>& input, Sink sink, const int limit = -1) const
+    {
+        while (true) {
+            Result<Node> ignored;
+            _trivia(input, ignored);
+            if (!input || (limit >= 0 && input.pos() >= limit)) {
+                return true;
+            }
+
+            Lexeme<Node> lexeme;
+            lexeme.start = input.pos();
+
+            int longest = 0;
+            lexeme.kind = matchLiteral(input, longest);
+
+            int keywordLength = 0;
+            const int keyword = _keywords.match(input, keywordLength);
+            if (keyword >= 0 && keywordLength >= longest) {
+                lexeme.kind = keyword;
+                longest = keywordLength;
+            }
+
+            if (lexeme.kind < 0 || isWord(name(lexeme.kind))) {
+                for (auto& rule : _rules) {
+                    auto iter = input;
+                    Result<Node> result;
+                    if (!rule.second(iter, result) || iter.pos() - lexeme.start <= longest) {
+                        continue;
+                    }
+                    longest = iter.pos() - lexeme.start;
+                    lexeme.kind = rule.first;
+                    lexeme.node = result ? *result : Node();
+                }
+            }
+
+            if (lexeme.kind < 0 || longest == 0) {
+                return false;
+            }
+
+            input += longest;
+            lexeme.end = input.pos();
+            if (!sink(lexeme)) {
+                return false;
+            }
+        }
+    }
+};
+
+} // namespace grammar
+} // namespace sprout
+
+#endif // SPROUT_GRAMMAR_LEXER_HEADER
+
+// vim: set ts=4 sw=4 :
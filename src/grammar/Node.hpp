@@ -3,18 +3,36 @@
 
 #include <Result.hpp>
 
+#include <cstdint>
+#include <utility>
 #include <vector>
 #include <sstream>
 
 namespace sprout {
 namespace grammar {
 
+/**
+ * \brief A node of a parse tree.
+ *
+ * Nodes that are built by a grammar have a span, which is the offsets of the
+ * characters that they matched in the input, from their first character to
+ * past the last character of their last token. Spans aren't compared by
+ * operator==, so nodes that are built by hand compare equal to parsed ones.
+ * Use a LineIndex to convert offsets into lines and columns.
+ *
+ * Nodes are destroyed without recursing, so trees of any depth can be freed.
+ * Move nodes into their parents where possible, since copying a node copies
+ * its whole subtree.
+ */
 template <class Type, class Value>
 class Node {
     Type _type;
     Value _value;
     std::vector<Node<Type, Value>> _children;
 
+    std::int32_t _start = 0;
+    std::int32_t _end = 0;
+
 public:
     typedef Type type_type;
     typedef Value value_type;
@@ -47,6 +65,38 @@ public:
     {
     }
 
+    Node(const Node<Type, Value>& other) = default;
+    Node(Node<Type, Value>&& other) = default;
+
+    Node<Type, Value>& operator=(const Node<Type, Value>& other) = default;
+    Node<Type, Value>& operator=(Node<Type, Value>&& other) = default;
+
+    ~Node()
+    {
+        // Leaves and their parents are common, and can't recurse deeply
+        bool deep = false;
+        for (auto& child : _children) {
+            if (!child._children.empty()) {
+                deep = true;
+                break;
+            }
+        }
+        if (!deep) {
+            return;
+        }
+
+        // Otherwise, free descendants from a worklist instead of the stack
+        std::vector<Node<Type, Value>> pending(std::move(_children));
+        while (!pending.empty()) {
+            Node<Type, Value> node(std::move(pending.back()));
+            pending.pop_back();
+            for (auto& child : node._children) {
+                pending.push_back(std::move(child));
+            }
+            node._children.clear();
+        }
+    }
+
     const Type& type() const
     {
         return _type;
@@ -74,6 +124,28 @@ public:
         _value = value;
     }
 
+    /**
+     * Returns the offset of the node's first character in the input.
+     */
+    int start() const
+    {
+        return _start;
+    }
+
+    /**
+     * Returns the offset past the node's last character in the input.
+     */
+    int end() const
+    {
+        return _end;
+    }
+
+    void setSpan(const int start, const int end)
+    {
+        _start = start;
+        _end = end;
+    }
+
     std::string valueString() const
     {
         std::stringstream str;
@@ -86,6 +158,11 @@ public:
         _children.push_back(child);
     }
 
+    void insert(Node<Type, Value>&& child)
+    {
+        _children.push_back(std::move(child));
+    }
+
     void insert(const sprout::Result<Node<Type, Value>>& result)
     {
         while (result) {
@@ -119,17 +196,6 @@ public:
         return _children.at(index);
     }
 
-    Node<Type, Value>& operator=(const Node<Type, Value>& other)
-    {
-        if (this == &other) {
-            return *this;
-        }
-        _type = other._type;
-        _value = other._value;
-        _children = other._children;
-        return *this;
-    }
-
     const std::vector<Node<Type, Value>>& children() const
     {
         return _children;
@@ -0,0 +1,289 @@
+#ifndef SPROUT_GRAMMAR_PARALLELLEXER_HEADER
+#define SPROUT_GRAMMAR_PARALLELLEXER_HEADER
+
+#include "Lexer.hpp"
+
+#include <Cursor.hpp>
+
+#include <QString>
+#include <QChar>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace sprout {
+namespace grammar {
+
+/**
+ * \brief Lexes large inputs by splitting them into chunks that are lexed on several threads.
+ *
+ * Between lexemes, a Lexer's only state is its position, but a chunk that
+ * starts at an arbitrary position could be in the middle of a string or a
+ * comment. Chunks are split at the start of a line, and each chunk is lexed
+ * speculatively from every position where lexing could plausibly resume: the
+ * chunk's start, and just after the first occurrence of each state delimiter,
+ * such as a closing quote or the end of a line comment.
+ *
+ * The speculative runs are then stitched together in order. Each chunk is
+ * entered at the position where lexing of the previous chunk stopped, and a
+ * run that produced a lexeme at that position agrees with the sequential
+ * lexer from there on, so its lexemes are used. If no run guessed the entry
+ * position, the chunk is lexed again on the calling thread. Either way, the
+ * lexemes are identical to those of the sequential lexer.
+ *
+ * The lexer's rules run on several threads at once, so they must not be used
+ * with a profiler, and must not be shared with anything else that runs at the
+ * same time.
+ */
+template <class Node>
+class ParallelLexer
+{
+    typedef std::vector<Lexeme<Node>> Lexemes;
+
+    /**
+     * The lexemes from lexing a chunk starting at some position.
+     */
+    struct Run
+    {
+        int start;
+
+        Lexemes lexemes;
+
+        /**
+         * The position where lexing stopped, which is at or past the chunk's
+         * end unless lexing failed.
+         */
+        int end;
+        bool lexed;
+    };
+
+    struct Chunk
+    {
+        int start;
+        int end;
+        std::vector<Run> runs;
+    };
+
+    const Lexer<Node>& _lexer;
+    int _threads;
+    int _chunkSize;
+    QString _delimiters;
+
+    std::vector<Chunk> split(const QString& input) const
+    {
+        std::vector<Chunk> chunks;
+
+        // A few chunks per thread keeps the threads busy when chunks vary in cost
+        const int count = std::max(1, std::min(input.size() / _chunkSize, _threads * 4));
+        const int size = input.size() / count;
+
+        int start = 0;
+        for (int i = 1; i < count; ++i) {
+            int end = input.indexOf('\n', std::max(start, i * size));
+            if (end < 0) {
+                break;
+            }
+            ++end;
+            if (end > start && end < input.size()) {
+                chunks.push_back(Chunk{start, end, std::vector<Run>()});
+                start = end;
+            }
+        }
+        chunks.push_back(Chunk{start, input.size(), std::vector<Run>()});
+        return chunks;
+    }
+
+    /**
+     * Returns the positions where lexing of the chunk could plausibly resume.
+     */
+    std::vector<int> entries(const QString& input, const Chunk& chunk) const
+    {
+        std::vector<int> positions(1, chunk.start);
+        for (auto delimiter : _delimiters) {
+            int pos = chunk.start;
+            while (true) {
+                pos = input.indexOf(delimiter, pos);
+                if (pos < 0 || pos >= chunk.end) {
+                    break;
+                }
+                ++pos;
+                if (pos < 2 || input.at(pos - 2) != '\\') {
+                    positions.push_back(pos);
+                    break;
+                }
+            }
+        }
+        std::sort(positions.begin(), positions.end());
+        positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+        return positions;
+    }
+
+    Run lexRun(const QString& input, const int start, const int limit) const
+    {
+        Run run;
+        run.start = start;
+        auto cursor = makeCursor<QChar>(&input);
+        cursor += start;
+        run.lexed = _lexer.lex(cursor, [&run](const Lexeme<Node>& lexeme) {
+            run.lexemes.push_back(lexeme);
+            return true;
+        }, limit);
+        run.end = cursor.pos();
+        return run;
+    }
+
+    /**
+     * Returns the index of the run's first lexeme at the position, the number
+     * of its lexemes if it stopped there, or -1 if it never reached it.
+     */
+    static int find(const Run& run, const int pos)
+    {
+        auto found = std::lower_bound(run.lexemes.begin(), run.lexemes.end(), pos,
+            [](const Lexeme<Node>& lexeme, const int pos) {
+                return lexeme.start < pos;
+            });
+        if (found != run.lexemes.end() && found->start == pos) {
+            return found - run.lexemes.begin();
+        }
+        if (found == run.lexemes.end() && run.end == pos) {
+            return run.lexemes.size();
+        }
+        return -1;
+    }
+
+public:
+    ParallelLexer(const Lexer<Node>& lexer) :
+        _lexer(lexer),
+        _threads(std::max(1u, std::thread::hardware_concurrency())),
+        _chunkSize(64 * 1024),
+        _delimiters("\n'\"")
+    {
+    }
+
+    /**
+     * Sets the number of threads to lex with. A single thread lexes the input
+     * sequentially.
+     */
+    void setThreads(const int threads)
+    {
+        _threads = std::max(1, threads);
+    }
+
+    /**
+     * Sets the smallest number of characters that is worth lexing on another
+     * thread. Inputs smaller than two chunks are lexed sequentially.
+     */
+    void setChunkSize(const int chunkSize)
+    {
+        _chunkSize = std::max(1, chunkSize);
+    }
+
+    /**
+     * Sets the characters that end each lexical state other than the default,
+     * such as the quotes that end a string.
+     */
+    void setStateDelimiters(const QString& delimiters)
+    {
+        _delimiters = delimiters;
+    }
+
+    /**
+     * Lexes all of the input, appending its lexemes. Returns false if some
+     * input could not be lexed.
+     */
+    bool operator()(const QString& input, Lexemes& lexemes) const
+    {
+        int end;
+        return lex(input, lexemes, end);
+    }
+
+    /**
+     * Lexes all of the input, appending its lexemes, and sets the end to the
+     * position where lexing stopped. Returns false if some input could not be
+     * lexed, leaving the end at the offending position.
+     */
+    bool lex(const QString& input, Lexemes& lexemes, int& end) const
+    {
+        auto chunks = split(input);
+        if (_threads == 1 || chunks.size() == 1) {
+            Run run = lexRun(input, 0, -1);
+            lexemes.insert(lexemes.end(), run.lexemes.begin(), run.lexemes.end());
+            end = run.end;
+            return run.lexed;
+        }
+
+        std::atomic<unsigned int> next(0);
+        std::vector<std::exception_ptr> errors(_threads);
+        auto work = [&](const int thread) {
+            try {
+                for (unsigned int i = next++; i < chunks.size(); i = next++) {
+                    auto& chunk = chunks[i];
+                    for (int start : entries(input, chunk)) {
+                        chunk.runs.push_back(lexRun(input, start, chunk.end));
+                    }
+                }
+            } catch (...) {
+                errors[thread] = std::current_exception();
+                next = chunks.size();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int i = 1; i < _threads; ++i) {
+            threads.emplace_back(work, i);
+        }
+        work(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        int pos = 0;
+        for (auto& chunk : chunks) {
+            if (pos >= chunk.end) {
+                // A lexeme from an earlier chunk covered this one
+                continue;
+            }
+
+            const Run* found = nullptr;
+            int index = -1;
+            for (auto& run : chunk.runs) {
+                index = find(run, pos);
+                if (index >= 0) {
+                    found = &run;
+                    break;
+                }
+            }
+
+            Run relexed;
+            if (!found) {
+                relexed = lexRun(input, pos, chunk.end);
+                found = &relexed;
+                index = 0;
+            }
+
+            lexemes.insert(lexemes.end(), found->lexemes.begin() + index, found->lexemes.end());
+            pos = found->end;
+            if (!found->lexed) {
+                end = pos;
+                return false;
+            }
+        }
+        end = pos;
+        return true;
+    }
+};
+
+} // namespace grammar
+} // namespace sprout
+
+#endif // SPROUT_GRAMMAR_PARALLELLEXER_HEADER
+
+// vim: set ts=4 sw=4 :
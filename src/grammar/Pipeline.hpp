@@ -0,0 +1,99 @@
+#ifndef SPROUT_GRAMMAR_PIPELINE_HEADER
+#define SPROUT_GRAMMAR_PIPELINE_HEADER
+
+#include "Lexer.hpp"
+
+#include <TokenQueue.hpp>
+#include <Cursor.hpp>
+#include <Result.hpp>
+
+#include <QChar>
+
+#include <exception>
+#include <memory>
+#include <thread>
+
+namespace sprout {
+namespace grammar {
+
+/**
+ * Lexes and parses the input at the same time, by lexing on a second thread.
+ *
+ * Lexemes are passed to the calling thread through a TokenQueue, which only
+ * blocks the parser when it has caught up with the lexer. The rule is matched
+ * repeatedly until the lexemes run out, and each match is committed once it's
+ * made, so lexemes are only retained for as long as a single match could
+ * backtrack over them. The rule should therefore match a single item of the
+ * input, such as a statement, though a rule for the whole input works too.
+ *
+ * The lexer's rules run on the other thread, so they must not be shared with
+ * the parser's rules or with a profiler. The input must not be used by anything
+ * else until this returns.
+ *
+ * Returns false if the input could not be lexed completely, or if the rule
+ * failed to match all of the lexemes.
+ */
+template <class Node, class Rule>
+bool parsePipelined(
+    const Lexer<Node>& lexer,
+    Cursor<QChar>& input,
+    const Rule& rule,
+    Result<Node>& results,
+    const std::size_t capacity = 4096)
+{
+    auto queue = std::make_shared<TokenQueue<Lexeme<Node>>>(capacity);
+
+    bool lexed = false;
+    std::exception_ptr lexerError;
+    std::thread lexerThread([&]() {
+        try {
+            lexed = lexer.lex(input, [&queue](const Lexeme<Node>& lexeme) {
+                return queue->push(lexeme);
+            });
+        } catch (...) {
+            lexerError = std::current_exception();
+        }
+        queue->close();
+    });
+
+    // Owned by the cursor
+    auto data = new QueueCursorData<Lexeme<Node>>(queue);
+    Cursor<Lexeme<Node>> committed(data);
+
+    bool parsed = true;
+    try {
+        while (committed) {
+            auto iter = committed;
+            Result<Node> matched;
+            if (!rule(iter, matched) || iter.pos() == committed.pos()) {
+                parsed = false;
+                break;
+            }
+            while (matched) {
+                results << *matched++;
+            }
+            committed = iter;
+            data->discardBefore(committed.pos());
+        }
+    } catch (...) {
+        queue->cancel();
+        lexerThread.join();
+        throw;
+    }
+
+    // Stop the lexer if the parser gave up early
+    queue->cancel();
+    lexerThread.join();
+
+    if (lexerError) {
+        std::rethrow_exception(lexerError);
+    }
+    return parsed && lexed;
+}
+
+} // namespace grammar
+} // namespace sprout
+
+#endif // SPROUT_GRAMMAR_PIPELINE_HEADER
+
+// vim: set ts=4 sw=4 :
@@ -0,0 +1,1046 @@
+#ifndef SPROUT_GRAMMAR_STACKEVALUATOR_HEADER
+#define SPROUT_GRAMMAR_STACKEVALUATOR_HEADER
+
+#include "Grammar.hpp"
+#include "EventHandler.hpp"
+#include "Actions.hpp"
+
+#include <Budget.hpp>
+#include <Cursor.hpp>
+#include <Result.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace sprout {
+namespace grammar {
+
+/**
+ * \brief Evaluates the rules of a grammar without recursing on the native stack.
+ *
+ * Rules that are built by Grammar nest several C++ calls for every level of
+ * the grammar, so deeply nested input can overflow the stack. This evaluator
+ * compiles the grammar's parsed rules into a flat program, and runs it with
+ * an explicit stack of frames on the heap, so nesting is only limited by
+ * memory. Tokens, which are literals, Token rules and opaque rules, are still
+ * matched by the rules that the grammar built for them, since they don't nest.
+ *
+ * The evaluator can build the same results as the built rules, send them
+ * as events to an EventHandler, or construct them into application types with
+ * the grammar's semantic actions, without building any nodes besides tokens.
+ * Events are buffered only while backtracking could still discard them, so a
+ * grammar that repeats its items at the top, such as "Rule main = statement*;",
+ * parses in memory proportional to its largest item.
+ *
+ * The cursor's Budget and cuts are respected. Repetitions stop once an
+ * iteration reads nothing, rather than repeating forever.
+ *
+ * The grammar must be built before the evaluator is created, including its
+ * lexer if the evaluator reads lexemes. The evaluator doesn't change, so it can
+ * run on several threads at once.
+ */
+template <class Type, class Value, class Input = QChar>
+class StackEvaluator
+{
+public:
+    typedef typename Grammar<Type, Value>::PNode PNode;
+
+private:
+    /**
+     * A compiled node. Named rules are ops of their rule type, and every
+     * reference to them is compiled to the index of that op, so calls don't
+     * need an op of their own.
+     */
+    struct Op
+    {
+        TokenType type;
+        QString value;
+        std::vector<int> children;
+
+        /**
+         * The rule that matches a token, if this op is one, and the same rule
+         * without trivia skipping, so that the token's span can be found.
+         */
+        rule::Proxy<Input, PNode> token;
+        rule::Proxy<Input, PNode> bareToken;
+        std::string expected;
+
+        /**
+         * Whether the op always matches, so that it can't cause anything
+         * before it to be backtracked over.
+         */
+        bool neverFails;
+    };
+
+    struct Program
+    {
+        std::vector<Op> ops;
+        QHash<QString, int> rules;
+        rule::Skipper<Input, PNode> skipper;
+        bool cuts;
+        Actions<PNode> actions;
+    };
+
+    struct Frame
+    {
+        int op;
+        int state;
+        int start;
+        int head;
+        int end;
+        int good;
+        int goodHead;
+        int goodEnd;
+        bool outerCut;
+        bool matched;
+    };
+
+    /**
+     * Builds the results into Result, as the built rules would.
+     */
+    class TreeOutput
+    {
+        Result<PNode>& _result;
+
+        // The results of each named rule that's running, which are reduced into
+        // the results of the rule that called it
+        std::vector<Result<PNode>> _called;
+
+        // Where the first token of each named rule that's running started, or
+        // -1 if it hasn't read one
+        std::vector<int> _starts;
+
+        // The end of the last token that was matched, including discarded ones
+        int _end;
+
+        Result<PNode>& results()
+        {
+            return _called.empty() ? _result : _called.back();
+        }
+
+    public:
+        TreeOutput(Result<PNode>& result) :
+            _result(result),
+            _end(0)
+        {
+        }
+
+        int head()
+        {
+            return results().head();
+        }
+
+        void rewind(const int head)
+        {
+            results().moveHead(head);
+        }
+
+        int end() const
+        {
+            return _end;
+        }
+
+        void setEnd(const int end)
+        {
+            _end = end;
+        }
+
+        bool token(const Program&, const Op& op, Cursor<Input>& iter)
+        {
+            Result<PNode>& dest = results();
+            const int head = dest.head();
+            if (!op.token(iter, dest)) {
+                return false;
+            }
+            if (dest.head() == head) {
+                return true;
+            }
+            const PNode& token = *(dest.begin() + dest.head() - 1);
+            _end = token.end();
+            for (int i = _starts.size() - 1; i >= 0 && _starts[i] < 0; --i) {
+                _starts[i] = token.start();
+            }
+            return true;
+        }
+
+        void enter(const Op& op, const bool grouped, const int start)
+        {
+            _called.emplace_back();
+            _starts.push_back(-1);
+        }
+
+        void exit(const Op& op, const bool matched, const bool grouped, const int start)
+        {
+            Result<PNode> src = std::move(_called.back());
+            _called.pop_back();
+            const int spanStart = _starts.back() >= 0 ? _starts.back() : _end;
+            _starts.pop_back();
+            if (!matched) {
+                return;
+            }
+            // Move each subtree up, since copying it would copy all of its descendants
+            Result<PNode>& dest = results();
+            auto begin = src.begin() + src.pos();
+            auto end = src.begin() + src.head();
+            if (grouped) {
+                for (auto token = begin; token != end; ++token) {
+                    dest.insert(std::move(*token));
+                }
+                return;
+            }
+            PNode rv(op.value);
+            for (auto token = begin; token != end; ++token) {
+                rv.insert(std::move(*token));
+            }
+            rv.setSpan(spanStart, std::max(spanStart, _end));
+            dest.insert(std::move(rv));
+        }
+
+        void group(const Op& op, const int head, const int start)
+        {
+            Result<PNode>& dest = results();
+            PNode recursiveNode(op.value);
+            for (auto token = dest.begin() + head; token != dest.begin() + dest.head(); ++token) {
+                recursiveNode.insert(std::move(*token));
+            }
+            if (recursiveNode.size() > 0) {
+                recursiveNode.setSpan(recursiveNode[0].start(), std::max(recursiveNode[0].start(), _end));
+            }
+            dest.moveHead(head);
+            dest.insert(std::move(recursiveNode));
+        }
+
+        bool wantsFlush() const
+        {
+            return false;
+        }
+
+        void flush(const int)
+        {
+        }
+
+        void finish(const bool)
+        {
+        }
+    };
+
+    /**
+     * Sends the results to an EventHandler, buffering events until no
+     * backtracking can discard them.
+     */
+    class EventOutput
+    {
+        enum class Kind {
+            Enter,
+            Exit,
+            Token
+        };
+
+        struct Event
+        {
+            Kind kind;
+            Type type;
+            Value value;
+            int start;
+            int end;
+        };
+
+        static const int MIN_BUFFERED = 256;
+
+        EventHandler<Type, Value>& _handler;
+
+        // Events before the base have been sent to the handler
+        std::vector<Event> _events;
+        int _base;
+
+        // The end of the last token that was matched, including discarded ones
+        int _end;
+
+        unsigned _flushAt;
+
+        void send(const Event& event)
+        {
+            switch (event.kind) {
+                case Kind::Enter:
+                    _handler.enterRule(event.type, event.start);
+                    break;
+                case Kind::Exit:
+                    _handler.exitRule(event.type, event.start, event.end);
+                    break;
+                case Kind::Token:
+                    _handler.token(event.type, event.value, event.start, event.end);
+                    break;
+            }
+        }
+
+    public:
+        EventOutput(EventHandler<Type, Value>& handler) :
+            _handler(handler),
+            _base(0),
+            _end(0),
+            _flushAt(MIN_BUFFERED)
+        {
+        }
+
+        int head()
+        {
+            return _base + _events.size();
+        }
+
+        void rewind(const int head)
+        {
+            if (head < _base) {
+                throw std::logic_error("Events that were sent must not be backtracked over");
+            }
+            _events.resize(head - _base);
+        }
+
+        int end() const
+        {
+            return _end;
+        }
+
+        void setEnd(const int end)
+        {
+            _end = end;
+        }
+
+        bool token(const Program& program, const Op& op, Cursor<Input>& iter)
+        {
+            const int start = iter.pos();
+            Result<PNode> tokens;
+            if (!op.bareToken(iter, tokens)) {
+                iter.failure().expect(start, op.expected);
+                return false;
+            }
+            _end = iter.pos();
+            program.skipper(iter);
+            while (tokens) {
+                const PNode& token = tokens.get();
+                _events.push_back(Event { Kind::Token, token.type(), token.value(), start, _end });
+                ++tokens;
+            }
+            return true;
+        }
+
+        void enter(const Op& op, const bool grouped, const int start)
+        {
+            if (!grouped) {
+                _events.push_back(Event { Kind::Enter, op.value, Value(), start, start });
+            }
+        }
+
+        void exit(const Op& op, const bool matched, const bool grouped, const int start)
+        {
+            // Failures rewind to before the Enter event
+            if (!matched || grouped) {
+                return;
+            }
+            _events.push_back(Event { Kind::Exit, op.value, Value(), start, std::max(start, _end) });
+        }
+
+        void group(const Op& op, const int head, const int start)
+        {
+            _events.insert(_events.begin() + (head - _base), Event { Kind::Enter, op.value, Value(), start, start });
+            _events.push_back(Event { Kind::Exit, op.value, Value(), start, std::max(start, _end) });
+        }
+
+        bool wantsFlush() const
+        {
+            return _events.size() >= _flushAt;
+        }
+
+        /**
+         * Sends the events before the head, which no backtracking can discard.
+         */
+        void flush(const int head)
+        {
+            const int count = std::min(head, this->head()) - _base;
+            if (count <= 0) {
+                // Wait until many more events are buffered before trying again
+                _flushAt = _events.size() * 2;
+                return;
+            }
+            for (int i = 0; i < count; ++i) {
+                send(_events[i]);
+            }
+            _events.erase(_events.begin(), _events.begin() + count);
+            _base += count;
+            _flushAt = _events.size() * 2;
+            if (_flushAt < MIN_BUFFERED) {
+                _flushAt = MIN_BUFFERED;
+            }
+        }
+
+        void finish(const bool matched)
+        {
+            if (matched) {
+                flush(head());
+            }
+            _events.clear();
+        }
+    };
+
+    /**
+     * Constructs values with the grammar's semantic actions, as each rule
+     * matches.
+     */
+    class ActionOutput
+    {
+        const Actions<PNode>& _actions;
+        std::vector<SemanticValue>& _values;
+
+        // Where the values of each named rule that's running begin
+        std::vector<int> _heads;
+
+        // The end of the last token that was matched, including discarded ones
+        int _end;
+
+        /**
+         * Replaces the values after the head with the value of the named
+         * rule's action, if it has one.
+         */
+        void reduce(const QString& name, const int head, const int start)
+        {
+            auto action = _actions.find(name);
+            if (!action) {
+                return;
+            }
+            ActionValues<PNode> values(_values.data() + head, _values.size() - head, start, std::max(start, _end));
+            SemanticValue rv = (*action)(values);
+            _values.resize(head);
+            _values.push_back(rv);
+        }
+
+    public:
+        ActionOutput(const Actions<PNode>& actions, std::vector<SemanticValue>& values) :
+            _actions(actions),
+            _values(values),
+            _end(0)
+        {
+        }
+
+        int head()
+        {
+            return _values.size();
+        }
+
+        void rewind(const int head)
+        {
+            _values.resize(head);
+        }
+
+        int end() const
+        {
+            return _end;
+        }
+
+        void setEnd(const int end)
+        {
+            _end = end;
+        }
+
+        bool token(const Program& program, const Op& op, Cursor<Input>& iter)
+        {
+            const int start = iter.pos();
+            Result<PNode> tokens;
+            if (!op.bareToken(iter, tokens)) {
+                iter.failure().expect(start, op.expected);
+                return false;
+            }
+            _end = iter.pos();
+            program.skipper(iter);
+            const int head = this->head();
+            while (tokens) {
+                _values.push_back(SemanticValue::make(*tokens++));
+            }
+            reduce(op.value, head, start);
+            return true;
+        }
+
+        void enter(const Op&, const bool, const int)
+        {
+            _heads.push_back(head());
+        }
+
+        void exit(const Op& op, const bool matched, const bool grouped, const int start)
+        {
+            const int head = _heads.back();
+            _heads.pop_back();
+            if (!matched) {
+                return;
+            }
+            if (grouped && op.type == TokenType::Rule) {
+                // Its recursion was already reduced by group()
+                return;
+            }
+            reduce(op.value, head, start);
+        }
+
+        void group(const Op& op, const int head, const int start)
+        {
+            reduce(op.value, head, start);
+        }
+
+        bool wantsFlush() const
+        {
+            return false;
+        }
+
+        void flush(const int)
+        {
+        }
+
+        void finish(const bool)
+        {
+        }
+    };
+
+    std::shared_ptr<const Program> _program;
+
+    static int addOp(Program& program, const TokenType type, const QString& value = QString())
+    {
+        Op op;
+        op.type = type;
+        op.value = value;
+        op.neverFails = false;
+        program.ops.push_back(op);
+        return program.ops.size() - 1;
+    }
+
+    static rule::Skipper<QChar, PNode> skipper(Grammar<Type, Value>& grammar, const QChar*)
+    {
+        return rule::Skipper<QChar, PNode>(grammar.trivia());
+    }
+
+    static rule::Skipper<typename Grammar<Type, Value>::LexemeType, PNode> skipper(Grammar<Type, Value>&, const typename Grammar<Type, Value>::LexemeType*)
+    {
+        // Trivia was already skipped by the lexer
+        return rule::Skipper<typename Grammar<Type, Value>::LexemeType, PNode>();
+    }
+
+    static int compile(Grammar<Type, Value>& grammar, Program& program, const GNode& node, const TokenType ruleType)
+    {
+        switch (node.type()) {
+            case TokenType::Name:
+                if (program.rules.contains(node.value())) {
+                    return program.rules[node.value()];
+                }
+                // Otherwise, it's a token
+            case TokenType::Literal:
+            case TokenType::Opaque:
+            {
+                auto token = grammar.template buildRule<Input>(node, ruleType);
+                auto bareToken = grammar.template buildRule<Input>(node, TokenType::TokenRule);
+                const int index = addOp(program, TokenType::Literal, node.value());
+                Op& op = program.ops[index];
+                op.token = token;
+                op.bareToken = bareToken;
+                op.expected = node.type() == TokenType::Literal ?
+                    "'" + node.value().toStdString() + "'" :
+                    node.value().toStdString();
+                return index;
+            }
+            case TokenType::Cut:
+                program.cuts = true;
+                return addOp(program, TokenType::Cut);
+            case TokenType::Sequence:
+            case TokenType::Join:
+            case TokenType::Alternative:
+            case TokenType::Recursive:
+            case TokenType::ZeroOrMore:
+            case TokenType::OneOrMore:
+            case TokenType::Optional:
+            case TokenType::Discard:
+            {
+                std::vector<int> children;
+                for (unsigned i = 0; i < node.size(); ++i) {
+                    const GNode& child = node[i];
+                    int compiled = compile(grammar, program, child, ruleType);
+                    const bool discarded = child.type() == TokenType::Literal && (
+                        node.type() == TokenType::Sequence ||
+                        (node.type() == TokenType::Join && i == 1)
+                    );
+                    if (discarded) {
+                        const int discard = addOp(program, TokenType::Discard);
+                        program.ops[discard].children.push_back(compiled);
+                        compiled = discard;
+                    }
+                    children.push_back(compiled);
+                }
+                const int index = addOp(program, node.type(), node.value());
+                program.ops[index].children = children;
+                return index;
+            }
+            default:
+            {
+                std::stringstream str;
+                str << "I don't know how to evaluate a " << node.type() << " rule";
+                throw std::runtime_error(str.str());
+            }
+        }
+    }
+
+    static void moveTo(Cursor<Input>& iter, const int pos)
+    {
+        iter += pos - iter.pos();
+    }
+
+    /**
+     * Returns the lowest head that the running frames could still backtrack to.
+     */
+    int stableHead(const std::vector<Frame>& frames) const
+    {
+        const std::vector<Op>& ops = _program->ops;
+
+        int stable = INT_MAX;
+
+        // Whether the frame above can still fail
+        bool failing = true;
+        for (int i = frames.size() - 1; i >= 0; --i) {
+            const Frame& frame = frames[i];
+            const Op& op = ops[frame.op];
+            switch (op.type) {
+                case TokenType::Rule:
+                case TokenType::GroupRule:
+                    if (failing) {
+                        stable = std::min(stable, frame.head);
+                    }
+                    break;
+                case TokenType::Sequence:
+                {
+                    for (unsigned j = frame.state; j < op.children.size(); ++j) {
+                        failing = failing || !ops[op.children[j]].neverFails;
+                    }
+                    if (failing) {
+                        stable = std::min(stable, frame.head);
+                    }
+                    break;
+                }
+                case TokenType::Alternative:
+                    if (failing) {
+                        stable = std::min(stable, frame.head);
+                    }
+                    break;
+                case TokenType::ZeroOrMore:
+                case TokenType::OneOrMore:
+                case TokenType::Optional:
+                {
+                    const int min = op.type == TokenType::OneOrMore ? 1 : 0;
+                    if (!failing) {
+                        break;
+                    }
+                    if (frame.state >= min && !_program->cuts) {
+                        // Its repetition failing only ends it
+                        failing = false;
+                        break;
+                    }
+                    stable = std::min(stable, frame.head);
+                    break;
+                }
+                case TokenType::Join:
+                    if (!failing) {
+                        break;
+                    }
+                    if (frame.state == 2) {
+                        failing = false;
+                    } else if (frame.good < 0) {
+                        stable = std::min(stable, frame.head);
+                    } else {
+                        stable = std::min(stable, frame.goodHead);
+                        failing = false;
+                    }
+                    break;
+                case TokenType::Recursive:
+                    // Grouping inserts before everything that it matched
+                    stable = std::min(stable, frame.head);
+                    if (failing && frame.state == 2 && frame.matched) {
+                        failing = false;
+                    }
+                    break;
+                case TokenType::Discard:
+                    // Discarding rewinds even when it matches
+                    stable = std::min(stable, frame.head);
+                    break;
+                default:
+                    break;
+            }
+        }
+        return stable;
+    }
+
+    template <class Output>
+    bool evaluate(const QString& name, Cursor<Input>& iter, Output& output) const
+    {
+        const std::vector<Op>& ops = _program->ops;
+        if (!_program->rules.contains(name)) {
+            std::stringstream str;
+            str << "The named rule '" << name.toUtf8().constData() << "' could not be resolved";
+            throw std::runtime_error(str.str());
+        }
+
+        Budget* const budget = iter.budget();
+
+        std::vector<Frame> frames;
+
+        bool resumed = false;
+        bool matched = false;
+
+        auto push = [&](const int op) {
+            frames.push_back(Frame { op, 0, iter.pos(), output.head(), output.end(), -1, 0, 0, false, false });
+            resumed = false;
+        };
+        auto finish = [&](const bool rv) {
+            frames.pop_back();
+            matched = rv;
+            resumed = true;
+        };
+        auto fail = [&](const Frame& frame) {
+            moveTo(iter, frame.start);
+            output.rewind(frame.head);
+            output.setEnd(frame.end);
+            finish(false);
+        };
+
+        push(_program->rules[name]);
+        while (!frames.empty()) {
+            Frame& frame = frames.back();
+            const Op& op = ops[frame.op];
+            switch (op.type) {
+                case TokenType::Literal:
+                {
+                    if (!output.token(*_program, op, iter)) {
+                        fail(frame);
+                        break;
+                    }
+                    finish(true);
+                    if (output.wantsFlush()) {
+                        output.flush(stableHead(frames));
+                    }
+                    break;
+                }
+                case TokenType::Cut:
+                {
+                    iter.cut();
+                    finish(true);
+                    break;
+                }
+                case TokenType::Rule:
+                case TokenType::GroupRule:
+                {
+                    // Recursive rules already create a group node, so don't double-nest it
+                    const bool grouped = op.type == TokenType::GroupRule || ops[op.children[0]].type == TokenType::Recursive;
+                    if (!resumed) {
+                        if (budget && !budget->enter()) {
+                            finish(false);
+                            break;
+                        }
+                        output.enter(op, grouped, iter.pos());
+                        push(op.children[0]);
+                        break;
+                    }
+                    if (budget) {
+                        budget->exit();
+                    }
+                    output.exit(op, matched, grouped, frame.start);
+                    if (!matched) {
+                        fail(frame);
+                        break;
+                    }
+                    finish(true);
+                    break;
+                }
+                case TokenType::Sequence:
+                {
+                    if (resumed && !matched) {
+                        fail(frame);
+                        break;
+                    }
+                    if (frame.state == static_cast<int>(op.children.size())) {
+                        finish(true);
+                        break;
+                    }
+                    push(op.children[frame.state++]);
+                    break;
+                }
+                case TokenType::Alternative:
+                {
+                    if (!resumed) {
+                        frame.outerCut = iter.setCut(false);
+                    } else if (matched) {
+                        iter.setCut(frame.outerCut);
+                        finish(true);
+                        break;
+                    } else if (iter.isCut()) {
+                        // The choice failed after a cut, so don't try the others
+                        iter.setCut(frame.outerCut);
+                        fail(frame);
+                        break;
+                    }
+                    if (frame.state == static_cast<int>(op.children.size())) {
+                        iter.setCut(frame.outerCut);
+                        fail(frame);
+                        break;
+                    }
+                    iter.setCut(false);
+                    push(op.children[frame.state++]);
+                    break;
+                }
+                case TokenType::ZeroOrMore:
+                case TokenType::OneOrMore:
+                case TokenType::Optional:
+                {
+                    const int min = op.type == TokenType::OneOrMore ? 1 : 0;
+                    const int max = op.type == TokenType::Optional ? 1 : -1;
+                    if (!resumed) {
+                        frame.outerCut = iter.setCut(false);
+                        frame.good = iter.pos();
+                    } else if (!matched) {
+                        const bool committed = iter.isCut();
+                        iter.setCut(frame.outerCut);
+                        if (committed || frame.state < min) {
+                            fail(frame);
+                        } else {
+                            finish(true);
+                        }
+                        break;
+                    } else {
+                        ++frame.state;
+                        if (iter.pos() == frame.good) {
+                            // Another iteration would read nothing too
+                            iter.setCut(frame.outerCut);
+                            finish(true);
+                            break;
+                        }
+                        frame.good = iter.pos();
+                    }
+                    if (max >= 0 && frame.state >= max) {
+                        iter.setCut(frame.outerCut);
+                        finish(true);
+                        break;
+                    }
+                    iter.setCut(false);
+                    push(op.children[0]);
+                    break;
+                }
+                case TokenType::Discard:
+                {
+                    if (!resumed) {
+                        push(op.children[0]);
+                        break;
+                    }
+                    if (matched) {
+                        output.rewind(frame.head);
+                    }
+                    finish(matched);
+                    break;
+                }
+                case TokenType::Join:
+                {
+                    if (!resumed) {
+                        frame.state = 1;
+                        push(op.children[0]);
+                        break;
+                    }
+                    if (frame.state == 1) {
+                        // The content returned
+                        if (!matched) {
+                            if (frame.good < 0) {
+                                fail(frame);
+                                break;
+                            }
+                            // Disregard the separator before it
+                            moveTo(iter, frame.good);
+                            output.rewind(frame.goodHead);
+                            output.setEnd(frame.goodEnd);
+                            finish(true);
+                            break;
+                        }
+                        frame.good = iter.pos();
+                        frame.goodHead = output.head();
+                        frame.goodEnd = output.end();
+                        frame.state = 2;
+                        push(op.children[1]);
+                        break;
+                    }
+                    // The separator returned
+                    if (!matched) {
+                        finish(true);
+                        break;
+                    }
+                    frame.state = 1;
+                    push(op.children[0]);
+                    break;
+                }
+                case TokenType::Recursive:
+                {
+                    if (!resumed) {
+                        frame.state = 1;
+                        push(op.children[0]);
+                        break;
+                    }
+                    if (frame.state == 1 && !matched) {
+                        fail(frame);
+                        break;
+                    }
+                    if (frame.state == 2) {
+                        if (!matched) {
+                            if (frame.matched) {
+                                finish(true);
+                            } else {
+                                fail(frame);
+                            }
+                            break;
+                        }
+                        frame.matched = true;
+
+                        // Group everything this rule has matched so far
+                        output.group(op, frame.head, frame.start);
+                    }
+                    frame.state = 2;
+                    push(op.children[1]);
+                    break;
+                }
+                default:
+                {
+                    std::stringstream str;
+                    str << "I don't know how to evaluate a " << op.type << " rule";
+                    throw std::logic_error(str.str());
+                }
+            }
+        }
+        output.finish(matched);
+        return matched;
+    }
+
+public:
+    StackEvaluator(Grammar<Type, Value>& grammar)
+    {
+        const Input* input = nullptr;
+
+        auto program = std::make_shared<Program>();
+        program->skipper = skipper(grammar, input);
+        program->cuts = false;
+        program->actions = grammar.actions();
+
+        auto& parsedRules = grammar.parsedRules();
+
+        // Every named rule needs an op before any rule can refer to it
+        for (auto iter = parsedRules.begin(); iter != parsedRules.end(); ++iter) {
+            if (iter.value().type() != TokenType::TokenRule) {
+                program->rules[iter.key()] = addOp(*program, iter.value().type(), iter.key());
+            }
+        }
+        for (auto iter = parsedRules.begin(); iter != parsedRules.end(); ++iter) {
+            if (iter.value().type() != TokenType::TokenRule) {
+                const int body = compile(grammar, *program, iter.value()[0], iter.value().type());
+                program->ops[program->rules[iter.key()]].children.push_back(body);
+            }
+        }
+
+        // Children are compiled before their parents, except for named rules,
+        // which are assumed to fail
+        for (auto& op : program->ops) {
+            switch (op.type) {
+                case TokenType::Cut:
+                    op.neverFails = true;
+                    break;
+                case TokenType::ZeroOrMore:
+                case TokenType::Optional:
+                    op.neverFails = !program->cuts;
+                    break;
+                case TokenType::Sequence:
+                case TokenType::Discard:
+                    op.neverFails = true;
+                    for (auto child : op.children) {
+                        op.neverFails = op.neverFails && program->ops[child].neverFails;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        _program = program;
+    }
+
+    /**
+     * Matches the named rule, building its results.
+     */
+    bool operator()(const QString& name, Cursor<Input>& iter, Result<PNode>& result) const
+    {
+        TreeOutput output(result);
+        return evaluate(name, iter, output);
+    }
+
+    /**
+     * Matches the named rule, sending its results to the handler as events
+     * instead of building them.
+     */
+    bool operator()(const QString& name, Cursor<Input>& iter, EventHandler<Type, Value>& handler) const
+    {
+        EventOutput output(handler);
+        return evaluate(name, iter, output);
+    }
+
+    /**
+     * Matches the named rule, constructing its values with the semantic
+     * actions that were bound to the grammar. Values of rules without an
+     * action are passed through, so values has the tokens and the values of
+     * the outermost actions that the rule matched.
+     */
+    bool operator()(const QString& name, Cursor<Input>& iter, std::vector<SemanticValue>& values) const
+    {
+        ActionOutput output(_program->actions, values);
+        return evaluate(name, iter, output);
+    }
+
+    /**
+     * Matches the named rule, which must have an action that returns a T,
+     * and sets value to what the action returned.
+     */
+    template <class T>
+    bool parse(const QString& name, Cursor<Input>& iter, T& value) const
+    {
+        std::vector<SemanticValue> values;
+        if (!(*this)(name, iter, values)) {
+            return false;
+        }
+        if (values.size() != 1) {
+            std::stringstream str;
+            str << "The rule '" << name.toUtf8().constData() << "' matched " << values.size()
+                << " values instead of the value of its action";
+            throw std::runtime_error(str.str());
+        }
+        value = values[0].template as<T>();
+        return true;
+    }
+
+    /**
+     * Returns a rule that evaluates the named rule.
+     */
+    rule::Proxy<Input, PNode> rule(const QString& name) const
+    {
+        auto evaluator = *this;
+        return [evaluator, name](Cursor<Input>& iter, Result<PNode>& result) {
+            return evaluator(name, iter, result);
+        };
+    }
+};
+
+template <class Input = QChar, class Type, class Value>
+StackEvaluator<Type, Value, Input> stackEvaluator(Grammar<Type, Value>& grammar)
+{
+    return StackEvaluator<Type, Value, Input>(grammar);
+}
+
+} // namespace grammar
+} // namespace sprout
+
+#endif // SPROUT_GRAMMAR_STACKEVALUATOR_HEADER
+
+// vim: set ts=4 sw=4 :
@@ -0,0 +1,425 @@
+#include <grammar/TokenDfa.hpp>
+#include <grammar/Grammar.hpp>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace sprout {
+namespace grammar {
+
+namespace {
+
+/**
+ * The most DFA states that a Token rule may compile into.
+ */
+const int MAX_STATES = 1024;
+
+/**
+ * The most character classes that a Token rule may use, since every
+ * combination of them is a symbol.
+ */
+const int MAX_CLASSES = 8;
+
+/**
+ * Characters below this are mapped to symbols by a lookup table.
+ */
+const int ASCII_SIZE = 128;
+
+enum class Match {
+    None,
+    Char,
+    Class
+};
+
+struct NfaState
+{
+    Match match;
+    QChar c;
+    int charClass;
+    bool keep;
+
+    /**
+     * The state that follows a matching character.
+     */
+    int next;
+
+    std::vector<int> epsilon;
+
+    NfaState() :
+        match(Match::None),
+        charClass(-1),
+        keep(true),
+        next(-1)
+    {
+    }
+};
+
+struct Fragment
+{
+    int start;
+    int end;
+};
+
+/**
+ * \brief Builds an NFA from the parsed nodes of a Token rule.
+ */
+class NfaBuilder
+{
+    const QHash<QString, GNode>& _rules;
+    const QHash<QString, TokenDfa::CharClass>& _classes;
+
+    std::set<QString> _inlining;
+
+    int addState()
+    {
+        states.push_back(NfaState());
+        return states.size() - 1;
+    }
+
+    void link(const int from, const int to)
+    {
+        states[from].epsilon.push_back(to);
+    }
+
+    int matching(const Match match, const bool keep, Fragment& fragment)
+    {
+        fragment.start = addState();
+        fragment.end = addState();
+        states[fragment.start].match = match;
+        states[fragment.start].keep = keep;
+        states[fragment.start].next = fragment.end;
+        return fragment.start;
+    }
+
+    bool buildReference(const QString& name, const bool keep, Fragment& fragment)
+    {
+        if (_classes.contains(name)) {
+            int state = matching(Match::Class, keep, fragment);
+            auto found = std::find(classNames.begin(), classNames.end(), name);
+            states[state].charClass = found - classNames.begin();
+            if (found == classNames.end()) {
+                classNames.push_back(name);
+            }
+            return true;
+        }
+
+        if (!_rules.contains(name) || _inlining.count(name) > 0) {
+            return false;
+        }
+        GNode rule = _rules.value(name);
+        if (rule.type() != TokenType::TokenRule || rule[0].type() != TokenType::Sequence) {
+            // Only sequences produce a single token, so nothing else can be inlined
+            return false;
+        }
+        _inlining.insert(name);
+        bool built = build(rule[0], keep, fragment);
+        _inlining.erase(name);
+        return built;
+    }
+
+public:
+    std::vector<NfaState> states;
+    std::vector<QString> classNames;
+
+    NfaBuilder(const QHash<QString, GNode>& rules, const QHash<QString, TokenDfa::CharClass>& classes) :
+        _rules(rules),
+        _classes(classes)
+    {
+    }
+
+    bool build(const GNode& node, const bool keep, Fragment& fragment)
+    {
+        switch (node.type()) {
+            case TokenType::Literal:
+            {
+                fragment.start = addState();
+                fragment.end = fragment.start;
+                for (auto c : node.value()) {
+                    int next = addState();
+                    states[fragment.end].match = Match::Char;
+                    states[fragment.end].c = c;
+                    states[fragment.end].keep = keep;
+                    states[fragment.end].next = next;
+                    fragment.end = next;
+                }
+                return true;
+            }
+            case TokenType::Sequence:
+            {
+                fragment.start = addState();
+                fragment.end = fragment.start;
+                for (auto& child : node.children()) {
+                    Fragment childFragment;
+                    if (!build(child, keep && child.type() != TokenType::Literal, childFragment)) {
+                        return false;
+                    }
+                    link(fragment.end, childFragment.start);
+                    fragment.end = childFragment.end;
+                }
+                return true;
+            }
+            case TokenType::Alternative:
+            {
+                fragment.start = addState();
+                fragment.end = addState();
+                for (auto& child : node.children()) {
+                    Fragment childFragment;
+                    if (!build(child, keep, childFragment)) {
+                        return false;
+                    }
+                    link(fragment.start, childFragment.start);
+                    link(childFragment.end, fragment.end);
+                }
+                return true;
+            }
+            case TokenType::Optional:
+            case TokenType::ZeroOrMore:
+            case TokenType::OneOrMore:
+            {
+                Fragment child;
+                if (!build(node[0], keep, child)) {
+                    return false;
+                }
+                fragment.start = addState();
+                fragment.end = addState();
+                link(fragment.start, child.start);
+                link(child.end, fragment.end);
+                if (node.type() != TokenType::OneOrMore) {
+                    link(fragment.start, fragment.end);
+                }
+                if (node.type() != TokenType::Optional) {
+                    link(child.end, child.start);
+                }
+                return true;
+            }
+            case TokenType::Join:
+            {
+                Fragment first;
+                Fragment separator;
+                Fragment rest;
+                if (!build(node[0], keep, first) ||
+                        !build(node[1], keep && node[1].type() != TokenType::Literal, separator) ||
+                        !build(node[0], keep, rest)) {
+                    return false;
+                }
+                fragment.start = first.start;
+                fragment.end = addState();
+                link(first.end, fragment.end);
+                link(first.end, separator.start);
+                link(separator.end, rest.start);
+                link(rest.end, separator.start);
+                link(rest.end, fragment.end);
+                return true;
+            }
+            case TokenType::Discard:
+            {
+                return build(node[0], false, fragment);
+            }
+            case TokenType::Opaque:
+            case TokenType::Name:
+            {
+                return buildReference(node.value(), keep, fragment);
+            }
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
+    void close(std::vector<int>& set) const
+    {
+        std::vector<int> pending(set);
+        std::set<int> found(set.begin(), set.end());
+        while (!pending.empty()) {
+            int state = pending.back();
+            pending.pop_back();
+            for (int next : states[state].epsilon) {
+                if (found.insert(next).second) {
+                    pending.push_back(next);
+                }
+            }
+        }
+        set.assign(found.begin(), found.end());
+    }
+};
+
+} // namespace anonymous
+
+TokenDfa::TokenDfa() :
+    _charCount(0),
+    _symbolCount(0)
+{
+}
+
+int TokenDfa::classify(const QChar& c) const
+{
+    auto found = _chars.find(c.unicode());
+    if (found != _chars.end()) {
+        return found.value();
+    }
+    int mask = 0;
+    for (unsigned int i = 0; i < _classes.size(); ++i) {
+        if (_classes[i](c)) {
+            mask |= 1 << i;
+        }
+    }
+    return _charCount + mask;
+}
+
+bool TokenDfa::compile(
+    const QString& name,
+    const QHash<QString, GNode>& rules,
+    const QHash<QString, CharClass>& classes)
+{
+    *this = TokenDfa();
+
+    NfaBuilder builder(rules, classes);
+    GNode reference(TokenType::Name, name);
+    Fragment nfa;
+    if (!builder.build(reference, true, nfa) || builder.classNames.size() > MAX_CLASSES) {
+        return false;
+    }
+    auto& states = builder.states;
+
+    std::vector<QChar> chars;
+    for (auto& state : states) {
+        if (state.match == Match::Char && !_chars.contains(state.c.unicode())) {
+            _chars[state.c.unicode()] = chars.size();
+            chars.push_back(state.c);
+        }
+    }
+    for (auto& className : builder.classNames) {
+        _classes.push_back(classes[className]);
+    }
+    _charCount = chars.size();
+    _symbolCount = _charCount + (1 << _classes.size());
+
+    auto matches = [&](const NfaState& state, const int symbol) {
+        switch (state.match) {
+            case Match::Char:
+                return symbol < _charCount && chars[symbol] == state.c;
+            case Match::Class:
+                if (symbol < _charCount) {
+                    return _classes[state.charClass](chars[symbol]);
+                }
+                return ((symbol - _charCount) & (1 << state.charClass)) != 0;
+            default:
+                return false;
+        }
+    };
+
+    std::vector<int> start(1, nfa.start);
+    builder.close(start);
+
+    std::map<std::vector<int>, int> dfaStates;
+    std::vector<std::vector<int>> pending;
+    dfaStates[start] = 0;
+    pending.push_back(start);
+
+    for (unsigned int current = 0; current < pending.size(); ++current) {
+        std::vector<int> set = pending[current];
+        _accepting.push_back(std::binary_search(set.begin(), set.end(), nfa.end));
+
+        for (int symbol = 0; symbol < _symbolCount; ++symbol) {
+            std::vector<int> next;
+            int keep = -1;
+            for (int nfaState : set) {
+                auto& state = states[nfaState];
+                if (!matches(state, symbol)) {
+                    continue;
+                }
+                if (keep >= 0 && keep != state.keep) {
+                    // The character's text depends on how it's matched
+                    *this = TokenDfa();
+                    return false;
+                }
+                keep = state.keep;
+                next.push_back(state.next);
+            }
+
+            if (next.empty()) {
+                _transitions.push_back(-1);
+                _keep.push_back(false);
+                continue;
+            }
+
+            builder.close(next);
+            auto found = dfaStates.find(next);
+            if (found == dfaStates.end()) {
+                if (pending.size() >= MAX_STATES) {
+                    *this = TokenDfa();
+                    return false;
+                }
+                found = dfaStates.insert(std::make_pair(next, pending.size())).first;
+                pending.push_back(next);
+            }
+            _transitions.push_back(found->second);
+            _keep.push_back(keep);
+        }
+    }
+
+    _ascii.resize(ASCII_SIZE);
+    for (int i = 0; i < ASCII_SIZE; ++i) {
+        _ascii[i] = classify(QChar(i));
+    }
+
+    return true;
+}
+
+bool TokenDfa::operator()(Cursor<QChar>& orig, QString& text) const
+{
+    if (!compiled()) {
+        return false;
+    }
+
+    auto iter = orig;
+    int state = 0;
+    int length = 0;
+    int kept = 0;
+
+    int acceptedLength = _accepting[0] ? 0 : -1;
+    int acceptedKept = 0;
+
+    while (iter) {
+        int index = state * _symbolCount + symbol(*iter);
+        state = _transitions[index];
+        if (state < 0) {
+            break;
+        }
+        ++iter;
+        ++length;
+        if (_keep[index]) {
+            ++kept;
+        }
+        if (_accepting[state]) {
+            acceptedLength = length;
+            acceptedKept = kept;
+        }
+    }
+
+    if (acceptedLength < 0) {
+        return false;
+    }
+
+    // Now that the token's size is known, replay the match to copy its text
+    text.resize(acceptedKept);
+    QChar* out = text.data();
+    state = 0;
+    for (int i = 0; i < acceptedLength; ++i) {
+        QChar c = *orig;
+        int index = state * _symbolCount + symbol(c);
+        state = _transitions[index];
+        if (_keep[index]) {
+            *out++ = c;
+        }
+        ++orig;
+    }
+    return true;
+}
+
+} // namespace grammar
+} // namespace sprout
+
+// vim: set ts=4 sw=4 :
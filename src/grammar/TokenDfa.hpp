@@ -0,0 +1,105 @@
+#ifndef SPROUT_GRAMMAR_TOKENDFA_HEADER
+#define SPROUT_GRAMMAR_TOKENDFA_HEADER
+
+#include "Node.hpp"
+
+#include <Cursor.hpp>
+#include <CharClass.hpp>
+
+#include <QHash>
+#include <QString>
+#include <QChar>
+
+#include <functional>
+#include <vector>
+
+namespace sprout {
+namespace grammar {
+
+enum class TokenType;
+
+/**
+ * \brief A Token rule compiled into a table-driven DFA.
+ *
+ * Token rules that are built only from literals, character classes and other
+ * regular Token rules are compiled into a single scanning loop, instead of
+ * nested combinators that each produce a node to be concatenated.
+ *
+ * Input characters are first mapped to symbols: every character that appears
+ * in a literal is its own symbol, and all other characters are grouped by the
+ * character classes that they satisfy. Characters below 128 are mapped by a
+ * lookup table.
+ *
+ * The DFA takes the longest match, whereas combinators take the first choice
+ * that matches, so the two differ for rules like ('a' | 'ab'). Literals that
+ * are directly within a sequence are discarded from the token's text, just as
+ * they are by the combinators. Rules where a character could be either kept
+ * or discarded depending on how it's matched are not compiled.
+ */
+class TokenDfa
+{
+public:
+    typedef sprout::CharClass CharClass;
+
+private:
+    std::vector<CharClass> _classes;
+
+    QHash<ushort, int> _chars;
+    int _charCount;
+    int _symbolCount;
+
+    std::vector<int> _ascii;
+
+    std::vector<int> _transitions;
+    std::vector<bool> _keep;
+    std::vector<bool> _accepting;
+
+    int symbol(const QChar& c) const
+    {
+        ushort code = c.unicode();
+        if (code < _ascii.size()) {
+            return _ascii[code];
+        }
+        return classify(c);
+    }
+
+    int classify(const QChar& c) const;
+
+public:
+    TokenDfa();
+
+    /**
+     * Compiles the named Token rule. Returns false, leaving this DFA empty, if
+     * the rule is not regular. Opaque rules are only allowed if they're one of
+     * the given character classes, and other rules are only allowed if they are
+     * regular Token rules themselves.
+     */
+    bool compile(
+        const QString& name,
+        const QHash<QString, Node<TokenType, QString>>& rules,
+        const QHash<QString, CharClass>& classes
+    );
+
+    bool compiled() const
+    {
+        return !_accepting.empty();
+    }
+
+    int states() const
+    {
+        return _accepting.size();
+    }
+
+    /**
+     * Matches the longest token at the cursor, replacing the text with the
+     * token's characters. The text is allocated once.
+     */
+    bool operator()(Cursor<QChar>& iter, QString& text) const;
+};
+
+} // namespace grammar
+} // namespace sprout
+
+#endif // SPROUT_GRAMMAR_TOKENDFA_HEADER
+
+// vim: set ts=4 sw=4 :
@@ -0,0 +1,545 @@
+#include <grammar/pass/Analysis.hpp>
+
+#include <algorithm>
+
+namespace sprout {
+namespace grammar {
+namespace pass {
+
+namespace {
+
+QString tokenName(const GNode& node)
+{
+    if (node.type() == TokenType::Literal) {
+        return "'" + node.value() + "'";
+    }
+    return node.value();
+}
+
+QString showChild(const GNode& node)
+{
+    switch (node.type()) {
+        case TokenType::Sequence:
+        case TokenType::Alternative:
+            if (node.size() > 1) {
+                return "(" + Analysis::show(node) + ")";
+            }
+        default:
+            return Analysis::show(node);
+    }
+}
+
+QString firstToken(const QSet<QString>& tokens)
+{
+    QStringList sorted = tokens.toList();
+    std::sort(sorted.begin(), sorted.end());
+    return sorted.isEmpty() ? QString() : sorted.first();
+}
+
+} // namespace anonymous
+
+QString Hazard::describe() const
+{
+    QString message;
+    switch (kind) {
+        case HazardKind::NullableRepetition:
+            message = "the repeated rule can match nothing, so it repeats without reading anything";
+            break;
+        case HazardKind::NullableSeparator:
+            message = "the separator can match nothing, so items are retried without one";
+            break;
+        case HazardKind::OverlappingAlternatives:
+            message = "both alternatives can begin with " + token + ", so the second reparses what the first read";
+            break;
+        case HazardKind::GreedyRepetition:
+            message = "the repetition can read " + token + ", which can also follow it";
+            break;
+    }
+
+    QStringList shown;
+    for (auto& path : paths) {
+        shown << path.join(" -> ");
+    }
+
+    QString description = rule + ": " + construct + ": " + message;
+    if (!shown.isEmpty()) {
+        description += " (" + shown.join("; ") + ")";
+    }
+    return description;
+}
+
+QString Analysis::show(const GNode& node)
+{
+    switch (node.type()) {
+        case TokenType::Literal:
+            return "'" + node.value() + "'";
+        case TokenType::Name:
+        case TokenType::Opaque:
+            return node.value();
+        case TokenType::Sequence:
+        case TokenType::Alternative:
+        {
+            QStringList children;
+            for (auto& child : node.children()) {
+                children << (node.type() == TokenType::Sequence ? showChild(child) : show(child));
+            }
+            return children.join(node.type() == TokenType::Sequence ? " " : " | ");
+        }
+        case TokenType::ZeroOrMore:
+            return showChild(node[0]) + "*";
+        case TokenType::OneOrMore:
+            return showChild(node[0]) + "+";
+        case TokenType::Optional:
+            return showChild(node[0]) + "?";
+        case TokenType::Discard:
+            return "-" + showChild(node[0]);
+        case TokenType::Cut:
+            return "^";
+        case TokenType::Join:
+            return "{" + showChild(node[0]) + " " + showChild(node[1]) + "}";
+        case TokenType::Recursive:
+            return showChild(node[0]) + " " + showChild(node[1]) + "+";
+        case TokenType::Rule:
+        case TokenType::GroupRule:
+        case TokenType::TokenRule:
+            return show(node[0]);
+        default:
+            return QString();
+    }
+}
+
+bool Analysis::isToken(const GNode& node) const
+{
+    switch (node.type()) {
+        case TokenType::Literal:
+        case TokenType::Opaque:
+            return true;
+        case TokenType::Name:
+            return !_rules->contains(node.value()) || (*_rules)[node.value()].type() == TokenType::TokenRule;
+        default:
+            return false;
+    }
+}
+
+bool Analysis::nullable(const GNode& node) const
+{
+    switch (node.type()) {
+        case TokenType::Literal:
+            return node.value().isEmpty();
+        case TokenType::Name:
+            return _nullable.value(node.value());
+        case TokenType::Sequence:
+            for (auto& child : node.children()) {
+                if (!nullable(child)) {
+                    return false;
+                }
+            }
+            return true;
+        case TokenType::Alternative:
+            for (auto& child : node.children()) {
+                if (nullable(child)) {
+                    return true;
+                }
+            }
+            return false;
+        case TokenType::ZeroOrMore:
+        case TokenType::Optional:
+        case TokenType::Cut:
+            return true;
+        case TokenType::OneOrMore:
+        case TokenType::Discard:
+        case TokenType::Join:
+        case TokenType::Rule:
+        case TokenType::GroupRule:
+        case TokenType::TokenRule:
+            return nullable(node[0]);
+        case TokenType::Recursive:
+            return nullable(node[0]) && nullable(node[1]);
+        default:
+            return false;
+    }
+}
+
+QSet<QString> Analysis::first(const GNode& node) const
+{
+    QSet<QString> tokens;
+    if (isToken(node)) {
+        if (node.type() != TokenType::Literal || !node.value().isEmpty()) {
+            tokens << tokenName(node);
+        }
+        return tokens;
+    }
+    switch (node.type()) {
+        case TokenType::Name:
+            return _first.value(node.value());
+        case TokenType::Sequence:
+            for (auto& child : node.children()) {
+                tokens.unite(first(child));
+                if (!nullable(child)) {
+                    break;
+                }
+            }
+            return tokens;
+        case TokenType::Alternative:
+            for (auto& child : node.children()) {
+                tokens.unite(first(child));
+            }
+            return tokens;
+        case TokenType::Join:
+        case TokenType::Recursive:
+            tokens = first(node[0]);
+            if (nullable(node[0])) {
+                tokens.unite(first(node[1]));
+            }
+            return tokens;
+        case TokenType::ZeroOrMore:
+        case TokenType::OneOrMore:
+        case TokenType::Optional:
+        case TokenType::Discard:
+        case TokenType::Rule:
+        case TokenType::GroupRule:
+        case TokenType::TokenRule:
+            return first(node[0]);
+        default:
+            return tokens;
+    }
+}
+
+QSet<QString> Analysis::followContent(const GNode& join, const QSet<QString>& follow) const
+{
+    QSet<QString> tokens = first(join[1]).unite(follow);
+    if (nullable(join[1])) {
+        tokens.unite(first(join[0]));
+    }
+    return tokens;
+}
+
+QSet<QString> Analysis::followSeparator(const GNode& join, const QSet<QString>& follow) const
+{
+    QSet<QString> tokens = first(join[0]);
+    if (nullable(join[0])) {
+        tokens.unite(follow);
+    }
+    return tokens;
+}
+
+bool Analysis::addFollow(const GNode& node, const QSet<QString>& follow)
+{
+    switch (node.type()) {
+        case TokenType::Name:
+        {
+            if (!_rules->contains(node.value())) {
+                return false;
+            }
+            QSet<QString>& target = _follow[node.value()];
+            const int size = target.size();
+            target.unite(follow);
+            return target.size() != size;
+        }
+        case TokenType::Sequence:
+        {
+            bool changed = false;
+            QSet<QString> rest = follow;
+            for (int i = node.size() - 1; i >= 0; --i) {
+                const GNode& child = node[i];
+                changed = addFollow(child, rest) || changed;
+                if (nullable(child)) {
+                    rest.unite(first(child));
+                } else {
+                    rest = first(child);
+                }
+            }
+            return changed;
+        }
+        case TokenType::Alternative:
+        {
+            bool changed = false;
+            for (auto& child : node.children()) {
+                changed = addFollow(child, follow) || changed;
+            }
+            return changed;
+        }
+        case TokenType::ZeroOrMore:
+        case TokenType::OneOrMore:
+            return addFollow(node[0], first(node[0]).unite(follow));
+        case TokenType::Optional:
+        case TokenType::Discard:
+            return addFollow(node[0], follow);
+        case TokenType::Join:
+        {
+            const bool changed = addFollow(node[0], followContent(node, follow));
+            return addFollow(node[1], followSeparator(node, follow)) || changed;
+        }
+        case TokenType::Recursive:
+        {
+            const bool changed = addFollow(node[0], first(node[1]));
+            return addFollow(node[1], first(node[1]).unite(follow)) || changed;
+        }
+        default:
+            return false;
+    }
+}
+
+bool Analysis::nullablePath(const GNode& node, QStringList& path, QSet<QString>& visiting) const
+{
+    if (!nullable(node)) {
+        return false;
+    }
+    switch (node.type()) {
+        case TokenType::Name:
+        {
+            const QString& name = node.value();
+            if (visiting.contains(name)) {
+                return false;
+            }
+            visiting << name;
+            path << name;
+            const bool found = nullablePath((*_rules)[name], path, visiting);
+            if (!found) {
+                path.removeLast();
+            }
+            visiting.remove(name);
+            return found;
+        }
+        case TokenType::Sequence:
+            for (auto& child : node.children()) {
+                if (!nullablePath(child, path, visiting)) {
+                    return false;
+                }
+            }
+            return true;
+        case TokenType::Alternative:
+            for (auto& child : node.children()) {
+                if (nullablePath(child, path, visiting)) {
+                    return true;
+                }
+            }
+            return false;
+        case TokenType::Recursive:
+            return nullablePath(node[0], path, visiting) && nullablePath(node[1], path, visiting);
+        case TokenType::OneOrMore:
+        case TokenType::Discard:
+        case TokenType::Join:
+        case TokenType::Rule:
+        case TokenType::GroupRule:
+        case TokenType::TokenRule:
+            return nullablePath(node[0], path, visiting);
+        case TokenType::Cut:
+            return true;
+        default:
+            path << show(node);
+            return true;
+    }
+}
+
+bool Analysis::firstPath(const GNode& node, const QString& token, QStringList& path, QSet<QString>& visiting) const
+{
+    if (isToken(node)) {
+        if (tokenName(node) != token) {
+            return false;
+        }
+        path << token;
+        return true;
+    }
+    switch (node.type()) {
+        case TokenType::Name:
+        {
+            const QString& name = node.value();
+            if (visiting.contains(name) || !_first.value(name).contains(token)) {
+                return false;
+            }
+            visiting << name;
+            path << name;
+            const bool found = firstPath((*_rules)[name], token, path, visiting);
+            if (!found) {
+                path.removeLast();
+            }
+            visiting.remove(name);
+            return found;
+        }
+        case TokenType::Sequence:
+            for (auto& child : node.children()) {
+                if (firstPath(child, token, path, visiting)) {
+                    return true;
+                }
+                if (!nullable(child)) {
+                    return false;
+                }
+            }
+            return false;
+        case TokenType::Alternative:
+            for (auto& child : node.children()) {
+                if (firstPath(child, token, path, visiting)) {
+                    return true;
+                }
+            }
+            return false;
+        case TokenType::Join:
+        case TokenType::Recursive:
+            return firstPath(node[0], token, path, visiting) ||
+                (nullable(node[0]) && firstPath(node[1], token, path, visiting));
+        case TokenType::ZeroOrMore:
+        case TokenType::OneOrMore:
+        case TokenType::Optional:
+        case TokenType::Discard:
+        case TokenType::Rule:
+        case TokenType::GroupRule:
+        case TokenType::TokenRule:
+            return firstPath(node[0], token, path, visiting);
+        default:
+            return false;
+    }
+}
+
+void Analysis::addHazard(const HazardKind kind, const QString& rule, const GNode& node, const QString& token, const QList<QStringList>& paths)
+{
+    Hazard hazard;
+    hazard.kind = kind;
+    hazard.rule = rule;
+    hazard.construct = show(node);
+    hazard.token = token;
+    hazard.paths = paths;
+    _hazards << hazard;
+}
+
+void Analysis::findHazards(const QString& rule, const GNode& node, const QSet<QString>& follow)
+{
+    switch (node.type()) {
+        case TokenType::Sequence:
+        {
+            QSet<QString> rest = follow;
+            for (int i = node.size() - 1; i >= 0; --i) {
+                const GNode& child = node[i];
+                findHazards(rule, child, rest);
+                if (nullable(child)) {
+                    rest.unite(first(child));
+                } else {
+                    rest = first(child);
+                }
+            }
+            return;
+        }
+        case TokenType::Alternative:
+        {
+            for (unsigned i = 0; i < node.size(); ++i) {
+                findHazards(rule, node[i], follow);
+                for (unsigned j = i + 1; j < node.size(); ++j) {
+                    QSet<QString> shared = first(node[i]);
+                    shared.intersect(first(node[j]));
+                    if (shared.isEmpty()) {
+                        continue;
+                    }
+                    const QString token = firstToken(shared);
+                    QList<QStringList> paths;
+                    for (auto index : { i, j }) {
+                        QStringList path;
+                        QSet<QString> visiting;
+                        firstPath(node[index], token, path, visiting);
+                        paths << path;
+                    }
+                    GNode pair(TokenType::Alternative);
+                    pair.insert(node[i]);
+                    pair.insert(node[j]);
+                    addHazard(HazardKind::OverlappingAlternatives, rule, pair, token, paths);
+                }
+            }
+            return;
+        }
+        case TokenType::ZeroOrMore:
+        case TokenType::OneOrMore:
+        {
+            const GNode& child = node[0];
+            if (nullable(child)) {
+                QStringList path;
+                QSet<QString> visiting;
+                nullablePath(child, path, visiting);
+                addHazard(HazardKind::NullableRepetition, rule, node, QString(), { path });
+                return;
+            }
+            QSet<QString> shared = first(child);
+            shared.intersect(follow);
+            if (!shared.isEmpty()) {
+                const QString token = firstToken(shared);
+                QStringList path;
+                QSet<QString> visiting;
+                firstPath(child, token, path, visiting);
+                addHazard(HazardKind::GreedyRepetition, rule, node, token, { path });
+            }
+            findHazards(rule, child, first(child).unite(follow));
+            return;
+        }
+        case TokenType::Join:
+        {
+            if (nullable(node[1])) {
+                QStringList path;
+                QSet<QString> visiting;
+                nullablePath(node[1], path, visiting);
+                addHazard(HazardKind::NullableSeparator, rule, node, QString(), { path });
+            }
+            findHazards(rule, node[0], followContent(node, follow));
+            findHazards(rule, node[1], followSeparator(node, follow));
+            return;
+        }
+        case TokenType::Recursive:
+            findHazards(rule, node[0], first(node[1]));
+            findHazards(rule, node[1], first(node[1]).unite(follow));
+            return;
+        case TokenType::Optional:
+        case TokenType::Discard:
+            // An optional only reads what could follow it once, which is ordinary
+            // ordered choice rather than a hazard
+            findHazards(rule, node[0], follow);
+            return;
+        default:
+            return;
+    }
+}
+
+void Analysis::analyze(const QHash<QString, GNode>& rules)
+{
+    _rules = &rules;
+    _nullable.clear();
+    _first.clear();
+    _follow.clear();
+    _hazards.clear();
+
+    // Every set only grows, so iterate until none of them change
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto iter = rules.begin(); iter != rules.end(); ++iter) {
+            const GNode& rule = iter.value();
+            const bool isNullable = nullable(rule);
+            if (isNullable != _nullable.value(iter.key())) {
+                _nullable[iter.key()] = isNullable;
+                changed = true;
+            }
+            QSet<QString> tokens = first(rule[0]);
+            if (tokens.size() != _first.value(iter.key()).size()) {
+                _first[iter.key()] = tokens;
+                changed = true;
+            }
+        }
+    }
+
+    changed = true;
+    while (changed) {
+        changed = false;
+        for (auto iter = rules.begin(); iter != rules.end(); ++iter) {
+            const QSet<QString> follow = _follow.value(iter.key());
+            changed = addFollow(iter.value()[0], follow) || changed;
+        }
+    }
+
+    QStringList names = rules.keys();
+    std::sort(names.begin(), names.end());
+    for (auto& name : names) {
+        findHazards(name, rules[name][0], _follow.value(name));
+    }
+}
+
+} // namespace pass
+} // namespace grammar
+} // namespace sprout
+
+// vim: set ts=4 sw=4 :
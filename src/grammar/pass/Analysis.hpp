@@ -0,0 +1,172 @@
+#ifndef SPROUT_GRAMMAR_PASS_ANALYSIS_HEADER
+#define SPROUT_GRAMMAR_PASS_ANALYSIS_HEADER
+
+#include "../Grammar.hpp"
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+namespace sprout {
+namespace grammar {
+namespace pass {
+
+enum class HazardKind {
+    /**
+     * A repetition over a rule that can match nothing, which repeats forever
+     * without reading anything.
+     */
+    NullableRepetition,
+
+    /**
+     * A join whose separator can match nothing, so every item is tried again
+     * after a separator that wasn't there.
+     */
+    NullableSeparator,
+
+    /**
+     * Alternatives that can begin with the same token, so a later one reparses
+     * whatever an earlier one read before it failed.
+     */
+    OverlappingAlternatives,
+
+    /**
+     * A repetition that can read a token that can also follow it. The
+     * repetition always takes it, so whatever follows fails and backtracks.
+     */
+    GreedyRepetition
+};
+
+/**
+ * \brief A construct in a grammar that's likely to make parsing super-linear.
+ */
+struct Hazard
+{
+    HazardKind kind;
+
+    /**
+     * The rule that contains the construct.
+     */
+    QString rule;
+
+    /**
+     * The construct, written as it would be in a grammar.
+     */
+    QString construct;
+
+    /**
+     * The token that's read ambiguously, if there is one.
+     */
+    QString token;
+
+    /**
+     * The paths through the grammar that cause the hazard, each from the
+     * construct down to the token, or to what matches nothing.
+     */
+    QList<QStringList> paths;
+
+    /**
+     * Describes the hazard, such as "statement: call | assign: both
+     * alternatives can begin with name (call -> prefix -> name; assign -> name)".
+     */
+    QString describe() const;
+};
+
+/**
+ * \brief Finds constructs in a grammar that cause pathological backtracking.
+ *
+ * The pass computes which rules can match nothing, and the FIRST and FOLLOW
+ * sets of every rule. Tokens are literals, Token rules, and opaque rules, so
+ * the sets are the same whether the grammar is built over characters or
+ * lexemes. Rules that can't be resolved are treated as tokens.
+ *
+ * The grammar isn't changed. It should be run after LeftRecursion, since
+ * left-recursive rules have no useful FIRST sets.
+ */
+class Analysis
+{
+    const QHash<QString, GNode>* _rules;
+
+    QHash<QString, bool> _nullable;
+    QHash<QString, QSet<QString>> _first;
+    QHash<QString, QSet<QString>> _follow;
+
+    QList<Hazard> _hazards;
+
+    bool isToken(const GNode& node) const;
+
+    bool nullable(const GNode& node) const;
+    QSet<QString> first(const GNode& node) const;
+    bool addFollow(const GNode& node, const QSet<QString>& follow);
+
+    /**
+     * Return what can follow the items of the join, and what can follow its
+     * separators, where the join itself is followed by follow.
+     */
+    QSet<QString> followContent(const GNode& join, const QSet<QString>& follow) const;
+    QSet<QString> followSeparator(const GNode& join, const QSet<QString>& follow) const;
+
+    bool nullablePath(const GNode& node, QStringList& path, QSet<QString>& visiting) const;
+    bool firstPath(const GNode& node, const QString& token, QStringList& path, QSet<QString>& visiting) const;
+
+    void findHazards(const QString& rule, const GNode& node, const QSet<QString>& follow);
+    void addHazard(const HazardKind kind, const QString& rule, const GNode& node, const QString& token, const QList<QStringList>& paths);
+
+public:
+    Analysis() :
+        _rules(nullptr)
+    {
+    }
+
+    void analyze(const QHash<QString, GNode>& rules);
+
+    template <class Type, class Value>
+    void operator()(Grammar<Type, Value>& grammar)
+    {
+        analyze(grammar.parsedRules());
+    }
+
+    /**
+     * Returns whether the named rule can match without reading anything.
+     */
+    bool nullable(const QString& rule) const
+    {
+        return _nullable.value(rule);
+    }
+
+    /**
+     * Returns the tokens that the named rule can begin with.
+     */
+    QSet<QString> first(const QString& rule) const
+    {
+        return _first.value(rule);
+    }
+
+    /**
+     * Returns the tokens that can follow the named rule wherever it's used.
+     */
+    QSet<QString> follow(const QString& rule) const
+    {
+        return _follow.value(rule);
+    }
+
+    const QList<Hazard>& hazards() const
+    {
+        return _hazards;
+    }
+
+    /**
+     * Writes the node as it would be written in a grammar.
+     */
+    static QString show(const GNode& node);
+};
+
+} // namespace pass
+} // namespace grammar
+} // namespace sprout
+
+#endif // SPROUT_GRAMMAR_PASS_ANALYSIS_HEADER
+
+// vim: set ts=4 sw=4 :
@@ -62,6 +62,7 @@ bool LeftRecursion::hasRecursions(const QString& name, GNode& node, QHash<QStrin
             return false;
         case TokenType::Opaque:
         case TokenType::Literal:
+        case TokenType::Cut:
             return false;
         case TokenType::Rule:
         case TokenType::GroupRule:
@@ -2,6 +2,7 @@
 #include <grammar/Node.hpp>
 #include <grammar/pass/Flatten.hpp>
 #include <grammar/pass/LeftRecursion.hpp>
+#include <grammar/pass/Analysis.hpp>
 
 #include <rule/rules.hpp>
 #include <rule/Literal.hpp>
@@ -16,6 +17,7 @@
 #include <rule/Join.hpp>
 #include <rule/Log.hpp>
 #include <rule/Recursive.hpp>
+#include <rule/Profile.hpp>
 
 #include <StreamIterator.hpp>
 
@@ -42,6 +44,8 @@ std::ostream& operator<<(std::ostream& stream, const QString& value)
     return stream;
 }
 
+std::shared_ptr<rule::Profiler> profiler;
+
 template <class Node>
 void parseLine(rule::Proxy<QChar, Node> parser, QString& line)
 {
@@ -59,8 +63,19 @@ void parseLine(rule::Proxy<QChar, Node> parser, QString& line)
         for (auto node : nodes) {
             std::cout << node.dump() << std::endl;
         }
-    } else {
-        std::cout << "Failed to parse provided line. :(\n";
+    }
+    if (!parseSuccessful || cursor) {
+        auto& failure = cursor.failure();
+        if (failure) {
+            std::cout << "Failed to parse provided line at " << failure.describe(line) << std::endl;
+        } else {
+            std::cout << "Failed to parse provided line. :(\n";
+        }
+    }
+
+    if (profiler) {
+        profiler->report(std::cout);
+        profiler->clear();
     }
 }
 
@@ -72,10 +87,25 @@ int main(int argc, char* argv[])
     Grammar<QString, QString> grammar;
     typedef Node<QString, QString> PNode;
 
-    if (argc <= 1) {
+    bool reportHazards = false;
+
+    int argi = 1;
+    for (; argc > argi && std::string(argv[argi]).substr(0, 2) == "--"; ++argi) {
+        std::string flag(argv[argi]);
+        if (flag == "--profile") {
+            profiler.reset(new rule::Profiler);
+            grammar.setProfiler(profiler);
+        } else if (flag == "--hazards") {
+            reportHazards = true;
+        } else {
+            throw std::logic_error("Unknown option: " + flag);
+        }
+    }
+
+    if (argc <= argi) {
         throw std::logic_error("A grammar must be provided");
     } else {
-        auto filename = argv[1];
+        auto filename = argv[argi++];
         QFile file(filename);
         if (!file.open(QFile::ReadOnly)) {
             std::stringstream str;
@@ -100,6 +130,15 @@ int main(int argc, char* argv[])
     }
     pass::LeftRecursion()(grammar);
     flattenPass(grammar);
+
+    if (reportHazards) {
+        pass::Analysis analysis;
+        analysis(grammar);
+        for (auto& hazard : analysis.hazards()) {
+            std::cerr << "warning: " << hazard.describe().toUtf8().constData() << std::endl;
+        }
+    }
+
     grammar.build();
 
     auto lineComment = proxySequence<QChar, PNode>(
@@ -122,8 +161,8 @@ int main(int argc, char* argv[])
         grammar["main"]
     );
 
-    if (argc > 2) {
-        for (int i = 2; i < argc; ++i) {
+    if (argc > argi) {
+        for (int i = argi; i < argc; ++i) {
             QFile file(argv[i]);
             if (file.open(QFile::ReadOnly)) {
                 QTextStream stream(&file);
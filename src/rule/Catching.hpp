@@ -14,6 +14,10 @@ namespace rule {
 
 /**
  * \brief A rule that catches a specified exception, using it to indicate failure.
+ *
+ * Unwinding is far slower than returning false, so rules that fail often,
+ * such as the choices of an alternative, should read with Cursor::read() and
+ * fail with Cursor::fail() instead.
  */
 template <
     class Rule,
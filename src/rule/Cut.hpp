@@ -0,0 +1,61 @@
+#ifndef SPROUT_RULE_CUT_HEADER
+#define SPROUT_RULE_CUT_HEADER
+
+#include "RuleTraits.hpp"
+
+#include "../Cursor.hpp"
+#include "../Result.hpp"
+
+namespace sprout {
+namespace rule {
+
+/**
+ * \brief A rule that commits to the choice that it's matched in.
+ *
+ * Cut always matches, without reading anything. If the choice fails after
+ * the cut, the choice point that was trying it fails too, rather than trying
+ * its other choices. Choice points are the ones that run their choices with
+ * choose(), and the innermost one that's running is committed, so a cut in a
+ * named rule commits the alternative that referred to it.
+ *
+ * Choice points that don't use choose() ignore cuts, so they cost nothing in
+ * grammars without them.
+ */
+template <class Input, class Token>
+class Cut : public RuleTraits<Input, Token>
+{
+public:
+    bool operator()(Cursor<Input>& iter, Result<Token>& result) const
+    {
+        iter.cut();
+        return true;
+    }
+};
+
+template <class Input, class Token>
+Cut<Input, Token> cut()
+{
+    return Cut<Input, Token>();
+}
+
+/**
+ * Runs the rule as one choice of a choice point, returning whether it matched.
+ * If it failed after a cut, committed is set, and the choice point must fail
+ * rather than try anything else. Cuts never escape the choice point.
+ */
+template <class Rule, class Input, class Token>
+bool choose(const Rule& rule, Cursor<Input>& iter, Result<Token>& result, bool& committed)
+{
+    const bool outer = iter.setCut(false);
+    const bool matched = rule(iter, result);
+    committed = !matched && iter.isCut();
+    iter.setCut(outer);
+    return matched;
+}
+
+} // namespace rule
+} // namespace sprout
+
+#endif // SPROUT_RULE_CUT_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
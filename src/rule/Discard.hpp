@@ -29,18 +29,19 @@ class Discard : public RuleTraits<Input, Token>
 {
     const Rule _rule;
 
-    mutable Result<Token> trash;
-
 public:
     Discard(const Rule& rule) :
         _rule(rule)
     {
-        trash.suppress();
     }
 
     template <class Ignored>
     bool operator()(Cursor<Input>& iter, Result<Ignored>& result) const
     {
+        // Suppressed results never allocate, so this is cheap to make per match,
+        // and leaves the rule safe to use from several threads at once
+        Result<Token> trash;
+        trash.suppress();
         return _rule(iter, trash);
     }
 };
@@ -0,0 +1,67 @@
+#ifndef SPROUT_RULE_EXPECT_HEADER
+#define SPROUT_RULE_EXPECT_HEADER
+
+#include "RuleTraits.hpp"
+
+#include "../Cursor.hpp"
+#include "../Result.hpp"
+#include "../Failure.hpp"
+
+#include <string>
+
+namespace sprout {
+namespace rule {
+
+/**
+ * \brief A rule that records what it expected when its subrule fails.
+ *
+ * The expectation is recorded in the cursor's Failure at the position the
+ * subrule was tried from, so a failed parse can report what it wanted at the
+ * farthest position it reached without being run again.
+ */
+template <
+    class Rule,
+    class Input = typename Rule::input_type,
+    class Token = typename Rule::token_type
+>
+class Expect : public RuleTraits<Input, Token>
+{
+    const Rule _rule;
+    const std::string _expected;
+
+public:
+    Expect(const Rule& rule, const std::string& expected) :
+        _rule(rule),
+        _expected(expected)
+    {
+    }
+
+    bool operator()(Cursor<Input>& iter, Result<Token>& result) const
+    {
+        const int start = iter.pos();
+        if (_rule(iter, result)) {
+            return true;
+        }
+        iter.failure().expect(start, _expected);
+        return false;
+    }
+};
+
+template <class Rule>
+Expect<Rule> expect(const Rule& rule, const std::string& expected)
+{
+    return Expect<Rule>(rule, expected);
+}
+
+template <class Input, class Token, class Rule>
+Expect<Rule, Input, Token> expect(const Rule& rule, const std::string& expected)
+{
+    return Expect<Rule, Input, Token>(rule, expected);
+}
+
+} // namespace rule
+} // namespace sprout
+
+#endif // SPROUT_RULE_EXPECT_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
@@ -0,0 +1,72 @@
+#ifndef SPROUT_RULE_LIMIT_HEADER
+#define SPROUT_RULE_LIMIT_HEADER
+
+#include "RuleTraits.hpp"
+
+#include "../Cursor.hpp"
+#include "../Result.hpp"
+#include "../Budget.hpp"
+
+namespace sprout {
+namespace rule {
+
+/**
+ * \brief A rule that counts its subrule against the cursor's Budget.
+ *
+ * The subrule fails without running if the budget is exceeded. Cursors
+ * without a budget only cost a pointer comparison.
+ */
+template <
+    class Rule,
+    class Input = typename Rule::input_type,
+    class Token = typename Rule::token_type
+>
+class Limit : public RuleTraits<Input, Token>
+{
+    const Rule _rule;
+
+public:
+    Limit(const Rule& rule) :
+        _rule(rule)
+    {
+    }
+
+    bool operator()(Cursor<Input>& iter, Result<Token>& result) const
+    {
+        Budget* budget = iter.budget();
+        if (!budget) {
+            return _rule(iter, result);
+        }
+        if (!budget->enter()) {
+            return false;
+        }
+        bool rv;
+        try {
+            rv = _rule(iter, result);
+        } catch (...) {
+            budget->exit();
+            throw;
+        }
+        budget->exit();
+        return rv;
+    }
+};
+
+template <class Rule>
+Limit<Rule> limit(const Rule& rule)
+{
+    return Limit<Rule>(rule);
+}
+
+template <class Input, class Token, class Rule>
+Limit<Rule, Input, Token> limit(const Rule& rule)
+{
+    return Limit<Rule, Input, Token>(rule);
+}
+
+} // namespace rule
+} // namespace sprout
+
+#endif // SPROUT_RULE_LIMIT_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
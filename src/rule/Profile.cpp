@@ -0,0 +1,63 @@
+#include <rule/Profile.hpp>
+
+#include <algorithm>
+#include <iomanip>
+
+namespace sprout {
+namespace rule {
+
+std::vector<RuleStats> Profiler::sorted() const
+{
+    std::vector<RuleStats> rv;
+    for (auto& entry : _stats) {
+        if (entry.second.invocations > 0) {
+            rv.push_back(entry.second);
+        }
+    }
+    std::sort(rv.begin(), rv.end(), [](const RuleStats& a, const RuleStats& b) {
+        if (a.selfTime != b.selfTime) {
+            return a.selfTime > b.selfTime;
+        }
+        return a.name < b.name;
+    });
+    return rv;
+}
+
+void Profiler::report(std::ostream& stream) const
+{
+    auto toMs = [](const long long ns) {
+        return ns / 1e6;
+    };
+
+    stream << std::left << std::setw(24) << "rule"
+        << std::right
+        << std::setw(10) << "calls"
+        << std::setw(10) << "matched"
+        << std::setw(10) << "failed"
+        << std::setw(12) << "consumed"
+        << std::setw(12) << "rewound"
+        << std::setw(12) << "self ms"
+        << std::setw(12) << "total ms"
+        << "\n";
+
+    auto flags = stream.flags();
+    stream << std::fixed << std::setprecision(3);
+    for (auto& stats : sorted()) {
+        stream << std::left << std::setw(24) << stats.name
+            << std::right
+            << std::setw(10) << stats.invocations
+            << std::setw(10) << stats.successes
+            << std::setw(10) << stats.failures
+            << std::setw(12) << stats.consumed
+            << std::setw(12) << stats.rewound
+            << std::setw(12) << toMs(stats.selfTime)
+            << std::setw(12) << toMs(stats.totalTime)
+            << "\n";
+    }
+    stream.flags(flags);
+}
+
+} // namespace rule
+} // namespace sprout
+
+// vim: set ts=4 sw=4 :
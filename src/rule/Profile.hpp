@@ -0,0 +1,218 @@
+#ifndef SPROUT_RULE_PROFILE_HEADER
+#define SPROUT_RULE_PROFILE_HEADER
+
+#include "RuleTraits.hpp"
+
+#include "../Cursor.hpp"
+#include "../Result.hpp"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <iostream>
+#include <unordered_map>
+
+namespace sprout {
+namespace rule {
+
+/**
+ * Statistics that are collected for a single named rule.
+ *
+ * Times are in nanoseconds. The total time of a rule includes the time spent
+ * in all of its subrules, while the self time excludes the time spent in other
+ * profiled rules. Recursive invocations of a rule are only counted once towards
+ * its total time.
+ */
+struct RuleStats
+{
+    std::string name;
+
+    long invocations;
+    long successes;
+    long failures;
+
+    /**
+     * Input consumed by successful matches.
+     */
+    long consumed;
+
+    /**
+     * Input that was matched by subrules of failed invocations, and so was
+     * thrown away when this rule rewound the cursor.
+     */
+    long rewound;
+
+    long long totalTime;
+    long long selfTime;
+
+    int active;
+
+    RuleStats(const std::string& name = "") :
+        name(name),
+        invocations(0),
+        successes(0),
+        failures(0),
+        consumed(0),
+        rewound(0),
+        totalTime(0),
+        selfTime(0),
+        active(0)
+    {
+    }
+};
+
+/**
+ * \brief Collects RuleStats for all rules that are wrapped by a Profile.
+ *
+ * A single profiler is shared by every profiled rule of a parser, since it
+ * tracks which rule is currently running in order to compute self times and
+ * rewound input. It is therefore not safe to run parses concurrently with the
+ * same profiler.
+ */
+class Profiler
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Frame
+    {
+        RuleStats* stats;
+        Clock::time_point started;
+        long long childTime;
+        int start;
+        int farthest;
+    };
+
+    std::unordered_map<std::string, RuleStats> _stats;
+    std::vector<Frame> _frames;
+
+public:
+    /**
+     * Returns the statistics for the named rule. The returned reference remains
+     * valid for the life of this profiler.
+     */
+    RuleStats& stats(const std::string& name)
+    {
+        auto iter = _stats.find(name);
+        if (iter == _stats.end()) {
+            iter = _stats.insert(std::make_pair(name, RuleStats(name))).first;
+        }
+        return iter->second;
+    }
+
+    void enter(RuleStats& stats, const int pos)
+    {
+        ++stats.invocations;
+        ++stats.active;
+        _frames.push_back(Frame { &stats, Clock::now(), 0, pos, pos });
+    }
+
+    void exit(const bool matched, const int pos)
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - _frames.back().started
+        ).count();
+
+        Frame frame = _frames.back();
+        _frames.pop_back();
+
+        RuleStats& stats = *frame.stats;
+        --stats.active;
+
+        if (matched) {
+            ++stats.successes;
+            stats.consumed += pos - frame.start;
+            if (pos > frame.farthest) {
+                frame.farthest = pos;
+            }
+        } else {
+            ++stats.failures;
+            stats.rewound += frame.farthest - frame.start;
+        }
+
+        if (stats.active == 0) {
+            stats.totalTime += elapsed;
+        }
+        stats.selfTime += elapsed - frame.childTime;
+
+        if (!_frames.empty()) {
+            Frame& parent = _frames.back();
+            parent.childTime += elapsed;
+            if (frame.farthest > parent.farthest) {
+                parent.farthest = frame.farthest;
+            }
+        }
+    }
+
+    /**
+     * Returns the collected statistics, ordered by descending self time.
+     */
+    std::vector<RuleStats> sorted() const;
+
+    void report(std::ostream& stream) const;
+
+    void clear()
+    {
+        for (auto& entry : _stats) {
+            RuleStats& stats = entry.second;
+            stats = RuleStats(stats.name);
+        }
+        _frames.clear();
+    }
+};
+
+/**
+ * \brief A rule that records invocation statistics of its subrule.
+ */
+template <
+    class Rule,
+    class Input = typename Rule::input_type,
+    class Token = typename Rule::token_type
+>
+class Profile : public RuleTraits<Input, Token>
+{
+    const std::shared_ptr<Profiler> _profiler;
+    RuleStats* const _stats;
+    const Rule _rule;
+
+public:
+    Profile(const std::string& name, const std::shared_ptr<Profiler>& profiler, const Rule& rule) :
+        _profiler(profiler),
+        _stats(&profiler->stats(name)),
+        _rule(rule)
+    {
+    }
+
+    bool operator()(Cursor<Input>& iter, Result<Token>& result) const
+    {
+        _profiler->enter(*_stats, iter.pos());
+        bool rv;
+        try {
+            rv = _rule(iter, result);
+        } catch (...) {
+            _profiler->exit(false, iter.pos());
+            throw;
+        }
+        _profiler->exit(rv, iter.pos());
+        return rv;
+    }
+};
+
+template <class Rule>
+Profile<Rule> profile(const std::string& name, const std::shared_ptr<Profiler>& profiler, const Rule& rule)
+{
+    return Profile<Rule>(name, profiler, rule);
+}
+
+template <class Input, class Token, class Rule>
+Profile<Rule, Input, Token> profile(const std::string& name, const std::shared_ptr<Profiler>& profiler, const Rule& rule)
+{
+    return Profile<Rule, Input, Token>(name, profiler, rule);
+}
+
+} // namespace rule
+} // namespace sprout
+
+#endif // SPROUT_RULE_PROFILE_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
@@ -0,0 +1,125 @@
+#ifndef SPROUT_RULE_SKIP_HEADER
+#define SPROUT_RULE_SKIP_HEADER
+
+#include "RuleTraits.hpp"
+#include "Proxy.hpp"
+
+#include "../Cursor.hpp"
+#include "../Result.hpp"
+
+#include <memory>
+
+namespace sprout {
+namespace rule {
+
+/**
+ * \brief Skips trivia, such as whitespace and comments, between tokens.
+ *
+ * The trivia rule's results are always discarded. The cursor's data remembers
+ * every run of trivia that was skipped, so skipping again from the same
+ * position, as happens whenever a parser backtracks over tokens, moves the
+ * cursor without running the trivia rule. Runs are forgotten once the data
+ * before them is discarded.
+ *
+ * Trivia that reaches the end of what the data holds isn't remembered, since
+ * more of it could arrive later.
+ */
+template <class Input, class Token>
+class Skipper
+{
+    std::shared_ptr<const Proxy<Input, Token>> _trivia;
+
+public:
+    Skipper() = default;
+
+    Skipper(const Proxy<Input, Token>& trivia) :
+        _trivia(std::make_shared<const Proxy<Input, Token>>(trivia))
+    {
+    }
+
+    void operator()(Cursor<Input>& iter) const
+    {
+        if (!_trivia) {
+            return;
+        }
+
+        const int from = iter.pos();
+        const int to = iter.skipped(_trivia.get());
+        if (to >= 0) {
+            iter += to - from;
+            return;
+        }
+
+        auto skipped = iter;
+        Result<Token> trash;
+        trash.suppress();
+        if ((*_trivia)(skipped, trash)) {
+            iter = skipped;
+        }
+        if (iter.pos() < iter.head()) {
+            iter.setSkipped(_trivia.get(), from);
+        }
+    }
+
+    explicit operator bool() const
+    {
+        return static_cast<bool>(_trivia);
+    }
+};
+
+/**
+ * \brief A rule that skips trivia after its subrule matches.
+ *
+ * This is how a skipper is applied to the tokens of a grammar, so that trivia
+ * is skipped once between each pair of tokens rather than after every element
+ * of every sequence. Where the token ended is recorded in the cursor, so the
+ * rules that contain it can find their end without their trailing trivia.
+ */
+template <
+    class Rule,
+    class Trivia,
+    class Input = typename Rule::input_type,
+    class Token = typename Rule::token_type
+>
+class Skip : public RuleTraits<Input, Token>
+{
+    const Rule _rule;
+    const Skipper<Input, Trivia> _skipper;
+
+public:
+    Skip(const Rule& rule, const Skipper<Input, Trivia>& skipper) :
+        _rule(rule),
+        _skipper(skipper)
+    {
+    }
+
+    bool operator()(Cursor<Input>& iter, Result<Token>& result) const
+    {
+        if (!_rule(iter, result)) {
+            return false;
+        }
+        const int end = iter.pos();
+        _skipper(iter);
+        iter.setTokenEnd(end);
+        return true;
+    }
+};
+
+template <class Rule, class Trivia>
+Skip<Rule, Trivia> skip(const Rule& rule, const Skipper<typename Rule::input_type, Trivia>& skipper)
+{
+    return Skip<Rule, Trivia>(rule, skipper);
+}
+
+template <class Input, class Token, class Rule, class Trivia>
+Skip<Rule, Trivia, Input, Token> skip(const Rule& rule, const Skipper<Input, Trivia>& skipper)
+{
+    return Skip<Rule, Trivia, Input, Token>(rule, skipper);
+}
+
+} // namespace rule
+} // namespace sprout
+
+#endif // SPROUT_RULE_SKIP_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
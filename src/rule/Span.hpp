@@ -0,0 +1,64 @@
+#ifndef SPROUT_RULE_SPAN_HEADER
+#define SPROUT_RULE_SPAN_HEADER
+
+#include "RuleTraits.hpp"
+
+#include "../Cursor.hpp"
+#include "../Result.hpp"
+
+namespace sprout {
+namespace rule {
+
+/**
+ * \brief A rule that sets the span of the tokens that its subrule produces.
+ *
+ * The span is the positions of the cursor before and after the subrule
+ * matched. Tokens must have a setSpan(start, end), as grammar::Node does.
+ */
+template <
+    class Rule,
+    class Input = typename Rule::input_type,
+    class Token = typename Rule::token_type
+>
+class Span : public RuleTraits<Input, Token>
+{
+    const Rule _rule;
+
+public:
+    Span(const Rule& rule) :
+        _rule(rule)
+    {
+    }
+
+    bool operator()(Cursor<Input>& iter, Result<Token>& result) const
+    {
+        const int start = iter.pos();
+        const int head = result.head();
+        if (!_rule(iter, result)) {
+            return false;
+        }
+        for (auto token = result.begin() + head; token != result.begin() + result.head(); ++token) {
+            token->setSpan(start, iter.pos());
+        }
+        return true;
+    }
+};
+
+template <class Rule>
+Span<Rule> span(const Rule& rule)
+{
+    return Span<Rule>(rule);
+}
+
+template <class Input, class Token, class Rule>
+Span<Rule, Input, Token> span(const Rule& rule)
+{
+    return Span<Rule, Input, Token>(rule);
+}
+
+} // namespace rule
+} // namespace sprout
+
+#endif // SPROUT_RULE_SPAN_HEADER
+
+// vim: set ft=cpp ts=4 sw=4 :
@@ -6,7 +6,10 @@
 
 #include "../Cursor.hpp"
 #include "../Result.hpp"
+#include "../StructuralIndex.hpp"
+#include "../CharClass.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 namespace sprout {
@@ -21,9 +24,18 @@ bool parseNeighborhood(Cursor<QChar>& orig, Result<Token>& results)
 
     const int NEIGHBOR_SIZE = 10;
 
-    iter -= NEIGHBOR_SIZE;
-    for (int i = 0; iter && i < NEIGHBOR_SIZE * 2 + 1; ++i) {
-        auto c = *iter++;
+    // Don't walk back past the start of the input
+    iter -= std::min(NEIGHBOR_SIZE, orig.pos());
+    for (int i = 0; i < NEIGHBOR_SIZE * 2 + 1; ++i, ++iter) {
+        QChar c;
+        const FailureReason reason = iter.read(c);
+        if (reason == FailureReason::OutOfRange) {
+            // Skip input that was already discarded
+            continue;
+        }
+        if (reason != FailureReason::None) {
+            break;
+        }
 
         int size = 1;
         if (c == '\n') {
@@ -37,7 +49,7 @@ bool parseNeighborhood(Cursor<QChar>& orig, Result<Token>& results)
         }
 
         for (int j = 0; j < size; ++j) {
-            indicator += i == NEIGHBOR_SIZE ? '^' : ' ';
+            indicator += iter.pos() == orig.pos() ? '^' : ' ';
         }
     }
     std::cout << str.toUtf8().constData() << std::endl;
@@ -54,10 +66,26 @@ auto neighborhood() -> decltype(wrap<QChar, Token>(&parseNeighborhood<Token>))
 template <class Token>
 bool parseWhitespace(Cursor<QChar>& iter, Result<Token>& result)
 {
+    auto index = iter.index();
+    if (index) {
+        // Only characters outside of ASCII need to be checked
+        int start = iter.pos();
+        int pos = start;
+        while (true) {
+            pos = index->next(StructuralIndex::NonSpace, pos);
+            if (pos >= index->size() || !index->string().at(pos).isSpace()) {
+                break;
+            }
+            ++pos;
+        }
+        iter += pos - start;
+        return pos > start;
+    }
+
+    auto& space = CharClass::space();
     bool found = false;
     while (iter) {
-        auto input = *iter;
-        if (!input.isSpace()) {
+        if (!space(*iter)) {
             break;
         }
         found = true;
@@ -85,16 +113,21 @@ bool parseFloating(Cursor<QChar>& input, Result<double>& result);
 template <class Input, class Token>
 bool EndRule(Cursor<Input>& iter, Result<Token>& result)
 {
-    return !iter;
+    if (iter) {
+        return iter.fail(FailureReason::Mismatch);
+    }
+    return true;
 }
 
 template <class Input, class Token>
 bool AnyRule(Cursor<Input>& iter, Result<Token>& result)
 {
-    if (!iter) {
-        return false;
+    Input value;
+    const FailureReason reason = iter.read(value);
+    if (reason != FailureReason::None) {
+        return iter.fail(reason);
     }
-    result << *iter;
+    result << value;
     ++iter;
     return true;
 }
@@ -5,11 +5,99 @@
 
 #include <QChar>
 #include <QString>
-#include <cmath>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
 
 namespace sprout {
 namespace rule {
 
+namespace {
+
+int hexValue(const QChar& c)
+{
+    const ushort code = c.unicode();
+    if (code >= '0' && code <= '9') {
+        return code - '0';
+    }
+    if (code >= 'a' && code <= 'f') {
+        return code - 'a' + 10;
+    }
+    if (code >= 'A' && code <= 'F') {
+        return code - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * Reads an escape sequence after its backslash, replacing the character with
+ * the escaped one. Returns false if the input ended first. Unknown escapes,
+ * including escaped quotes, leave the backslash in place of the escaped
+ * character, which preserves how strings have always been parsed rather than
+ * how they should be.
+ */
+bool parseEscape(Cursor<QChar>& iter, QChar& c)
+{
+    if (!iter) {
+        return false;
+    }
+
+    auto escape = *iter++;
+    if (escape == 'n') {
+        c = '\n';
+    } else if (escape == 'b') {
+        c = '\b';
+    } else if (escape == 'f') {
+        c = '\f';
+    } else if (escape == 'r') {
+        c = '\r';
+    } else if (escape == 't') {
+        c = '\t';
+    } else if (escape == 'u') {
+        // Unicode
+        int value = 0;
+        for (int i = 0; i < 4; ++i) {
+            if (!iter) {
+                return false;
+            }
+            int digit = hexValue(*iter++);
+            if (digit < 0) {
+                return false;
+            }
+            value = value * 16 + digit;
+        }
+        c = QChar(value);
+    }
+    return true;
+}
+
+/**
+ * Returns the position of the next backslash or closing quote within the
+ * contiguous characters, or the size if there is none.
+ */
+int findStringEnd(const QChar* chars, int pos, const int size, const QChar& quote, const StructuralIndex* index)
+{
+    if (index) {
+        while (true) {
+            pos = index->next(StructuralIndex::Quote | StructuralIndex::Backslash, pos);
+            if (pos >= size || chars[pos] == quote || chars[pos] == '\\') {
+                return pos;
+            }
+            ++pos;
+        }
+    }
+    while (pos < size && chars[pos] != quote && chars[pos] != '\\') {
+        ++pos;
+    }
+    return pos;
+}
+
+} // namespace anonymous
+
 bool parseQuotedString(Cursor<QChar>& orig, Result<QString>& result)
 {
     auto iter = orig;
@@ -23,6 +111,43 @@ bool parseQuotedString(Cursor<QChar>& orig, Result<QString>& result)
         return false;
     }
 
+    auto chars = iter.contiguous();
+    if (chars) {
+        // Scan ahead in memory, so the string is copied at once, and only
+        // built up piece by piece if it has escapes
+        const int size = iter.head();
+        auto index = iter.index();
+
+        int pos = iter.pos();
+        int end = findStringEnd(chars, pos, size, quote, index);
+        if (end < size && chars[end] == quote) {
+            result.insert(QString(chars + pos, end - pos));
+            orig = iter + (end + 1 - pos);
+            return true;
+        }
+
+        QString str;
+        while (end < size) {
+            str.append(chars + pos, end - pos);
+            iter += end + 1 - pos;
+
+            QChar c = chars[end];
+            if (c == quote) {
+                result.insert(str);
+                orig = iter;
+                return true;
+            }
+            if (!parseEscape(iter, c)) {
+                return false;
+            }
+            str += c;
+
+            pos = iter.pos();
+            end = findStringEnd(chars, pos, size, quote, index);
+        }
+        return false;
+    }
+
     QString str;
     while (iter) {
         auto c = *iter++;
@@ -33,39 +158,8 @@ bool parseQuotedString(Cursor<QChar>& orig, Result<QString>& result)
             return true;
         }
 
-        if (c == '\\') {
-            // Escaped string, so parse it accordingly
-            if (!iter) {
-                break;
-            }
-
-            auto escape = *iter++;
-            if (escape == 'n') {
-                c = '\n';
-            } else if (escape == 'b') {
-                c = '\b';
-            } else if (escape == 'f') {
-                c = '\f';
-            } else if (escape == 'r') {
-                c = '\r';
-            } else if (escape == 't') {
-                c = '\t';
-            } else if (escape == 'u') {
-                // Unicode
-                QString unicodeValue;
-                for (int i = 0; i < 4; ++i) {
-                    if (!iter) {
-                        return false;
-                    }
-                    unicodeValue += *iter++;
-                }
-                bool ok;
-                auto realValue = unicodeValue.toInt(&ok, 16);
-                if (!ok) {
-                    return false;
-                }
-                c = QChar(realValue);
-            }
+        if (c == '\\' && !parseEscape(iter, c)) {
+            return false;
         }
 
         str += c;
@@ -75,42 +169,195 @@ bool parseQuotedString(Cursor<QChar>& orig, Result<QString>& result)
     return false;
 }
 
-bool parseInteger(Cursor<QChar>& orig, Result<long>& tokens)
+namespace {
+
+/**
+ * The most decimal digits that always fit in an unsigned 64-bit integer.
+ */
+const int MAX_MANTISSA_DIGITS = 19;
+
+/**
+ * The largest integer below which every integer is exactly representable as
+ * a double.
+ */
+const quint64 MAX_EXACT_MANTISSA = quint64(1) << 53;
+
+/**
+ * Powers of ten that are exactly representable as doubles.
+ */
+const double EXACT_POWERS[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+const int MAX_EXACT_POWER = 22;
+
+/**
+ * Exponents are clamped to this, which is far beyond the range of a double.
+ */
+const int MAX_EXPONENT = 100000;
+
+bool isDigit(const QChar& c)
 {
-    auto iter = orig;
+    return c.unicode() >= '0' && c.unicode() <= '9';
+}
 
-    if (!iter) {
-        return false;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+/**
+ * Returns whether all four UTF-16 characters in the chunk are ASCII digits.
+ */
+bool isFourDigits(const quint64 chunk)
+{
+    const quint64 high = 0xFFF0FFF0FFF0FFF0;
+    const quint64 zeros = 0x0030003000300030;
+    return (chunk & high) == zeros && ((chunk + 0x0006000600060006) & high) == zeros;
+}
+
+/**
+ * Returns the value of four UTF-16 digits, with the first in the lowest bits.
+ */
+quint64 parseFourDigits(quint64 chunk)
+{
+    chunk -= 0x0030003000300030;
+
+    // Combine neighbouring digits into pairs, and then the pairs into one value
+    chunk = chunk * 10 + (chunk >> 16);
+    return (((chunk & 0x0000FFFF0000FFFF) * (1 + (quint64(100) << 32))) >> 32) & 0xFFFFFFFF;
+}
+
+#endif
+
+/**
+ * Adds up to the given number of digits to the value, returning how many were
+ * read. Indexed cursors are read four digits at a time.
+ */
+int accumulateDigits(Cursor<QChar>& iter, quint64& value, const int room)
+{
+    int count = 0;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    auto index = iter.index();
+    if (index) {
+        const QChar* chars = index->string().constData() + iter.pos();
+        const int available = index->size() - iter.pos();
+        while (room - count >= 4 && available - count >= 4) {
+            quint64 chunk;
+            std::memcpy(&chunk, chars + count, sizeof(chunk));
+            if (!isFourDigits(chunk)) {
+                break;
+            }
+            value = value * 10000 + parseFourDigits(chunk);
+            count += 4;
+        }
+        iter += count;
     }
+#endif
 
-    int sign = 1;
-    long cumulative = 0;
+    while (count < room && iter && isDigit(*iter)) {
+        value = value * 10 + ((*iter).unicode() - '0');
+        ++count;
+        ++iter;
+    }
+    return count;
+}
 
-    if (*iter == '-') {
-        sign = -1;
+int skipDigits(Cursor<QChar>& iter, const QChar& digit = QChar())
+{
+    int count = 0;
+    while (iter && (digit.isNull() ? isDigit(*iter) : *iter == digit)) {
+        ++count;
         ++iter;
     }
+    return count;
+}
 
-    bool found = false;
-    while (iter) {
-        auto digit = (*iter).digitValue();
-        if (digit == -1) {
+/**
+ * Reads an optionally negative integer, clamping its magnitude to the limit.
+ */
+bool readExponent(Cursor<QChar>& iter, int& exponent)
+{
+    bool negative = false;
+    if (iter && *iter == '-') {
+        negative = true;
+        ++iter;
+    }
+
+    quint64 value = 0;
+    int count = 0;
+    while (iter && isDigit(*iter)) {
+        if (value < MAX_EXPONENT) {
+            value = value * 10 + ((*iter).unicode() - '0');
+        }
+        ++count;
+        ++iter;
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    exponent = std::min<quint64>(value, MAX_EXPONENT);
+    if (negative) {
+        exponent = -exponent;
+    }
+    return true;
+}
+
+/**
+ * Converts the text of a number that the fast paths couldn't, which rounds
+ * correctly regardless of the number of digits. The digits are copied without
+ * the decimal point, so the conversion doesn't depend on the locale.
+ */
+double convertSlowly(Cursor<QChar> iter, const Cursor<QChar>& end, const int exponent)
+{
+    std::string text;
+    int fractionDigits = 0;
+    bool fraction = false;
+    for (; iter < end; ++iter) {
+        auto c = *iter;
+        if (c == '.') {
+            fraction = true;
+        } else if (c == 'e' || c == 'E') {
             break;
+        } else {
+            text += c.toLatin1();
+            if (fraction) {
+                ++fractionDigits;
+            }
         }
-        found = true;
+    }
+    text += 'e';
+    text += std::to_string(static_cast<long>(exponent) - fractionDigits);
+    return std::strtod(text.c_str(), nullptr);
+}
 
-        cumulative *= 10;
-        cumulative += digit;
+} // namespace anonymous
 
+bool parseInteger(Cursor<QChar>& orig, Result<long>& tokens)
+{
+    auto iter = orig;
+
+    bool negative = false;
+    if (iter && *iter == '-') {
+        negative = true;
         ++iter;
     }
 
-    if (!found) {
+    int zeros = skipDigits(iter, '0');
+
+    quint64 magnitude = 0;
+    int digits = accumulateDigits(iter, magnitude, MAX_MANTISSA_DIGITS);
+    if (digits + zeros == 0) {
+        return false;
+    }
+
+    const quint64 limit = static_cast<quint64>(std::numeric_limits<long>::max()) + (negative ? 1 : 0);
+    if ((iter && isDigit(*iter)) || magnitude > limit) {
+        // Too large to be represented
         return false;
     }
 
     orig = iter;
-    tokens << (sign * cumulative);
+    tokens << (negative ? static_cast<long>(0 - magnitude) : static_cast<long>(magnitude));
     return true;
 }
 
@@ -118,63 +365,82 @@ bool parseFloating(Cursor<QChar>& orig, Result<double>& tokens)
 {
     auto iter = orig;
 
-    if (!iter) {
-        return false;
+    bool negative = false;
+    if (iter && *iter == '-') {
+        negative = true;
+        ++iter;
     }
 
-    Result<long> nums;
+    // The value is the mantissa times ten to the exponent, where the mantissa
+    // holds the first significant digits. Any others are counted but not kept.
+    quint64 mantissa = 0;
+    int exponent = 0;
+    int significant = 0;
 
-    long whole = 0;
-    if (*iter != '.') {
-        if (parseInteger(iter, nums)) {
-            whole = *nums++;
-        } else {
-            return false;
-        }
+    int wholeDigits = skipDigits(iter, '0');
+    significant = accumulateDigits(iter, mantissa, MAX_MANTISSA_DIGITS);
+    int dropped = skipDigits(iter);
+    exponent += dropped;
+    significant += dropped;
+    wholeDigits += significant;
+
+    if (wholeDigits == 0 && (negative || !iter || *iter != '.')) {
+        return false;
     }
 
-    double fractionValue = 0;
     if (iter && *iter == '.') {
         ++iter;
 
-        long fraction = 0;
-        int magnitude = 0;
-        while (iter) {
-            auto digit = (*iter).digitValue();
-            if (digit < 0) {
-                break;
-            }
-            fraction *= 10;
-            fraction += digit;
-            ++magnitude;
-            ++iter;
+        int fractionDigits = 0;
+        if (mantissa == 0) {
+            // Leading zeros of the fraction only scale the value
+            fractionDigits = skipDigits(iter, '0');
+            exponent -= fractionDigits;
         }
+        int kept = accumulateDigits(iter, mantissa, MAX_MANTISSA_DIGITS - std::min(significant, MAX_MANTISSA_DIGITS));
+        exponent -= kept;
+        dropped = skipDigits(iter);
+        significant += kept + dropped;
+        fractionDigits += kept + dropped;
 
-        if (magnitude == 0) {
+        if (fractionDigits == 0) {
             // Nothing in the fractional component was found, so fail
             return false;
         }
-
-        fractionValue = fraction * std::pow(10, -magnitude);
     }
 
-    int exponent = 0;
+    int explicitExponent = 0;
     if (iter && (*iter == 'e' || *iter == 'E')) {
         ++iter;
 
-        if (*iter == '+') {
+        if (iter && *iter == '+') {
             ++iter;
         }
 
-        if (!parseInteger(iter, nums)) {
+        if (!readExponent(iter, explicitExponent)) {
             return false;
         }
+        exponent += explicitExponent;
+    }
 
-        exponent = *nums;
+    double value;
+    if (mantissa == 0) {
+        value = 0;
+    } else if (significant <= MAX_MANTISSA_DIGITS && mantissa <= MAX_EXACT_MANTISSA &&
+            exponent >= -MAX_EXACT_POWER && exponent <= MAX_EXACT_POWER && FLT_EVAL_METHOD == 0) {
+        // Both operands are exact, so the single operation rounds correctly
+        value = static_cast<double>(mantissa);
+        if (exponent < 0) {
+            value /= EXACT_POWERS[-exponent];
+        } else {
+            value *= EXACT_POWERS[exponent];
+        }
+    } else {
+        value = convertSlowly(orig + (negative ? 1 : 0), iter, explicitExponent);
     }
 
     orig = iter;
-    tokens << (whole + fractionValue) * std::pow(10, exponent);
+    tokens << (negative ? -value : value);
     return true;
 }
 
@@ -186,9 +452,16 @@ rule::Proxy<QChar, QString> lineComment(const QString& delimiter)
             return false;
         }
         QString str;
-        while (iter && *iter != '\n') {
-            str += *iter;
-            ++iter;
+        auto index = iter.index();
+        if (index) {
+            int end = index->next(StructuralIndex::Newline, iter.pos());
+            str = index->string().mid(iter.pos(), end - iter.pos());
+            iter += end - iter.pos();
+        } else {
+            while (iter && *iter != '\n') {
+                str += *iter;
+                ++iter;
+            }
         }
         result << str;
         return true;
@@ -197,16 +470,18 @@ rule::Proxy<QChar, QString> lineComment(const QString& delimiter)
 
 rule::Proxy<QChar, QString> variable()
 {
-    return [](Cursor<QChar>& iter, Result<QString>& result) {
+    auto first = CharClass::letter().with('_');
+    auto rest = CharClass::letterOrNumber();
+    return [first, rest](Cursor<QChar>& iter, Result<QString>& result) {
         if (!iter) {
             return false;
         }
-        if (!(*iter).isLetter() && *iter != '_') {
+        if (!first(*iter)) {
             return false;
         }
         QString name;
         name += *iter++;
-        while (iter && (*iter).isLetterOrNumber()) {
+        while (iter && rest(*iter)) {
             name += *iter++;
         }
         result << name;
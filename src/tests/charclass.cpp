@@ -0,0 +1,51 @@
+#include <CharClass.hpp>
+#include <rule/Predicate.hpp>
+
+#include "init.hpp"
+
+using namespace sprout;
+
+BOOST_AUTO_TEST_CASE(testCharClassMatchesItsPredicate)
+{
+    auto& letters = CharClass::letter();
+    for (ushort code = 0; code < 0x3000; ++code) {
+        BOOST_REQUIRE_EQUAL(QChar(code).isLetter(), letters(QChar(code)));
+    }
+
+    auto& spaces = CharClass::space();
+    BOOST_CHECK(spaces(' '));
+    BOOST_CHECK(spaces('\t'));
+    BOOST_CHECK(!spaces('x'));
+    BOOST_CHECK(spaces(QChar(0xa0)));
+
+    BOOST_CHECK(!CharClass()('a'));
+    BOOST_CHECK(!CharClass()(QChar(0x4e2d)));
+}
+
+BOOST_AUTO_TEST_CASE(testCharClassWithExtraCharacters)
+{
+    auto name = CharClass::letter().with('_');
+    BOOST_CHECK(name('_'));
+    BOOST_CHECK(name('a'));
+    BOOST_CHECK(!name('1'));
+    BOOST_CHECK(!CharClass::letter()('_'));
+
+    auto digits = CharClass([](const QChar& c) {
+        return c.isDigit();
+    }).with(QChar(0x2212));
+    BOOST_CHECK(digits('7'));
+    BOOST_CHECK(digits(QChar(0x2212)));
+    BOOST_CHECK(!digits(QChar(0x2211)));
+}
+
+BOOST_AUTO_TEST_CASE(testCharClassWithPredicateRule)
+{
+    auto rule = rule::simplePredicate<QChar, QString>(CharClass::letter());
+    Result<QString> tokens;
+
+    auto data = QString::fromUtf8("中1");
+    auto cursor = makeCursor<QChar>(&data);
+    BOOST_CHECK(rule(cursor, tokens));
+    BOOST_CHECK(!rule(cursor, tokens));
+    BOOST_CHECK_EQUAL(1, cursor.pos());
+}
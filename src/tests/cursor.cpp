@@ -48,3 +48,44 @@ BOOST_AUTO_TEST_CASE(constructCursorWithMake)
     std::stringstream str("Cat");
     auto cursor = makeCursor<char>(&str);
 }
+
+BOOST_AUTO_TEST_CASE(readCursorWithoutThrowing)
+{
+    std::stringstream str("Ca");
+    auto cursor = makeCursor<char>(&str);
+
+    char value = 0;
+    BOOST_CHECK(FailureReason::None == cursor.read(value));
+    BOOST_CHECK_EQUAL('C', value);
+
+    cursor += 2;
+    BOOST_CHECK(FailureReason::EndOfInput == cursor.read(value));
+    BOOST_CHECK_EQUAL('C', value);
+
+    BOOST_CHECK(!cursor.fail(FailureReason::EndOfInput));
+    BOOST_CHECK(FailureReason::EndOfInput == cursor.failure().reason());
+    BOOST_CHECK_EQUAL(2, cursor.failure().pos());
+    BOOST_CHECK_EQUAL("line 1, column 3: unexpected end of input", cursor.failure().describe(std::string("Ca")));
+}
+
+BOOST_AUTO_TEST_CASE(readDiscardedChunksWithoutThrowing)
+{
+    ChunkedCursorData<char>* data = new ChunkedCursorData<char>;
+    Cursor<char> cursor(data);
+
+    std::string chunk("abc");
+    data->feed(chunk.begin(), chunk.end());
+    data->discardBefore(2);
+
+    char value = 0;
+    BOOST_CHECK(FailureReason::OutOfRange == cursor.read(value));
+
+    cursor += 2;
+    BOOST_CHECK(FailureReason::None == cursor.read(value));
+    BOOST_CHECK_EQUAL('c', value);
+
+    // Reading past the buffer waits for more input rather than failing outright
+    ++cursor;
+    BOOST_CHECK(FailureReason::EndOfInput == cursor.read(value));
+    BOOST_CHECK(data->starved());
+}
@@ -0,0 +1,47 @@
+#include <rule/Expect.hpp>
+#include <rule/Literal.hpp>
+#include <rule/Alternative.hpp>
+#include <rule/Sequence.hpp>
+
+#include "init.hpp"
+
+using namespace sprout;
+
+BOOST_AUTO_TEST_CASE(testExpectRecordsFarthestFailure)
+{
+    auto literal = [](const char* str) {
+        return rule::expect(
+            rule::OrderedLiteral<char, std::string>(str),
+            std::string("'") + str + "'"
+        );
+    };
+    auto rule = rule::tupleAlternative<char, std::string>(
+        rule::tupleSequence<char, std::string>(literal("ab"), literal("\nc"), literal("x")),
+        rule::tupleSequence<char, std::string>(literal("ab"), literal("\nc"), literal("y")),
+        literal("z")
+    );
+
+    std::string input("ab\ncd");
+    auto cursor = makeCursor<char>(&input);
+    Result<std::string> tokens;
+    BOOST_CHECK(!rule(cursor, tokens));
+
+    auto& failure = cursor.failure();
+    BOOST_REQUIRE(failure);
+    BOOST_CHECK_EQUAL(4, failure.pos());
+    BOOST_REQUIRE_EQUAL(2u, failure.expected().size());
+    BOOST_CHECK_EQUAL("'x'", failure.expected()[0]);
+    BOOST_CHECK_EQUAL("'y'", failure.expected()[1]);
+    BOOST_CHECK_EQUAL("line 2, column 2: expected 'x' or 'y'", failure.describe(input));
+}
+
+BOOST_AUTO_TEST_CASE(testExpectRecordsNothingOnSuccess)
+{
+    auto rule = rule::expect(rule::OrderedLiteral<char, std::string>("ab"), "'ab'");
+
+    std::string input("ab");
+    auto cursor = makeCursor<char>(&input);
+    Result<std::string> tokens;
+    BOOST_CHECK(rule(cursor, tokens));
+    BOOST_CHECK(!cursor.failure());
+}
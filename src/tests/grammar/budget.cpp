@@ -0,0 +1,88 @@
+#include <Budget.hpp>
+
+#include "grammar.hpp"
+#include "init.hpp"
+
+using namespace sprout;
+using namespace grammar;
+
+namespace {
+
+const char* NESTED_GRAMMAR = "Rule nested = '(' nested? ')';\n";
+
+bool parse(TGrammar& grammar, const QString& input, Budget* budget)
+{
+    auto cursor = makeCursor<QChar>(&input);
+    cursor.setBudget(budget);
+    Result<PNode> results;
+    return grammar["nested"](cursor, results) && !cursor;
+}
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testBudgetCountsSteps)
+{
+    Budget budget;
+    budget.setMaxSteps(2);
+
+    BOOST_CHECK(budget.enter());
+    BOOST_CHECK(budget.enter());
+    BOOST_CHECK_EQUAL(2, budget.depth());
+    BOOST_CHECK(!budget.enter());
+    BOOST_CHECK(budget.status() == BudgetStatus::StepsExceeded);
+
+    // Nothing runs once the budget is exceeded
+    budget.exit();
+    budget.exit();
+    BOOST_CHECK(!budget.enter());
+
+    budget.reset();
+    BOOST_CHECK(!budget.exceeded());
+    BOOST_CHECK(budget.enter());
+}
+
+BOOST_AUTO_TEST_CASE(testGrammarWithoutBudget)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, NESTED_GRAMMAR);
+    BOOST_CHECK(parse(grammar, "((((()))))", nullptr));
+}
+
+BOOST_AUTO_TEST_CASE(testGrammarStopsAtMaxDepth)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, NESTED_GRAMMAR);
+
+    Budget budget;
+    budget.setMaxDepth(6);
+    BOOST_CHECK(parse(grammar, "((((()))))", &budget));
+    BOOST_CHECK(!budget.exceeded());
+    BOOST_CHECK_EQUAL(0, budget.depth());
+
+    budget.reset();
+    BOOST_CHECK(!parse(grammar, "((((((()))))))", &budget));
+    BOOST_CHECK(budget.status() == BudgetStatus::DepthExceeded);
+}
+
+BOOST_AUTO_TEST_CASE(testGrammarStopsAtMaxSteps)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, NESTED_GRAMMAR);
+
+    Budget budget;
+    budget.setMaxSteps(3);
+    BOOST_CHECK(!parse(grammar, "((((()))))", &budget));
+    BOOST_CHECK(budget.status() == BudgetStatus::StepsExceeded);
+    BOOST_CHECK_EQUAL(0, budget.depth());
+}
+
+BOOST_AUTO_TEST_CASE(testGrammarStopsAtDeadline)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, NESTED_GRAMMAR);
+
+    Budget budget;
+    budget.setDeadline(Budget::Clock::now() - std::chrono::seconds(1));
+    BOOST_CHECK(!parse(grammar, "()", &budget));
+    BOOST_CHECK(budget.status() == BudgetStatus::DeadlineExceeded);
+}
@@ -0,0 +1,46 @@
+#include "grammar.hpp"
+#include "init.hpp"
+
+using namespace sprout;
+using namespace grammar;
+
+namespace {
+
+const char* CUT_GRAMMAR =
+    "Group main = statement+;\n"
+    "Group statement = block | call | assign;\n"
+    "Rule block = '{' ^ name* '}';\n"
+    "Rule call = '{' name;\n"
+    "Rule assign = name '=' list;\n"
+    "Rule list = ('(' ^ name ')')*;\n"
+    "Token name = alpha+;\n";
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testCutCommitsToAlternative)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, CUT_GRAMMAR);
+
+    int pos = 0;
+    BOOST_CHECK(parseBothWays(grammar, "{ a b } x = (a)(b)", pos));
+    BOOST_CHECK_EQUAL(18, pos);
+
+    // Without the cut in block, this would be a call
+    BOOST_CHECK(!parseBothWays(grammar, "{ a", pos));
+
+    // A repetition that fails after a cut fails, rather than stopping early
+    BOOST_CHECK(!parseBothWays(grammar, "x = (a)(b", pos));
+}
+
+BOOST_AUTO_TEST_CASE(testCutDoesNotEscapeItsChoice)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, CUT_GRAMMAR);
+
+    // The cut in the first block is done with once the block matches, so the
+    // failed block after it only ends the statements
+    int pos = 0;
+    BOOST_CHECK(parseBothWays(grammar, "{ a } { b", pos));
+    BOOST_CHECK_EQUAL(6, pos);
+}
@@ -0,0 +1,321 @@
+#include <grammar/StackEvaluator.hpp>
+
+#include "grammar.hpp"
+#include "init.hpp"
+
+using namespace sprout;
+using namespace grammar;
+
+namespace {
+
+/**
+ * Checks that the nodes, and all of their children, have the same spans.
+ */
+void checkSameSpans(const PNode& expected, const PNode& actual)
+{
+    BOOST_CHECK_EQUAL(expected.start(), actual.start());
+    BOOST_CHECK_EQUAL(expected.end(), actual.end());
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (unsigned i = 0; i < expected.size(); ++i) {
+        checkSameSpans(expected[i], actual[i]);
+    }
+}
+
+/**
+ * Checks that the evaluator matches the input exactly as the built rule does.
+ */
+void checkSameResults(TGrammar& grammar, const QString& input)
+{
+    auto cursor = makeCursor<QChar>(&input);
+    Result<PNode> expected;
+    const bool matched = grammar["main"](cursor, expected);
+
+    auto evaluator = stackEvaluator(grammar);
+    auto evaluated = makeCursor<QChar>(&input);
+    Result<PNode> results;
+    BOOST_CHECK_EQUAL(matched, evaluator("main", evaluated, results));
+    BOOST_CHECK_EQUAL(cursor.pos(), evaluated.pos());
+
+    BOOST_REQUIRE_EQUAL(expected.size(), results.size());
+    for (int i = 0; i < expected.size(); ++i) {
+        BOOST_CHECK_EQUAL(expected[i], results[i]);
+        checkSameSpans(expected[i], results[i]);
+    }
+}
+
+/**
+ * Records each event as a line, such as "enter call 6" or "name a 8 9".
+ */
+class RecordingHandler : public EventHandler<QString, QString>
+{
+public:
+    QStringList events;
+    int depth = 0;
+    int tokens = 0;
+
+    void enterRule(const QString& name, const int start)
+    {
+        events << QString("enter %1 %2").arg(name).arg(start);
+        ++depth;
+    }
+
+    void exitRule(const QString& name, const int start, const int end)
+    {
+        events << QString("exit %1 %2 %3").arg(name).arg(start).arg(end);
+        --depth;
+    }
+
+    void token(const QString& type, const QString& value, const int start, const int end)
+    {
+        events << QString("%1 %2 %3 %4").arg(type).arg(value).arg(start).arg(end);
+        ++tokens;
+    }
+};
+
+const char* STATEMENT_GRAMMAR =
+    "Rule main = statement*;\n"
+    "Group statement = call | assign;\n"
+    "Rule call = name '(' name? ')';\n"
+    "Rule assign = name '=' name;\n"
+    "Token name = alpha+;\n";
+
+struct Call
+{
+    QString function;
+    QStringList arguments;
+    int start;
+    int end;
+};
+
+struct Assign
+{
+    QString target;
+    QString value;
+};
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testEvaluatorMatchesBuiltRules)
+{
+    TGrammar grammar;
+    readGrammar(grammar,
+        "Rule main = statement+;\n"
+        "Group statement = call | assign;\n"
+        "Rule call = name '(' {value ','}? ')';\n"
+        "Rule assign = name '=' value;\n"
+        "Group value = list | sum | name;\n"
+        "Rule list = '[' value* ']';\n"
+        "Token name = alpha+;\n"
+    );
+
+    // As LeftRecursion would write "Rule sum = sum '+' name | name;"
+    grammar.parsedRules()["sum"] = GNode(TokenType::Rule, "sum", {
+        GNode(TokenType::Recursive, "sum", {
+            GNode(TokenType::Name, "name"),
+            GNode(TokenType::Sequence, {
+                GNode(TokenType::Literal, "+"),
+                GNode(TokenType::Name, "name")
+            })
+        })
+    });
+    grammar.build();
+
+    checkSameResults(grammar, "f(a, [b c], d)");
+    checkSameResults(grammar, "x = [a [b]] y = z g()");
+    checkSameResults(grammar, "x = a + b + c");
+    checkSameResults(grammar, "f(a, ");
+    checkSameResults(grammar, "= a");
+}
+
+BOOST_AUTO_TEST_CASE(testEvaluatorSurvivesDeepNesting)
+{
+    TGrammar grammar;
+    readGrammar(grammar, "Rule main = '(' -main? ')';\n");
+    grammar.build();
+
+    const int depth = 200000;
+    QString input = QString(depth, '(') + QString(depth, ')');
+
+    auto evaluator = stackEvaluator(grammar);
+    auto cursor = makeCursor<QChar>(&input);
+    Result<PNode> results;
+    BOOST_CHECK(evaluator("main", cursor, results));
+    BOOST_CHECK(!cursor);
+    BOOST_CHECK_EQUAL(1, results.size());
+
+    // Unbalanced input fails without consuming anything
+    input.chop(1);
+    cursor = makeCursor<QChar>(&input);
+    results.clear();
+    BOOST_CHECK(!evaluator.rule("main")(cursor, results));
+    BOOST_CHECK_EQUAL(0, cursor.pos());
+}
+
+BOOST_AUTO_TEST_CASE(testEvaluatorBuildsDeepTrees)
+{
+    TGrammar grammar;
+    readGrammar(grammar, "Rule main = '(' main? ')';\n");
+    grammar.build();
+
+    const int depth = 200000;
+    QString input = QString(depth, '(') + QString(depth, ')');
+
+    auto evaluator = stackEvaluator(grammar);
+    auto cursor = makeCursor<QChar>(&input);
+    {
+        Result<PNode> results;
+        BOOST_REQUIRE(evaluator("main", cursor, results));
+        BOOST_CHECK(!cursor);
+        BOOST_REQUIRE_EQUAL(1, results.size());
+
+        int nodes = 1;
+        const PNode* node = &results[0];
+        while (node->size() > 0) {
+            BOOST_REQUIRE_EQUAL(1u, node->size());
+            node = &(*node)[0];
+            ++nodes;
+        }
+        BOOST_CHECK_EQUAL(depth, nodes);
+        BOOST_CHECK_EQUAL(depth - 1, node->start());
+
+        // The tree is destroyed here, which must not recurse either
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testEvaluatorSendsEvents)
+{
+    TGrammar grammar;
+    readGrammar(grammar, STATEMENT_GRAMMAR);
+    grammar.build();
+
+    auto evaluator = stackEvaluator(grammar);
+    QString input("x = y f(a) ");
+    auto cursor = makeCursor<QChar>(&input);
+    RecordingHandler handler;
+    BOOST_CHECK(evaluator("main", cursor, handler));
+
+    // The call that was tried for "x =" is never seen
+    BOOST_CHECK_EQUAL(
+        QStringList({
+            "enter main 0",
+            "enter assign 0",
+            "name x 0 1",
+            "name y 4 5",
+            "exit assign 0 5",
+            "enter call 6",
+            "name f 6 7",
+            "name a 8 9",
+            "exit call 6 10",
+            "exit main 0 10"
+        }).join("\n"),
+        handler.events.join("\n")
+    );
+}
+
+BOOST_AUTO_TEST_CASE(testEvaluatorStreamsManyEvents)
+{
+    TGrammar grammar;
+    readGrammar(grammar, STATEMENT_GRAMMAR);
+    grammar.build();
+
+    QString input;
+    for (int i = 0; i < 2000; ++i) {
+        input += "x = y f(a) ";
+    }
+
+    auto evaluator = stackEvaluator(grammar);
+    auto cursor = makeCursor<QChar>(&input);
+    RecordingHandler handler;
+    BOOST_CHECK(evaluator("main", cursor, handler));
+    BOOST_CHECK(!cursor);
+    BOOST_CHECK_EQUAL(0, handler.depth);
+    BOOST_CHECK_EQUAL(8000, handler.tokens);
+    BOOST_CHECK_EQUAL("exit main 0 21999", handler.events.last());
+}
+
+BOOST_AUTO_TEST_CASE(testEvaluatorRunsActions)
+{
+    TGrammar grammar;
+    readGrammar(grammar, STATEMENT_GRAMMAR);
+    grammar.build();
+
+    grammar.on<Call>("call", [](const ActionValues<PNode>& values) {
+        Call call { values.text(0), QStringList(), values.start(), values.end() };
+        for (int i = 1; i < values.size(); ++i) {
+            call.arguments << values.text(i);
+        }
+        return call;
+    });
+    grammar.on<Assign>("assign", [](const ActionValues<PNode>& values) {
+        return Assign { values.text(0), values.text(1) };
+    });
+    grammar.on<QStringList>("main", [](const ActionValues<PNode>& values) {
+        QStringList statements;
+        for (int i = 0; i < values.size(); ++i) {
+            if (values.is<Call>(i)) {
+                const Call& call = values.get<Call>(i);
+                statements << QString("%1(%2) %3 %4").arg(call.function).arg(call.arguments.join(",")).arg(call.start).arg(call.end);
+            } else {
+                const Assign& assign = values.get<Assign>(i);
+                statements << QString("%1=%2").arg(assign.target).arg(assign.value);
+            }
+        }
+        return statements;
+    });
+
+    auto evaluator = stackEvaluator(grammar);
+    QString input("x = y f(a) g() ");
+    auto cursor = makeCursor<QChar>(&input);
+    QStringList statements;
+    BOOST_CHECK(evaluator.parse("main", cursor, statements));
+    BOOST_CHECK(!cursor);
+
+    // The call that was tried for "x =" is discarded
+    BOOST_CHECK_EQUAL("x=y|f(a) 6 10|g() 11 14", statements.join("|"));
+
+    // Without an action, the values of each statement are passed through
+    std::vector<SemanticValue> values;
+    cursor = makeCursor<QChar>(&input);
+    BOOST_CHECK(evaluator("statement", cursor, values));
+    BOOST_REQUIRE_EQUAL(1u, values.size());
+    BOOST_CHECK_EQUAL("y", values[0].as<Assign>().value);
+    BOOST_CHECK_THROW(values[0].as<Call>(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(testEvaluatorRunsActionsForRecursiveRules)
+{
+    TGrammar grammar;
+
+    // As LeftRecursion would write "Rule sum = sum '+' number | number;"
+    grammar.parsedRules()["sum"] = GNode(TokenType::Rule, "sum", {
+        GNode(TokenType::Recursive, "sum", {
+            GNode(TokenType::Name, "number"),
+            GNode(TokenType::Sequence, {
+                GNode(TokenType::Literal, "+"),
+                GNode(TokenType::Name, "number")
+            })
+        })
+    });
+    grammar.build();
+
+    grammar.on<double>("number", [](const ActionValues<PNode>& values) {
+        return values.text(0).toDouble();
+    });
+    grammar.on<double>("sum", [](const ActionValues<PNode>& values) {
+        return values.get<double>(0) + values.get<double>(1);
+    });
+
+    auto evaluator = stackEvaluator(grammar);
+    double value = 0;
+
+    QString input("1 + 2 + 3.5");
+    auto cursor = makeCursor<QChar>(&input);
+    BOOST_CHECK(evaluator.parse("sum", cursor, value));
+    BOOST_CHECK_EQUAL(6.5, value);
+
+    // A single number is never grouped, so it's the number's value
+    input = "4";
+    cursor = makeCursor<QChar>(&input);
+    BOOST_CHECK(evaluator.parse("sum", cursor, value));
+    BOOST_CHECK_EQUAL(4, value);
+}
@@ -0,0 +1,117 @@
+#include <grammar/Generator.hpp>
+
+#include "grammar.hpp"
+#include "init.hpp"
+
+using namespace sprout;
+using namespace grammar;
+
+namespace {
+
+const char* LIST_GRAMMAR =
+    "Group main = value+;\n"
+    "Group value = 'nil' | number | name | list;\n"
+    "Rule list = '[' {value ','}? ']';\n"
+    "Token name = alpha alnum*;\n";
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testGeneratorIsDeterministic)
+{
+    TGrammar grammar;
+    readGrammar(grammar, LIST_GRAMMAR);
+
+    Generator first(grammar.parsedRules(), 42);
+    Generator second(grammar.parsedRules(), 42);
+    Generator other(grammar.parsedRules(), 43);
+
+    QString firstOutput, secondOutput, otherOutput;
+    for (int i = 0; i < 20; ++i) {
+        firstOutput += first.generate("main");
+        secondOutput += second.generate("main");
+        otherOutput += other.generate("main");
+    }
+    BOOST_CHECK_EQUAL(firstOutput, secondOutput);
+    BOOST_CHECK(firstOutput != otherOutput);
+}
+
+BOOST_AUTO_TEST_CASE(testGeneratorMinDepth)
+{
+    TGrammar grammar;
+    readGrammar(grammar, LIST_GRAMMAR);
+
+    Generator generator(grammar.parsedRules());
+    BOOST_CHECK_EQUAL(0, generator.minDepth("name"));
+    BOOST_CHECK_EQUAL(0, generator.minDepth("list"));
+    BOOST_CHECK_EQUAL(0, generator.minDepth("value"));
+    BOOST_CHECK_EQUAL(1, generator.minDepth("main"));
+
+    // Even without any depth to spare, the rule must still be completed
+    generator.setMaxDepth(0);
+    auto output = generator.generate("list");
+    BOOST_CHECK(output.startsWith("["));
+    BOOST_CHECK(output.endsWith("]"));
+}
+
+BOOST_AUTO_TEST_CASE(testGeneratedInputIsParsed)
+{
+    TGrammar grammar;
+    readGrammar(grammar, LIST_GRAMMAR);
+
+    Generator generator(grammar.parsedRules(), 7);
+    generator.setMaxDepth(4);
+    grammar.build();
+
+    auto parser = grammar["main"];
+    for (int i = 0; i < 50; ++i) {
+        auto text = generator.generate("main");
+
+        auto cursor = makeCursor<QChar>(&text);
+        Result<PNode> nodes;
+        BOOST_CHECK(parser(cursor, nodes));
+        BOOST_CHECK(!cursor);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testGeneratorAvoidsReservedWords)
+{
+    TGrammar grammar;
+    readGrammar(grammar, LIST_GRAMMAR);
+
+    Generator generator(grammar.parsedRules());
+    generator.setOpaque("alpha", [](Generator& generator) {
+        return QString("ni"[generator.random(2)]);
+    });
+    generator.setOpaque("alnum", [](Generator& generator) {
+        return QString("il"[generator.random(2)]);
+    });
+
+    for (int i = 0; i < 100; ++i) {
+        BOOST_CHECK(!generator.generate("name").startsWith("nil"));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testGeneratorUsesWeights)
+{
+    TGrammar grammar;
+    readGrammar(grammar, LIST_GRAMMAR);
+
+    Generator generator(grammar.parsedRules());
+    generator.setWeight("list", 0);
+    generator.setWeight("name", 0);
+
+    for (int i = 0; i < 20; ++i) {
+        auto output = generator.generate("value");
+        BOOST_CHECK(!output.contains('['));
+        BOOST_CHECK(output == "nil" || output[0].isDigit());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testGeneratorRejectsUnknownRules)
+{
+    TGrammar grammar;
+    readGrammar(grammar, LIST_GRAMMAR);
+
+    Generator generator(grammar.parsedRules());
+    BOOST_CHECK_THROW(generator.generate("missing"), std::runtime_error);
+}
@@ -0,0 +1,51 @@
+#include "grammar.hpp"
+#include "init.hpp"
+
+using namespace sprout;
+
+void readGrammar(TGrammar& grammar, const char* text)
+{
+    QString str(text);
+    auto cursor = makeCursor<QChar>(&str);
+    grammar.readGrammar(cursor);
+}
+
+void buildGrammar(TGrammar& grammar, const char* text)
+{
+    readGrammar(grammar, text);
+    grammar.build();
+    grammar.buildLexer();
+}
+
+bool parseBothWays(TGrammar& grammar, const QString& input, Result<PNode>& results, int& pos)
+{
+    auto cursor = makeCursor<QChar>(&input);
+    bool matched = grammar["main"](cursor, results);
+    pos = cursor.pos();
+
+    cursor = makeCursor<QChar>(&input);
+    std::vector<TLexeme> lexemes;
+    BOOST_REQUIRE(grammar.lexer()(cursor, lexemes));
+
+    auto tokens = makeCursor<TLexeme>(&lexemes);
+    Result<PNode> lexed;
+    BOOST_CHECK_EQUAL(matched, grammar.lexed("main")(tokens, lexed));
+    if (!matched) {
+        return false;
+    }
+
+    BOOST_REQUIRE_EQUAL(results.size(), lexed.size());
+    for (int i = 0; i < results.size(); ++i) {
+        BOOST_CHECK_EQUAL(results[i], lexed[i]);
+    }
+    BOOST_CHECK_EQUAL(pos, tokens ? lexemes[tokens.pos()].start : input.size());
+    return true;
+}
+
+bool parseBothWays(TGrammar& grammar, const QString& input, int& pos)
+{
+    Result<PNode> results;
+    return parseBothWays(grammar, input, results, pos);
+}
+
+// vim: set ts=4 sw=4 :
@@ -0,0 +1,33 @@
+#ifndef SPROUT_TEST_GRAMMAR_HEADER
+#define SPROUT_TEST_GRAMMAR_HEADER
+
+#include <grammar/Grammar.hpp>
+
+#include <QString>
+
+typedef sprout::grammar::Grammar<QString, QString> TGrammar;
+typedef TGrammar::PNode PNode;
+typedef TGrammar::LexemeType TLexeme;
+
+/**
+ * Reads the rules of the grammar from the text, without building them.
+ */
+void readGrammar(TGrammar& grammar, const char* text);
+
+/**
+ * Reads the rules of the grammar from the text, and builds them to parse
+ * both characters and lexemes.
+ */
+void buildGrammar(TGrammar& grammar, const char* text);
+
+/**
+ * Parses the input with the main rule as characters, and then as lexemes,
+ * checking that both match the same nodes up to the same position. Returns
+ * whether the characters matched, and writes how many were matched to pos.
+ */
+bool parseBothWays(TGrammar& grammar, const QString& input, sprout::Result<PNode>& results, int& pos);
+bool parseBothWays(TGrammar& grammar, const QString& input, int& pos);
+
+#endif // SPROUT_TEST_GRAMMAR_HEADER
+
+// vim: set ts=4 sw=4 :
@@ -0,0 +1,86 @@
+#include <grammar/KeywordTable.hpp>
+
+#include "grammar.hpp"
+#include "init.hpp"
+
+using namespace sprout;
+using namespace grammar;
+
+namespace {
+
+const char* LUA_KEYWORDS[] = {
+    "and", "break", "do", "else", "elseif", "end", "false", "for", "function",
+    "goto", "if", "in", "local", "nil", "not", "or", "repeat", "return", "then",
+    "true", "until", "while"
+};
+
+const char* STATEMENT_GRAMMAR =
+    "Group main = statement+;\n"
+    "Group statement = assignment | call | block | 'break' ';';\n"
+    "Rule assignment = 'local'? name '=' expression ';';\n"
+    "Rule call = name '(' ')' ';';\n"
+    "Rule block = 'do' statement* 'end';\n"
+    "Group expression = 'nil' | 'true' | number | name;\n"
+    "Token name = (alpha | '_') ('_' | alnum)*;\n";
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testKeywordTableFindsEveryKeyword)
+{
+    KeywordTable table;
+    int kind = 0;
+    for (auto keyword : LUA_KEYWORDS) {
+        table.add(keyword, kind++);
+    }
+
+    kind = 0;
+    for (auto keyword : LUA_KEYWORDS) {
+        BOOST_CHECK_EQUAL(kind++, table.find(keyword));
+    }
+    BOOST_CHECK_EQUAL(-1, table.find("localx"));
+    BOOST_CHECK_EQUAL(-1, table.find("loca"));
+    BOOST_CHECK_EQUAL(-1, table.find("End"));
+    BOOST_CHECK_EQUAL(-1, table.find(""));
+
+    BOOST_CHECK(KeywordTable::isKeyword("_if2"));
+    BOOST_CHECK(!KeywordTable::isKeyword("2if"));
+    BOOST_CHECK(!KeywordTable::isKeyword("a-b"));
+    BOOST_CHECK(!KeywordTable::isKeyword(QString(KeywordTable::MAX_LENGTH + 1, 'a')));
+}
+
+BOOST_AUTO_TEST_CASE(testKeywordTableMatchesWholeWords)
+{
+    KeywordTable table;
+    table.add("local", 3);
+    table.add("do", 4);
+
+    QString input("local localx do_ do+");
+    auto cursor = makeCursor<QChar>(&input);
+    int length = 0;
+    BOOST_CHECK_EQUAL(3, table.match(cursor, length));
+    BOOST_CHECK_EQUAL(5, length);
+
+    cursor += 6;
+    BOOST_CHECK_EQUAL(-1, table.match(cursor, length));
+    cursor += 7;
+    BOOST_CHECK_EQUAL(-1, table.match(cursor, length));
+    cursor += 4;
+    BOOST_CHECK_EQUAL(4, table.match(cursor, length));
+    BOOST_CHECK_EQUAL(2, length);
+
+    // Matching doesn't move the cursor
+    BOOST_CHECK_EQUAL(17, cursor.pos());
+    cursor += 2;
+    BOOST_CHECK_EQUAL(-1, table.match(cursor, length));
+}
+
+BOOST_AUTO_TEST_CASE(testKeywordDispatchMatchesCharacterParse)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, STATEMENT_GRAMMAR);
+
+    QString input("local a = nil; b = true; f(); do break; c = 1; do end end dox = a;");
+    int pos;
+    BOOST_REQUIRE(parseBothWays(grammar, input, pos));
+    BOOST_CHECK_EQUAL(input.size(), pos);
+}
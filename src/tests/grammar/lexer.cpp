@@ -0,0 +1,217 @@
+#include <grammar/Lexer.hpp>
+#include <grammar/ParallelLexer.hpp>
+#include <grammar/Pipeline.hpp>
+
+#include "grammar.hpp"
+#include "init.hpp"
+
+using namespace sprout;
+using namespace grammar;
+
+namespace {
+
+const char* ASSIGNMENT_GRAMMAR =
+    "Group main = statement+;\n"
+    "Rule statement = 'local' name '=' expression ';';\n"
+    "Group expression = number | name | string | negation;\n"
+    "Rule negation = '-' expression;\n"
+    "Token name = (alpha | '_') ('_' | alnum)*;\n";
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testLexerPrefersLongestMatch)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, ASSIGNMENT_GRAMMAR);
+    auto& lexer = grammar.lexer();
+
+    QString input("local localx = -1; -- The rest is a comment");
+    auto cursor = makeCursor<QChar>(&input);
+    std::vector<TLexeme> lexemes;
+    BOOST_REQUIRE(lexer(cursor, lexemes));
+    BOOST_CHECK(!cursor);
+
+    BOOST_REQUIRE_EQUAL(6u, lexemes.size());
+    BOOST_CHECK_EQUAL(lexer.literalKind("local"), lexemes[0].kind);
+    BOOST_CHECK_EQUAL(lexer.ruleKind("name"), lexemes[1].kind);
+    BOOST_CHECK_EQUAL(PNode("name", "localx"), lexemes[1].node);
+    BOOST_CHECK_EQUAL(lexer.literalKind("="), lexemes[2].kind);
+
+    // The operator isn't lexed as part of a negative number
+    BOOST_CHECK_EQUAL(lexer.literalKind("-"), lexemes[3].kind);
+    BOOST_CHECK_EQUAL(lexer.ruleKind("number"), lexemes[4].kind);
+    BOOST_CHECK_EQUAL(lexer.literalKind(";"), lexemes[5].kind);
+
+    BOOST_CHECK_EQUAL(6, lexemes[1].start);
+    BOOST_CHECK_EQUAL(12, lexemes[1].end);
+}
+
+BOOST_AUTO_TEST_CASE(testLexerStopsAtUnknownInput)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, ASSIGNMENT_GRAMMAR);
+
+    QString input("local a = $;");
+    auto cursor = makeCursor<QChar>(&input);
+    std::vector<TLexeme> lexemes;
+    BOOST_CHECK(!grammar.lexer()(cursor, lexemes));
+    BOOST_CHECK_EQUAL(10, cursor.pos());
+    BOOST_CHECK_EQUAL(3u, lexemes.size());
+}
+
+BOOST_AUTO_TEST_CASE(testLexedParseMatchesCharacterParse)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, ASSIGNMENT_GRAMMAR);
+
+    QString input("local a = 1; local b = 'two';\nlocal c = - - a;");
+    Result<PNode> results;
+    int pos;
+    BOOST_REQUIRE(parseBothWays(grammar, input, results, pos));
+    BOOST_CHECK_EQUAL(input.size(), pos);
+    BOOST_CHECK_EQUAL(3, results.size());
+}
+
+BOOST_AUTO_TEST_CASE(testLexedParseRejectsKeywordsAsNames)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, ASSIGNMENT_GRAMMAR);
+
+    QString input("local local = 1;");
+    auto cursor = makeCursor<QChar>(&input);
+    std::vector<TLexeme> lexemes;
+    BOOST_REQUIRE(grammar.lexer()(cursor, lexemes));
+
+    auto tokens = makeCursor<TLexeme>(&lexemes);
+    Result<PNode> results;
+    BOOST_CHECK(!grammar.lexed("main")(tokens, results));
+}
+
+BOOST_AUTO_TEST_CASE(testPipelinedParseMatchesLexedParse)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, ASSIGNMENT_GRAMMAR);
+
+    QString input;
+    for (int i = 0; i < 1000; ++i) {
+        input += "local a = - " + QString::number(i) + "; local b = 'two';\n";
+    }
+
+    auto cursor = makeCursor<QChar>(&input);
+    std::vector<TLexeme> lexemes;
+    BOOST_REQUIRE(grammar.lexer()(cursor, lexemes));
+    auto tokens = makeCursor<TLexeme>(&lexemes);
+    Result<PNode> expected;
+    BOOST_REQUIRE(grammar.lexed("main")(tokens, expected));
+
+    cursor = makeCursor<QChar>(&input);
+    Result<PNode> results;
+    BOOST_REQUIRE(parsePipelined(grammar.lexer(), cursor, grammar.lexed("statement"), results, 16));
+    BOOST_CHECK(!cursor);
+
+    BOOST_REQUIRE_EQUAL(expected.size(), results.size());
+    for (int i = 0; i < results.size(); ++i) {
+        BOOST_CHECK_EQUAL(expected[i], results[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testPipelinedParseFailsOnUnknownInput)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, ASSIGNMENT_GRAMMAR);
+
+    QString input("local a = 1; local b = $;");
+    auto cursor = makeCursor<QChar>(&input);
+    Result<PNode> results;
+    BOOST_CHECK(!parsePipelined(grammar.lexer(), cursor, grammar.lexed("statement"), results));
+    BOOST_CHECK_EQUAL(23, cursor.pos());
+}
+
+BOOST_AUTO_TEST_CASE(testParallelLexerMatchesSequentialLexer)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, ASSIGNMENT_GRAMMAR);
+    auto& lexer = grammar.lexer();
+
+    // Strings and comments cross the chunk boundaries, and hide other delimiters
+    QString input;
+    for (int i = 0; i < 20; ++i) {
+        input += "local a = 'one\n-- not a comment\n';\n";
+        input += "-- a comment with a quote ' \"\n";
+        input += "local b = \"two \\\" three\n\";\nlocal c = - a;\n";
+    }
+
+    auto cursor = makeCursor<QChar>(&input);
+    std::vector<TLexeme> expected;
+    BOOST_REQUIRE(lexer(cursor, expected));
+
+    for (int chunkSize = 8; chunkSize <= 64; chunkSize *= 2) {
+        ParallelLexer<PNode> parallel(lexer);
+        parallel.setThreads(3);
+        parallel.setChunkSize(chunkSize);
+
+        std::vector<TLexeme> lexemes;
+        BOOST_REQUIRE(parallel(input, lexemes));
+        BOOST_REQUIRE_EQUAL(expected.size(), lexemes.size());
+        for (unsigned int i = 0; i < expected.size(); ++i) {
+            BOOST_CHECK_EQUAL(expected[i].kind, lexemes[i].kind);
+            BOOST_CHECK_EQUAL(expected[i].start, lexemes[i].start);
+            BOOST_CHECK_EQUAL(expected[i].end, lexemes[i].end);
+            BOOST_CHECK_EQUAL(expected[i].node, lexemes[i].node);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testParallelLexerStopsAtUnknownInput)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, ASSIGNMENT_GRAMMAR);
+
+    QString input;
+    for (int i = 0; i < 20; ++i) {
+        input += "local a = 1;\n";
+    }
+    input += "local b = $;\n";
+    for (int i = 0; i < 20; ++i) {
+        input += "local c = 2;\n";
+    }
+
+    ParallelLexer<PNode> parallel(grammar.lexer());
+    parallel.setThreads(3);
+    parallel.setChunkSize(16);
+
+    std::vector<TLexeme> lexemes;
+    int end = 0;
+    BOOST_CHECK(!parallel.lex(input, lexemes, end));
+    BOOST_CHECK_EQUAL(input.indexOf('$'), end);
+    BOOST_CHECK_EQUAL(20u * 5 + 3, lexemes.size());
+}
+
+BOOST_AUTO_TEST_CASE(testFailureReportsFarthestExpectations)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, ASSIGNMENT_GRAMMAR);
+
+    QString input("local a = 1;\nlocal b 2;");
+    auto cursor = makeCursor<QChar>(&input);
+    Result<PNode> results;
+    BOOST_REQUIRE(grammar["main"](cursor, results));
+    BOOST_CHECK(cursor);
+
+    auto& failure = cursor.failure();
+    BOOST_REQUIRE(failure);
+    BOOST_CHECK_EQUAL(21, failure.pos());
+    BOOST_CHECK_EQUAL("line 2, column 9: expected '='", failure.describe(input));
+
+    // Lexed parses record the position of the lexeme
+    cursor = makeCursor<QChar>(&input);
+    std::vector<TLexeme> lexemes;
+    BOOST_REQUIRE(grammar.lexer()(cursor, lexemes));
+
+    auto tokens = makeCursor<TLexeme>(&lexemes);
+    BOOST_REQUIRE(grammar.lexed("main")(tokens, results));
+    BOOST_REQUIRE(tokens.failure());
+    BOOST_CHECK_EQUAL(7, tokens.failure().pos());
+    BOOST_CHECK_EQUAL(21, lexemes[tokens.failure().pos()].start);
+    BOOST_CHECK(std::vector<std::string>({"'='"}) == tokens.failure().expected());
+}
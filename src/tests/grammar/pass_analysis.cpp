@@ -0,0 +1,113 @@
+#include <grammar/pass/Analysis.hpp>
+
+#include "grammar.hpp"
+#include "init.hpp"
+
+using namespace sprout;
+using namespace grammar;
+
+namespace {
+
+const char* HAZARD_GRAMMAR =
+    "Group main = statement+;\n"
+    "Group statement = call | assign;\n"
+    "Rule call = name '(' args ')';\n"
+    "Rule assign = name '=' value;\n"
+    "Rule args = {value ','?};\n"
+    "Rule value = name | number;\n"
+    "Rule blanks = space*;\n"
+    "Rule space = ' '?;\n"
+    "Rule names = name* name;\n"
+    "Token name = alpha+;\n";
+
+const pass::Hazard* findHazard(const pass::Analysis& analysis, const pass::HazardKind kind)
+{
+    for (auto& hazard : analysis.hazards()) {
+        if (hazard.kind == kind) {
+            return &hazard;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testAnalysisComputesSets)
+{
+    TGrammar grammar;
+    readGrammar(grammar, HAZARD_GRAMMAR);
+
+    pass::Analysis analysis;
+    analysis(grammar);
+
+    BOOST_CHECK(analysis.nullable("space"));
+    BOOST_CHECK(analysis.nullable("blanks"));
+    BOOST_CHECK(!analysis.nullable("call"));
+
+    BOOST_CHECK(analysis.first("statement") == QSet<QString>({ "name" }));
+    BOOST_CHECK(analysis.first("value") == QSet<QString>({ "name", "number" }));
+    BOOST_CHECK(analysis.first("call") == QSet<QString>({ "name" }));
+
+    BOOST_CHECK(analysis.follow("statement") == QSet<QString>({ "name" }));
+    // The separator of args can be left out, so values can follow values
+    BOOST_CHECK(analysis.follow("value") == QSet<QString>({ "','", "')'", "name", "number" }));
+    BOOST_CHECK(analysis.follow("space") == QSet<QString>({ "' '" }));
+}
+
+BOOST_AUTO_TEST_CASE(testAnalysisReportsHazards)
+{
+    TGrammar grammar;
+    readGrammar(grammar, HAZARD_GRAMMAR);
+
+    pass::Analysis analysis;
+    analysis(grammar);
+    BOOST_CHECK_EQUAL(4, analysis.hazards().size());
+
+    auto overlap = findHazard(analysis, pass::HazardKind::OverlappingAlternatives);
+    BOOST_REQUIRE(overlap);
+    BOOST_CHECK_EQUAL("statement", overlap->rule);
+    BOOST_CHECK_EQUAL("name", overlap->token);
+    BOOST_CHECK_EQUAL(
+        "statement: call | assign: both alternatives can begin with name, "
+        "so the second reparses what the first read (call -> name; assign -> name)",
+        overlap->describe()
+    );
+
+    auto repetition = findHazard(analysis, pass::HazardKind::NullableRepetition);
+    BOOST_REQUIRE(repetition);
+    BOOST_CHECK_EQUAL("blanks", repetition->rule);
+    BOOST_CHECK_EQUAL("space*", repetition->construct);
+    BOOST_CHECK_EQUAL("space -> ' '?", repetition->paths[0].join(" -> "));
+
+    auto separator = findHazard(analysis, pass::HazardKind::NullableSeparator);
+    BOOST_REQUIRE(separator);
+    BOOST_CHECK_EQUAL("args", separator->rule);
+    BOOST_CHECK_EQUAL("{value ','?}", separator->construct);
+
+    auto greedy = findHazard(analysis, pass::HazardKind::GreedyRepetition);
+    BOOST_REQUIRE(greedy);
+    BOOST_CHECK_EQUAL("names", greedy->rule);
+    BOOST_CHECK_EQUAL("name*", greedy->construct);
+    BOOST_CHECK_EQUAL("name", greedy->token);
+
+    // ' ' can follow space, but an optional only reads it once
+    for (auto& hazard : analysis.hazards()) {
+        BOOST_CHECK_NE("space", hazard.rule);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testAnalysisAcceptsSafeGrammar)
+{
+    TGrammar grammar;
+    readGrammar(grammar,
+        "Group main = statement+;\n"
+        "Group statement = call | assign;\n"
+        "Rule call = 'call' name;\n"
+        "Rule assign = 'let' name '=' name;\n"
+        "Token name = alpha+;\n"
+    );
+
+    pass::Analysis analysis;
+    analysis(grammar);
+    BOOST_CHECK(analysis.hazards().isEmpty());
+}
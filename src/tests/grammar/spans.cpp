@@ -0,0 +1,184 @@
+#include <grammar/Lexer.hpp>
+#include <LineIndex.hpp>
+#include <IncrementalParser.hpp>
+
+#include "grammar.hpp"
+#include "init.hpp"
+
+using namespace sprout;
+using namespace grammar;
+
+namespace {
+
+const char* SPAN_GRAMMAR =
+    "Group main = statement+;\n"
+    "Rule statement = 'local' name '=' expression ';';\n"
+    "Group expression = negation | call | name;\n"
+    "Rule negation = '-' expression;\n"
+    "Rule call = name '(' name? ')';\n"
+    "Token name = alpha+;\n";
+
+const QString INPUT("local a = b;\n  local c = - f(x) ;  ");
+
+QString span(const PNode& node)
+{
+    return QString("%1 %2").arg(node.start()).arg(node.end());
+}
+
+/**
+ * Checks the spans of the statements that were parsed from INPUT, which
+ * don't include the trivia around them.
+ */
+void checkSpans(Result<PNode>& results)
+{
+    BOOST_REQUIRE_EQUAL(2, results.size());
+
+    const PNode& first = results[0];
+    BOOST_CHECK_EQUAL("0 12", span(first));
+    BOOST_REQUIRE_EQUAL(2u, first.size());
+    BOOST_CHECK_EQUAL("6 7", span(first[0]));
+    BOOST_CHECK_EQUAL("10 11", span(first[1]));
+
+    const PNode& second = results[1];
+    BOOST_CHECK_EQUAL("15 33", span(second));
+    BOOST_REQUIRE_EQUAL(2u, second.size());
+    BOOST_CHECK_EQUAL("21 22", span(second[0]));
+
+    const PNode& negation = second[1];
+    BOOST_CHECK_EQUAL("negation", negation.type());
+    BOOST_CHECK_EQUAL("25 31", span(negation));
+
+    BOOST_REQUIRE_EQUAL(1u, negation.size());
+    const PNode& call = negation[0];
+    BOOST_CHECK_EQUAL("27 31", span(call));
+    BOOST_REQUIRE_EQUAL(2u, call.size());
+    BOOST_CHECK_EQUAL("27 28", span(call[0]));
+    BOOST_CHECK_EQUAL("29 30", span(call[1]));
+}
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testGrammarRecordsSpans)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, SPAN_GRAMMAR);
+
+    auto cursor = makeCursor<QChar>(&INPUT);
+    Result<PNode> results;
+    BOOST_REQUIRE(grammar["main"](cursor, results));
+    BOOST_CHECK(!cursor);
+    checkSpans(results);
+}
+
+BOOST_AUTO_TEST_CASE(testLexedGrammarRecordsSpans)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, SPAN_GRAMMAR);
+
+    auto cursor = makeCursor<QChar>(&INPUT);
+    std::vector<TLexeme> lexemes;
+    BOOST_REQUIRE(grammar.lexer()(cursor, lexemes));
+
+    auto tokens = makeCursor<TLexeme>(&lexemes);
+    Result<PNode> results;
+    BOOST_REQUIRE(grammar.lexed("main")(tokens, results));
+    BOOST_CHECK(!tokens);
+    checkSpans(results);
+}
+
+BOOST_AUTO_TEST_CASE(testIncrementalParserShiftsSpans)
+{
+    TGrammar grammar;
+    buildGrammar(grammar, SPAN_GRAMMAR);
+
+    auto parser = incrementalParser<QChar, PNode>(grammar["statement"]);
+    BOOST_REQUIRE(parser.parse(INPUT));
+    BOOST_CHECK_EQUAL(2, parser.reparsed());
+
+    // Renaming "a" to "axx" reparses the first statement, and reuses the second
+    BOOST_REQUIRE(parser.edit(7, 0, "xx"));
+    BOOST_CHECK_EQUAL(1, parser.reparsed());
+
+    auto results = parser.results();
+    BOOST_REQUIRE_EQUAL(2, results.size());
+
+    const PNode& first = results[0];
+    BOOST_CHECK_EQUAL("0 14", span(first));
+    BOOST_REQUIRE_EQUAL(2u, first.size());
+    BOOST_CHECK_EQUAL("axx", first[0].value());
+    BOOST_CHECK_EQUAL("6 9", span(first[0]));
+
+    const PNode& second = results[1];
+    BOOST_CHECK_EQUAL("17 35", span(second));
+    BOOST_REQUIRE_EQUAL(2u, second.size());
+    BOOST_CHECK_EQUAL("23 24", span(second[0]));
+
+    const PNode& negation = second[1];
+    BOOST_CHECK_EQUAL("27 33", span(negation));
+    BOOST_REQUIRE_EQUAL(1u, negation.size());
+    BOOST_CHECK_EQUAL("29 33", span(negation[0]));
+    BOOST_REQUIRE_EQUAL(2u, negation[0].size());
+    BOOST_CHECK_EQUAL("31 32", span(negation[0][1]));
+
+    // Shifting the same item again adds to how far it moved
+    BOOST_REQUIRE(parser.edit(12, 1, "bb"));
+    BOOST_CHECK_EQUAL(1, parser.reparsed());
+    auto shifted = parser.results();
+    BOOST_REQUIRE_EQUAL(2, shifted.size());
+    BOOST_CHECK_EQUAL("0 15", span(shifted[0]));
+    BOOST_CHECK_EQUAL("18 36", span(shifted[1]));
+    BOOST_CHECK_EQUAL("32 33", span(shifted[1][1][0][1]));
+}
+
+BOOST_AUTO_TEST_CASE(testSpansEndAtTokensBeforeBacktracking)
+{
+    TGrammar grammar;
+    buildGrammar(grammar,
+        "Group main = statement+;\n"
+        "Group statement = list | mark;\n"
+        "Rule list = name (',' name)*;\n"
+        "Rule mark = ',' '!';\n"
+        "Token name = alpha+;\n"
+    );
+
+    // The last ',' is read by list's repetition, which backtracks when no name
+    // follows it, so the last token that list read is b
+    QString input("a , b , !");
+    auto cursor = makeCursor<QChar>(&input);
+    Result<PNode> results;
+    BOOST_REQUIRE(grammar["main"](cursor, results));
+    BOOST_CHECK(!cursor);
+    BOOST_REQUIRE_EQUAL(2, results.size());
+
+    BOOST_CHECK_EQUAL("list", results[0].type());
+    BOOST_CHECK_EQUAL("0 5", span(results[0]));
+    BOOST_REQUIRE_EQUAL(2u, results[0].size());
+    BOOST_CHECK_EQUAL("4 5", span(results[0][1]));
+
+    BOOST_CHECK_EQUAL("mark", results[1].type());
+    BOOST_CHECK_EQUAL("6 9", span(results[1]));
+}
+
+BOOST_AUTO_TEST_CASE(testLineIndexLocatesOffsets)
+{
+    auto index = lineIndex(INPUT);
+    BOOST_CHECK_EQUAL(2, index.lines());
+
+    int line;
+    int column;
+    index.locate(11, line, column);
+    BOOST_CHECK_EQUAL(0, line);
+    BOOST_CHECK_EQUAL(11, column);
+
+    // The newline is the last character of its line
+    index.locate(12, line, column);
+    BOOST_CHECK_EQUAL(0, line);
+    BOOST_CHECK_EQUAL(12, column);
+
+    index.locate(27, line, column);
+    BOOST_CHECK_EQUAL(1, line);
+    BOOST_CHECK_EQUAL(14, column);
+
+    BOOST_CHECK_EQUAL(1, index.line(INPUT.size()));
+    BOOST_CHECK_EQUAL(2, index.column(15));
+}
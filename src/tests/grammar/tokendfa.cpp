@@ -0,0 +1,106 @@
+#include <grammar/TokenDfa.hpp>
+
+#include "grammar.hpp"
+#include "init.hpp"
+
+using namespace sprout;
+using namespace grammar;
+
+namespace {
+
+const char* TOKEN_GRAMMAR =
+    "Token name = (alpha | '_') ('_' | alnum)*;\n"
+    "Token hex = '0x' alnum+;\n"
+    "Token path = {name '/'};\n"
+    "Token prefix = ('a' | 'ab');\n"
+    "Token quoted = string;\n";
+
+PNode parse(TGrammar& grammar, const char* rule, const QString& input)
+{
+    auto cursor = makeCursor<QChar>(&input);
+    Result<PNode> results;
+    if (!grammar[rule](cursor, results) || results.size() != 1) {
+        return PNode();
+    }
+    return *results;
+}
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testTokenDfaCompilesRegularTokens)
+{
+    TGrammar grammar;
+    readGrammar(grammar, TOKEN_GRAMMAR);
+
+    TokenDfa dfa;
+    BOOST_CHECK(dfa.compile("name", grammar.parsedRules(), grammar.charClasses()));
+    BOOST_CHECK(dfa.compile("hex", grammar.parsedRules(), grammar.charClasses()));
+    BOOST_CHECK(dfa.compile("path", grammar.parsedRules(), grammar.charClasses()));
+
+    // Strings are opaque, so they can't be compiled
+    BOOST_CHECK(!dfa.compile("quoted", grammar.parsedRules(), grammar.charClasses()));
+    BOOST_CHECK(!dfa.compiled());
+}
+
+BOOST_AUTO_TEST_CASE(testTokenDfaTakesLongestMatch)
+{
+    TGrammar grammar;
+    readGrammar(grammar, TOKEN_GRAMMAR);
+
+    TokenDfa dfa;
+    BOOST_REQUIRE(dfa.compile("name", grammar.parsedRules(), grammar.charClasses()));
+
+    QString input("_foo2 bar");
+    auto cursor = makeCursor<QChar>(&input);
+    QString text;
+    BOOST_REQUIRE(dfa(cursor, text));
+    BOOST_CHECK_EQUAL("_foo2", text);
+    BOOST_CHECK_EQUAL(5, cursor.pos());
+
+    ++cursor;
+    BOOST_REQUIRE(dfa(cursor, text));
+    BOOST_CHECK_EQUAL("bar", text);
+    BOOST_CHECK(!cursor);
+
+    QString invalid("2foo");
+    cursor = makeCursor<QChar>(&invalid);
+    BOOST_CHECK(!dfa(cursor, text));
+    BOOST_CHECK_EQUAL(0, cursor.pos());
+}
+
+BOOST_AUTO_TEST_CASE(testCompiledTokensMatchCombinators)
+{
+    TGrammar compiled;
+    compiled.setCompileTokens(true);
+    readGrammar(compiled, TOKEN_GRAMMAR);
+    compiled.build();
+
+    TGrammar combined;
+    readGrammar(combined, TOKEN_GRAMMAR);
+    combined.build();
+
+    BOOST_CHECK_EQUAL(PNode("name", "_foo2"), parse(compiled, "name", "_foo2"));
+    BOOST_CHECK_EQUAL(parse(combined, "name", "_foo2"), parse(compiled, "name", "_foo2"));
+
+    // Literals directly within a sequence are discarded from the text
+    BOOST_CHECK_EQUAL(PNode("hex", "1F"), parse(compiled, "hex", "0x1F"));
+    BOOST_CHECK_EQUAL(parse(combined, "hex", "0x1F"), parse(compiled, "hex", "0x1F"));
+
+    BOOST_CHECK_EQUAL(PNode("path", "usrlocal"), parse(compiled, "path", "usr/local"));
+    BOOST_CHECK_EQUAL(parse(combined, "path", "usr/local"), parse(compiled, "path", "usr/local"));
+}
+
+BOOST_AUTO_TEST_CASE(testCompiledTokensPreferLongerAlternatives)
+{
+    TGrammar compiled;
+    compiled.setCompileTokens(true);
+    readGrammar(compiled, TOKEN_GRAMMAR);
+    compiled.build();
+
+    TGrammar combined;
+    readGrammar(combined, TOKEN_GRAMMAR);
+    combined.build();
+
+    BOOST_CHECK_EQUAL(PNode("prefix", "ab"), parse(compiled, "prefix", "ab"));
+    BOOST_CHECK_EQUAL(PNode("prefix", "a"), parse(combined, "prefix", "ab"));
+}
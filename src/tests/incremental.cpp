@@ -0,0 +1,107 @@
+#include <IncrementalParser.hpp>
+#include <rule/Literal.hpp>
+#include <rule/Multiple.hpp>
+#include <rule/Optional.hpp>
+#include <rule/Predicate.hpp>
+#include <rule/Reduce.hpp>
+#include <rule/Sequence.hpp>
+#include <rule/Discard.hpp>
+
+#include "init.hpp"
+
+using namespace sprout;
+using namespace rule;
+
+namespace {
+
+auto word = aggregate<std::string>(
+    multiple(simplePredicate<char>([](const char& input) {
+        return input >= 'a' && input <= 'z';
+    })),
+    [](std::string& str, const char& c) {
+        str += c;
+    }
+);
+
+auto space = discard(optional(multiple(OrderedLiteral<char, std::string>(" "))));
+
+auto statement = tupleSequence<char, std::string>(
+    word,
+    discard(OrderedLiteral<char, std::string>(";")),
+    space
+);
+
+/**
+ * Checks that the parser agrees with a parse of its text from scratch.
+ */
+template <class Parser>
+void checkMatchesFullParse(Parser& parser)
+{
+    auto full = incrementalParser(statement);
+    BOOST_CHECK_EQUAL(full.parse(parser.text()), parser.successful());
+    BOOST_CHECK_EQUAL(full.pos(), parser.pos());
+
+    auto expected = full.results();
+    auto results = parser.results();
+    BOOST_REQUIRE_EQUAL(expected.size(), results.size());
+    for (int i = 0; i < results.size(); ++i) {
+        BOOST_CHECK_EQUAL(expected[i], results[i]);
+    }
+}
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testIncrementalParserReusesUntouchedItems)
+{
+    auto parser = incrementalParser(statement);
+    BOOST_REQUIRE(parser.parse("foo; bar; baz; qux; quux;"));
+    BOOST_CHECK_EQUAL(5, parser.reparsed());
+
+    // Renaming "baz" reparses its statement, and the one before it, which
+    // looked at its first letter
+    BOOST_CHECK(parser.edit(10, 3, "bazzle"));
+    BOOST_CHECK_EQUAL(2, parser.reparsed());
+    checkMatchesFullParse(parser);
+
+    // Removing the first statement reparses nothing
+    BOOST_CHECK(parser.edit(0, 5, ""));
+    BOOST_CHECK_EQUAL(0, parser.reparsed());
+    checkMatchesFullParse(parser);
+
+    // Appending reparses the last statement, which looked for the end
+    BOOST_CHECK(parser.edit(parser.text().size(), 0, " end;"));
+    BOOST_CHECK_EQUAL(2, parser.reparsed());
+    checkMatchesFullParse(parser);
+}
+
+BOOST_AUTO_TEST_CASE(testIncrementalParserReparsesLookahead)
+{
+    auto parser = incrementalParser(statement);
+    BOOST_REQUIRE(parser.parse("foo; bar;"));
+
+    // Joining the statements skips over the old start of the second
+    BOOST_CHECK(parser.edit(3, 2, ""));
+    BOOST_CHECK_EQUAL(1, parser.reparsed());
+    checkMatchesFullParse(parser);
+
+    BOOST_REQUIRE(parser.parse("foo; bar;"));
+    BOOST_CHECK(!parser.edit(4, 1, "1"));
+    BOOST_CHECK_EQUAL(4, parser.pos());
+    checkMatchesFullParse(parser);
+}
+
+BOOST_AUTO_TEST_CASE(testIncrementalParserRecoversFromFailure)
+{
+    auto parser = incrementalParser(statement);
+    BOOST_CHECK(!parser.parse("foo; 1; bar;"));
+    BOOST_CHECK_EQUAL(5, parser.pos());
+
+    std::vector<TextEdit<char>> edits = {
+        {5, 1, {'o', 'n', 'e'}},
+        {0, 0, {'a', ';', ' '}}
+    };
+    BOOST_CHECK(parser.edit(edits));
+    BOOST_CHECK_EQUAL(1, parser.reparsed());
+    BOOST_CHECK_EQUAL("a; foo; one; bar;", std::string(parser.text().begin(), parser.text().end()));
+    checkMatchesFullParse(parser);
+}
@@ -0,0 +1,104 @@
+#include <StructuralIndex.hpp>
+#include <rule/rules.hpp>
+
+#include "init.hpp"
+
+using namespace sprout;
+
+BOOST_AUTO_TEST_CASE(testStructuralIndexFindsEachKind)
+{
+    // Long enough for both whole and partial words of the bitmaps
+    QString input(QString(70, 'a') + "'\\\n# b -- c");
+    StructuralIndex index(input);
+
+    BOOST_CHECK_EQUAL(70, index.next(StructuralIndex::Quote, 0));
+    BOOST_CHECK_EQUAL(71, index.next(StructuralIndex::Backslash, 0));
+    BOOST_CHECK_EQUAL(72, index.next(StructuralIndex::Newline, 0));
+    BOOST_CHECK_EQUAL(73, index.next(StructuralIndex::CommentStart, 0));
+    BOOST_CHECK_EQUAL(77, index.next(StructuralIndex::CommentStart, 74));
+    BOOST_CHECK_EQUAL(input.size(), index.next(StructuralIndex::CommentStart, 78));
+
+    BOOST_CHECK_EQUAL(70, index.next(StructuralIndex::Quote | StructuralIndex::Newline, 0));
+    BOOST_CHECK_EQUAL(72, index.next(StructuralIndex::Quote | StructuralIndex::Newline, 71));
+
+    BOOST_CHECK_EQUAL(0, index.next(StructuralIndex::NonSpace, 0));
+    BOOST_CHECK_EQUAL(73, index.next(StructuralIndex::NonSpace, 72));
+    BOOST_CHECK_EQUAL(input.size(), index.next(StructuralIndex::NonSpace, input.size()));
+}
+
+BOOST_AUTO_TEST_CASE(testStructuralIndexFindsCommentsAcrossWords)
+{
+    QString input(QString(63, ' ') + "--");
+    StructuralIndex index(input);
+    BOOST_CHECK_EQUAL(63, index.next(StructuralIndex::CommentStart, 0));
+
+    QString single(QString(63, ' ') + "- -");
+    StructuralIndex singleIndex(single);
+    BOOST_CHECK_EQUAL(single.size(), singleIndex.next(StructuralIndex::CommentStart, 0));
+}
+
+BOOST_AUTO_TEST_CASE(testStructuralIndexMapsLinesAndColumns)
+{
+    QString input("ab\n" + QString(100, 'c') + "\nd");
+    StructuralIndex index(input);
+
+    BOOST_CHECK_EQUAL(0, index.line(1));
+    BOOST_CHECK_EQUAL(1, index.column(1));
+
+    BOOST_CHECK_EQUAL(1, index.line(3));
+    BOOST_CHECK_EQUAL(0, index.column(3));
+    BOOST_CHECK_EQUAL(1, index.line(102));
+    BOOST_CHECK_EQUAL(99, index.column(102));
+
+    BOOST_CHECK_EQUAL(2, index.line(104));
+    BOOST_CHECK_EQUAL(0, index.column(104));
+    BOOST_CHECK_EQUAL(2, index.line(input.size()));
+}
+
+BOOST_AUTO_TEST_CASE(testIndexedRulesMatchUnindexedRules)
+{
+    QString input("'a \\\"quoted\\\" \\n \\u0041 \"string\"' " + QString(80, ' ') + "\t -- comment\nrest");
+
+    auto plain = makeCursor<QChar>(&input);
+    auto indexed = makeIndexedCursor<QChar>(&input);
+    BOOST_CHECK(!plain.index());
+    BOOST_REQUIRE(indexed.index());
+
+    Result<QString> plainResult;
+    Result<QString> indexedResult;
+    BOOST_REQUIRE(rule::parseQuotedString(plain, plainResult));
+    BOOST_REQUIRE(rule::parseQuotedString(indexed, indexedResult));
+    BOOST_CHECK_EQUAL(*plainResult, *indexedResult);
+    BOOST_CHECK_EQUAL(plain.pos(), indexed.pos());
+
+    BOOST_CHECK(rule::parseWhitespace(plain, plainResult));
+    BOOST_CHECK(rule::parseWhitespace(indexed, indexedResult));
+    BOOST_CHECK_EQUAL(plain.pos(), indexed.pos());
+
+    auto comment = rule::lineComment("--");
+    plainResult.clear();
+    indexedResult.clear();
+    BOOST_REQUIRE(comment(plain, plainResult));
+    BOOST_REQUIRE(comment(indexed, indexedResult));
+    BOOST_CHECK_EQUAL(" comment", *indexedResult);
+    BOOST_CHECK_EQUAL(plain.pos(), indexed.pos());
+    BOOST_CHECK_EQUAL('\n', *indexed);
+}
+
+BOOST_AUTO_TEST_CASE(testIndexedWhitespaceChecksUnicodeSpaces)
+{
+    QString input(" \t");
+    input += QChar(0xa0);
+    input += "x";
+
+    auto cursor = makeIndexedCursor<QChar>(&input);
+    Result<QString> result;
+    BOOST_CHECK(rule::parseWhitespace(cursor, result));
+    BOOST_CHECK_EQUAL(3, cursor.pos());
+    BOOST_CHECK(!rule::parseWhitespace(cursor, result));
+
+    QString unterminated("'abc");
+    cursor = makeIndexedCursor<QChar>(&unterminated);
+    BOOST_CHECK(!rule::parseQuotedString(cursor, result));
+    BOOST_CHECK_EQUAL(0, cursor.pos());
+}
@@ -0,0 +1,127 @@
+#include <rule/rules.hpp>
+#include <StructuralIndex.hpp>
+
+#include "init.hpp"
+
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+
+using namespace sprout;
+
+namespace {
+
+bool parseDouble(const QString& input, double& value, int& pos, const bool indexed = false)
+{
+    auto cursor = indexed ? makeIndexedCursor<QChar>(&input) : makeCursor<QChar>(&input);
+    Result<double> result;
+    if (!rule::parseFloating(cursor, result)) {
+        return false;
+    }
+    value = *result;
+    pos = cursor.pos();
+    return true;
+}
+
+double parseDouble(const QString& input)
+{
+    double value = 0;
+    int pos = 0;
+    BOOST_REQUIRE(parseDouble(input, value, pos));
+    BOOST_CHECK_EQUAL(input.size(), pos);
+    return value;
+}
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testParseFloatingReadsNumbers)
+{
+    BOOST_CHECK_EQUAL(42.0, parseDouble("42"));
+    BOOST_CHECK_EQUAL(0.5, parseDouble(".5"));
+    BOOST_CHECK_EQUAL(-1.5, parseDouble("-1.5"));
+    BOOST_CHECK_EQUAL(0.1, parseDouble("0.1"));
+    BOOST_CHECK_EQUAL(1e5, parseDouble("1e+5"));
+    BOOST_CHECK_EQUAL(2.5e-3, parseDouble("2.5E-3"));
+    BOOST_CHECK_EQUAL(0.0, parseDouble("0.000"));
+
+    double value;
+    int pos;
+    BOOST_REQUIRE(parseDouble("3.25;", value, pos));
+    BOOST_CHECK_EQUAL(3.25, value);
+    BOOST_CHECK_EQUAL(4, pos);
+
+    BOOST_CHECK(!parseDouble("-.5", value, pos));
+    BOOST_CHECK(!parseDouble("1.", value, pos));
+    BOOST_CHECK(!parseDouble("1e", value, pos));
+    BOOST_CHECK(!parseDouble(".", value, pos));
+    BOOST_CHECK(!parseDouble("-", value, pos));
+    BOOST_CHECK(!parseDouble("", value, pos));
+}
+
+BOOST_AUTO_TEST_CASE(testParseFloatingRoundsCorrectly)
+{
+    // Too many digits, or exponents too large, for the exact fast path
+    BOOST_CHECK_EQUAL(std::strtod("123456789012345678901234567890", nullptr),
+        parseDouble("123456789012345678901234567890"));
+    BOOST_CHECK_EQUAL(std::strtod("0.30000000000000000000001", nullptr),
+        parseDouble("0.30000000000000000000001"));
+    BOOST_CHECK_EQUAL(std::strtod("9007199254740993", nullptr), parseDouble("9007199254740993"));
+    BOOST_CHECK_EQUAL(std::strtod("1.7976931348623157e308", nullptr), parseDouble("1.7976931348623157e308"));
+    BOOST_CHECK_EQUAL(std::strtod("4.9e-324", nullptr), parseDouble("4.9e-324"));
+    BOOST_CHECK_EQUAL(std::numeric_limits<double>::infinity(), parseDouble("1e400"));
+    BOOST_CHECK_EQUAL(0.0, parseDouble("1e-400"));
+    BOOST_CHECK_EQUAL(std::numeric_limits<double>::infinity(), parseDouble("1e99999999999999999999"));
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> digit(0, 9);
+    std::uniform_int_distribution<int> length(1, 25);
+    std::uniform_int_distribution<int> exponent(-330, 310);
+    for (int i = 0; i < 2000; ++i) {
+        std::string text;
+        int whole = length(random);
+        for (int j = 0; j < whole; ++j) {
+            text += '0' + digit(random);
+        }
+        if (i % 2) {
+            text += '.';
+            int fraction = length(random);
+            for (int j = 0; j < fraction; ++j) {
+                text += '0' + digit(random);
+            }
+        }
+        if (i % 3) {
+            text += 'e' + std::to_string(i % 5 ? exponent(random) % 25 : exponent(random));
+        }
+
+        QString input(text.c_str());
+        const double expected = std::strtod(text.c_str(), nullptr);
+        double value;
+        int pos;
+        BOOST_REQUIRE(parseDouble(input, value, pos));
+        BOOST_CHECK_EQUAL(expected, value);
+        BOOST_REQUIRE(parseDouble(input, value, pos, true));
+        BOOST_CHECK_EQUAL(expected, value);
+        BOOST_CHECK_EQUAL(input.size(), pos);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testParseIntegerRejectsOverflow)
+{
+    std::string text = std::to_string(std::numeric_limits<long>::min()) + " " +
+        std::to_string(std::numeric_limits<long>::max()) + " 99999999999999999999 000000000000000000000012";
+    QString input(text.c_str());
+    auto cursor = makeIndexedCursor<QChar>(&input);
+    Result<long> result;
+
+    BOOST_REQUIRE(rule::parseInteger(cursor, result));
+    BOOST_CHECK_EQUAL(std::numeric_limits<long>::min(), result[0]);
+    ++cursor;
+    BOOST_REQUIRE(rule::parseInteger(cursor, result));
+    BOOST_CHECK_EQUAL(std::numeric_limits<long>::max(), result[1]);
+    ++cursor;
+    BOOST_CHECK(!rule::parseInteger(cursor, result));
+    cursor += 21;
+    BOOST_REQUIRE(rule::parseInteger(cursor, result));
+    BOOST_CHECK_EQUAL(12, result[2]);
+}
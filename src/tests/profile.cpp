@@ -0,0 +1,59 @@
+#include <rule/Profile.hpp>
+#include <rule/Literal.hpp>
+#include <rule/Sequence.hpp>
+#include <rule/Alternative.hpp>
+
+#include "init.hpp"
+
+using namespace sprout;
+using namespace rule;
+
+BOOST_AUTO_TEST_CASE(testProfileCountsInvocations)
+{
+    auto profiler = std::make_shared<Profiler>();
+
+    auto rule = profile("cat", profiler, OrderedLiteral<char, std::string>("Cat", "Animal"));
+    Result<std::string> tokens;
+
+    auto cursor = makeCursor<char>("CatDog");
+    BOOST_CHECK(rule(cursor, tokens));
+    BOOST_CHECK(!rule(cursor, tokens));
+
+    auto& stats = profiler->stats("cat");
+    BOOST_CHECK_EQUAL(2, stats.invocations);
+    BOOST_CHECK_EQUAL(1, stats.successes);
+    BOOST_CHECK_EQUAL(1, stats.failures);
+    BOOST_CHECK_EQUAL(3, stats.consumed);
+    BOOST_CHECK_EQUAL(0, stats.rewound);
+}
+
+BOOST_AUTO_TEST_CASE(testProfileRecordsRewoundInput)
+{
+    auto profiler = std::make_shared<Profiler>();
+
+    auto cat = profile("cat", profiler, OrderedLiteral<char, std::string>("Cat", "Cat"));
+    auto dog = profile("dog", profiler, OrderedLiteral<char, std::string>("Dog", "Dog"));
+    auto rule = tupleAlternative<char, std::string>(
+        profile("catcat", profiler, tupleSequence<char, std::string>(cat, cat)),
+        profile("catdog", profiler, tupleSequence<char, std::string>(cat, dog))
+    );
+    Result<std::string> tokens;
+
+    auto cursor = makeCursor<char>("CatDog");
+    BOOST_CHECK(rule(cursor, tokens));
+
+    BOOST_CHECK_EQUAL(1, profiler->stats("catcat").failures);
+    BOOST_CHECK_EQUAL(3, profiler->stats("catcat").rewound);
+
+    BOOST_CHECK_EQUAL(1, profiler->stats("catdog").successes);
+    BOOST_CHECK_EQUAL(6, profiler->stats("catdog").consumed);
+
+    BOOST_CHECK_EQUAL(3, profiler->stats("cat").invocations);
+    BOOST_CHECK_EQUAL(2, profiler->stats("cat").successes);
+
+    auto sorted = profiler->sorted();
+    BOOST_CHECK_EQUAL(4u, sorted.size());
+    for (auto& stats : sorted) {
+        BOOST_CHECK(stats.selfTime <= stats.totalTime);
+    }
+}
@@ -0,0 +1,100 @@
+#include <PushParser.hpp>
+#include <rule/Literal.hpp>
+#include <rule/Multiple.hpp>
+#include <rule/Predicate.hpp>
+#include <rule/Reduce.hpp>
+#include <rule/Sequence.hpp>
+#include <rule/Discard.hpp>
+
+#include "init.hpp"
+
+using namespace sprout;
+using namespace rule;
+
+namespace {
+
+auto word = aggregate<std::string>(
+    multiple(simplePredicate<char>([](const char& input) {
+        return input >= 'a' && input <= 'z';
+    })),
+    [](std::string& str, const char& c) {
+        str += c;
+    }
+);
+
+auto statement = tupleSequence<char, std::string>(
+    word,
+    discard(OrderedLiteral<char, std::string>(";"))
+);
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testChunkedCursorDataRecordsStarvation)
+{
+    ChunkedCursorData<char>* data = new ChunkedCursorData<char>;
+    Cursor<char> cursor(data);
+
+    std::string chunk("ab");
+    data->feed(chunk.begin(), chunk.end());
+
+    BOOST_CHECK_EQUAL('a', *cursor++);
+    BOOST_CHECK(!data->starved());
+    BOOST_CHECK_EQUAL('b', *cursor++);
+    BOOST_CHECK(data->starved());
+    BOOST_CHECK(!cursor);
+
+    data->resetStarved();
+    data->close();
+    ++cursor;
+    BOOST_CHECK(!data->starved());
+}
+
+BOOST_AUTO_TEST_CASE(testPushParserResumesAcrossChunks)
+{
+    auto parser = pushParser(statement);
+
+    BOOST_CHECK(PushStatus::NeedMoreInput == parser.feed("fo"));
+    BOOST_CHECK(!parser.results());
+
+    BOOST_CHECK(PushStatus::NeedMoreInput == parser.feed("o;ba"));
+    BOOST_CHECK_EQUAL(4, parser.pos());
+
+    BOOST_CHECK(PushStatus::NeedMoreInput == parser.feed("r;"));
+    BOOST_CHECK(PushStatus::Done == parser.close());
+
+    auto results = parser.take();
+    BOOST_REQUIRE(results);
+    BOOST_CHECK_EQUAL("foo", *results++);
+    BOOST_CHECK_EQUAL("bar", *results++);
+    BOOST_CHECK(!results);
+}
+
+BOOST_AUTO_TEST_CASE(testPushParserDoesNotCommitAtChunkBoundary)
+{
+    auto parser = pushParser(word);
+
+    BOOST_CHECK(PushStatus::NeedMoreInput == parser.feed("cat"));
+    BOOST_CHECK(!parser.results());
+
+    BOOST_CHECK(PushStatus::NeedMoreInput == parser.feed("dog"));
+    BOOST_CHECK(PushStatus::Done == parser.close());
+
+    auto results = parser.take();
+    BOOST_REQUIRE(results);
+    BOOST_CHECK_EQUAL("catdog", *results++);
+    BOOST_CHECK(!results);
+}
+
+BOOST_AUTO_TEST_CASE(testPushParserFailsOnBadInput)
+{
+    auto parser = pushParser(statement);
+
+    BOOST_CHECK(PushStatus::NeedMoreInput == parser.feed("foo;"));
+    BOOST_CHECK(PushStatus::Failed == parser.feed("42;"));
+    BOOST_CHECK_EQUAL(4, parser.pos());
+
+    auto results = parser.take();
+    BOOST_REQUIRE(results);
+    BOOST_CHECK_EQUAL("foo", *results++);
+    BOOST_CHECK(!results);
+}
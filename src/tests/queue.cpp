@@ -0,0 +1,75 @@
+#include <TokenQueue.hpp>
+#include <rule/Literal.hpp>
+#include <rule/Multiple.hpp>
+#include <rule/Predicate.hpp>
+
+#include "init.hpp"
+
+#include <thread>
+
+using namespace sprout;
+
+BOOST_AUTO_TEST_CASE(testTokenQueuePassesValuesInOrder)
+{
+    auto queue = std::make_shared<TokenQueue<int>>(4);
+    BOOST_CHECK_EQUAL(4u, queue->capacity());
+
+    const int count = 10000;
+    std::thread producer([queue]() {
+        for (int i = 0; i < count; ++i) {
+            queue->push(i);
+        }
+        queue->close();
+    });
+
+    std::vector<int> values;
+    while (queue->popAll(values)) {
+    }
+    producer.join();
+
+    BOOST_REQUIRE_EQUAL(10000u, values.size());
+    for (int i = 0; i < count; ++i) {
+        BOOST_CHECK_EQUAL(i, values[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testTokenQueueStopsProducerWhenCancelled)
+{
+    TokenQueue<int> queue(2);
+    BOOST_CHECK(queue.push(1));
+    BOOST_CHECK(queue.push(2));
+
+    queue.cancel();
+    BOOST_CHECK(!queue.push(3));
+}
+
+BOOST_AUTO_TEST_CASE(testQueueCursorDataWaitsForProducer)
+{
+    auto queue = std::make_shared<TokenQueue<char>>(2);
+    auto data = new QueueCursorData<char>(queue);
+    Cursor<char> cursor(data);
+
+    std::string input("abcdef");
+    std::thread producer([queue, input]() {
+        for (auto c : input) {
+            queue->push(c);
+        }
+        queue->close();
+    });
+
+    auto rule = rule::multiple(rule::simplePredicate<char>([](const char& input) {
+        return input != 'f';
+    }));
+    Result<char> tokens;
+    BOOST_CHECK(rule(cursor, tokens));
+    BOOST_CHECK_EQUAL(5, cursor.pos());
+
+    // Committed input is dropped, but the rest is kept for backtracking
+    data->discardBefore(4);
+    BOOST_CHECK_EQUAL('e', *(cursor - 1));
+    BOOST_CHECK_THROW(*(cursor - 2), std::range_error);
+
+    BOOST_CHECK_EQUAL('f', *cursor++);
+    BOOST_CHECK(!cursor);
+    producer.join();
+}
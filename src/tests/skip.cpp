@@ -0,0 +1,140 @@
+#include <rule/Skip.hpp>
+#include <rule/Literal.hpp>
+#include <rule/rules.hpp>
+
+#include "init.hpp"
+
+using namespace sprout;
+
+namespace {
+
+/**
+ * Returns a skipper for whitespace that counts how often it really runs.
+ */
+rule::Skipper<QChar, QString> countingSkipper(int& runs)
+{
+    auto whitespace = rule::whitespace<QString>();
+    return rule::Proxy<QChar, QString>([whitespace, &runs](Cursor<QChar>& iter, Result<QString>& result) {
+        ++runs;
+        return whitespace(iter, result);
+    });
+}
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testSkipAfterMatch)
+{
+    int runs = 0;
+    auto rule = rule::skip(rule::qLiteral<QString>("local"), countingSkipper(runs));
+
+    QString input("local  \n x");
+    auto cursor = makeCursor<QChar>(&input);
+    Result<QString> tokens;
+    BOOST_CHECK(rule(cursor, tokens));
+    BOOST_CHECK_EQUAL('x', *cursor);
+    BOOST_CHECK_EQUAL(1, runs);
+
+    // Nothing is skipped if the rule fails
+    BOOST_CHECK(!rule(cursor, tokens));
+    BOOST_CHECK_EQUAL('x', *cursor);
+    BOOST_CHECK_EQUAL(1, runs);
+}
+
+BOOST_AUTO_TEST_CASE(testSkipIsRememberedOnBacktrack)
+{
+    int runs = 0;
+    auto skipper = countingSkipper(runs);
+    auto word = rule::skip(rule::qLiteral<QString>("do"), skipper);
+
+    QString input("do   end");
+    auto start = makeCursor<QChar>(&input);
+    for (int i = 0; i < 3; ++i) {
+        auto cursor = start;
+        Result<QString> tokens;
+        BOOST_CHECK(word(cursor, tokens));
+        BOOST_CHECK_EQUAL(5, cursor.pos());
+    }
+    BOOST_CHECK_EQUAL(1, runs);
+
+    // Another skipper doesn't reuse what this one skipped
+    int otherRuns = 0;
+    auto other = rule::skip(rule::qLiteral<QString>("do"), countingSkipper(otherRuns));
+    auto cursor = start;
+    Result<QString> tokens;
+    BOOST_CHECK(other(cursor, tokens));
+    BOOST_CHECK_EQUAL(5, cursor.pos());
+    BOOST_CHECK_EQUAL(1, otherRuns);
+}
+
+BOOST_AUTO_TEST_CASE(testSkipIsRememberedOverSeveralTokens)
+{
+    int runs = 0;
+    auto skipper = countingSkipper(runs);
+    auto word = [&skipper](const char* text) {
+        return rule::skip(rule::qLiteral<QString>(text), skipper);
+    };
+    auto name = word("a");
+    auto dot = word(".");
+    auto field = word("b");
+    auto open = word("(");
+    auto equals = word("=");
+
+    // As "call | assign" would, where both begin with "a.b"
+    auto statement = [&](Cursor<QChar>& orig, Result<QString>& tokens) {
+        auto iter = orig;
+        if (name(iter, tokens) && dot(iter, tokens) && field(iter, tokens) && open(iter, tokens)) {
+            orig = iter;
+            return true;
+        }
+        iter = orig;
+        if (name(iter, tokens) && dot(iter, tokens) && field(iter, tokens) && equals(iter, tokens)) {
+            orig = iter;
+            return true;
+        }
+        return false;
+    };
+
+    QString input("a . \n b  = c");
+    auto cursor = makeCursor<QChar>(&input);
+    Result<QString> tokens;
+    BOOST_CHECK(statement(cursor, tokens));
+    BOOST_CHECK_EQUAL('c', *cursor);
+
+    // Once for each of the four gaps, even though three were backtracked over
+    BOOST_CHECK_EQUAL(4, runs);
+}
+
+BOOST_AUTO_TEST_CASE(testSkippedTriviaIsForgottenWhenDiscarded)
+{
+    ChunkedCursorData<QChar>* data = new ChunkedCursorData<QChar>;
+    Cursor<QChar> cursor(data);
+
+    QString chunk("a   b   c");
+    data->feed(chunk.constData(), chunk.constData() + chunk.size());
+
+    int skipper = 0;
+    data->setSkipped(&skipper, 5, 8);
+    data->setSkipped(&skipper, 1, 4);
+    BOOST_CHECK_EQUAL(4, data->skipped(&skipper, 1));
+    BOOST_CHECK_EQUAL(8, data->skipped(&skipper, 5));
+    BOOST_CHECK_EQUAL(-1, data->skipped(&skipper, 2));
+
+    data->discardBefore(5);
+    BOOST_CHECK_EQUAL(-1, data->skipped(&skipper, 1));
+    BOOST_CHECK_EQUAL(8, data->skipped(&skipper, 5));
+}
+
+BOOST_AUTO_TEST_CASE(testSkipAtEndIsNotRemembered)
+{
+    int runs = 0;
+    auto skipper = countingSkipper(runs);
+
+    QString input("end  ");
+    auto start = makeCursor<QChar>(&input) + 3;
+    for (int i = 0; i < 2; ++i) {
+        auto cursor = start;
+        skipper(cursor);
+        BOOST_CHECK(!cursor);
+    }
+    BOOST_CHECK_EQUAL(2, runs);
+}
@@ -0,0 +1,82 @@
+#include <rule/rules.hpp>
+#include <StructuralIndex.hpp>
+
+#include "init.hpp"
+
+#include <QTextStream>
+
+using namespace sprout;
+
+namespace {
+
+/**
+ * Parses the input as a string from memory, from an index, and from a stream,
+ * checking that each reads the same string up to the same position.
+ */
+bool parseString(const QString& input, QString& value, int& pos)
+{
+    QString copy(input);
+    QTextStream stream(&copy);
+    Cursor<QChar> cursors[] = {
+        makeCursor<QChar>(&input),
+        makeIndexedCursor<QChar>(&input),
+        makeCursor<QChar>(&stream)
+    };
+
+    bool parsed = false;
+    for (int i = 0; i < 3; ++i) {
+        Result<QString> result;
+        bool matched = rule::parseQuotedString(cursors[i], result);
+        if (i == 0) {
+            parsed = matched;
+            value = matched ? *result : QString();
+            pos = cursors[i].pos();
+            continue;
+        }
+        BOOST_CHECK_EQUAL(parsed, matched);
+        BOOST_CHECK_EQUAL(pos, cursors[i].pos());
+        if (parsed && matched) {
+            BOOST_CHECK_EQUAL(value, *result);
+        }
+    }
+    return parsed;
+}
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE(testQuotedStringWithoutEscapes)
+{
+    QString value;
+    int pos;
+    BOOST_REQUIRE(parseString("'a \"quoted\" string' rest", value, pos));
+    BOOST_CHECK_EQUAL("a \"quoted\" string", value);
+    BOOST_CHECK_EQUAL(19, pos);
+
+    BOOST_REQUIRE(parseString("\"\"", value, pos));
+    BOOST_CHECK_EQUAL("", value);
+    BOOST_CHECK_EQUAL(2, pos);
+}
+
+BOOST_AUTO_TEST_CASE(testQuotedStringWithEscapes)
+{
+    QString value;
+    int pos;
+    BOOST_REQUIRE(parseString("'line\\nbreak \\u0041\\u00e9 tail'", value, pos));
+    QString expected("line\nbreak A");
+    expected += QChar(0xe9);
+    expected += " tail";
+    BOOST_CHECK_EQUAL(expected, value);
+    BOOST_CHECK_EQUAL(31, pos);
+}
+
+BOOST_AUTO_TEST_CASE(testQuotedStringFailsWithoutClosingQuote)
+{
+    QString value;
+    int pos;
+    BOOST_CHECK(!parseString("'unterminated", value, pos));
+    BOOST_CHECK(!parseString("'escaped\\'", value, pos));
+    BOOST_CHECK(!parseString("'bad \\u00g1'", value, pos));
+    BOOST_CHECK(!parseString("'short \\u00", value, pos));
+    BOOST_CHECK(!parseString("unquoted", value, pos));
+    BOOST_CHECK_EQUAL(0, pos);
+}
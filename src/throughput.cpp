@@ -0,0 +1,381 @@
+#include <grammar/Grammar.hpp>
+#include <grammar/ParallelLexer.hpp>
+#include <grammar/Pipeline.hpp>
+#include <grammar/Node.hpp>
+#include <grammar/pass/Flatten.hpp>
+#include <grammar/pass/LeftRecursion.hpp>
+
+#include <rule/rules.hpp>
+#include <StructuralIndex.hpp>
+#include <rule/Proxy.hpp>
+#include <rule/Discard.hpp>
+#include <rule/Optional.hpp>
+#include <rule/Multiple.hpp>
+#include <rule/Alternative.hpp>
+
+#include "bench/Harness.hpp"
+
+#include <QString>
+#include <QTextStream>
+#include <QFile>
+
+#include <sys/resource.h>
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+using namespace sprout;
+using namespace grammar;
+
+typedef Grammar<QString, QString> LuaGrammar;
+typedef LuaGrammar::PNode PNode;
+typedef LuaGrammar::LexemeType LuaLexeme;
+
+namespace {
+
+/**
+ * A unit of Lua that is repeated to build synthetic corpora. Each copy has its own
+ * identifiers, so that no two copies are identical.
+ */
+const char* CORPUS_UNIT =
+    "local config%1 = { name = \"item%1\", count = %1, ratio = 0.5, tags = { \"a\", \"b\" } }\n"
+    "\n"
+    "-- Computes something of little consequence\n"
+    "function compute%1(a, b)\n"
+    "    local total = 0\n"
+    "    for i = 1, a do\n"
+    "        total = total + i * b\n"
+    "    end\n"
+    "    if a > b then\n"
+    "        return a - b\n"
+    "    elseif a == b then\n"
+    "        return total\n"
+    "    else\n"
+    "        return compute%1(b, a) + config%1.count\n"
+    "    end\n"
+    "end\n"
+    "\n"
+    "while config%1.count < 10 do\n"
+    "    config%1.count = config%1.count + 1\n"
+    "end\n"
+    "print(compute%1(config%1.count, 2), #config%1.tags, not config%1.ratio)\n"
+    "\n";
+
+QString generateCorpus(const int size)
+{
+    QString corpus;
+    for (int i = 0; corpus.size() < size; ++i) {
+        corpus += QString(CORPUS_UNIT).replace("%1", QString::number(i));
+    }
+    return corpus;
+}
+
+bool readFile(const char* filename, QString& contents)
+{
+    QFile file(filename);
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    QTextStream stream(&file);
+    stream.setCodec("UTF-8");
+    contents = stream.readAll();
+    return true;
+}
+
+void loadGrammar(LuaGrammar& grammar, QString& text)
+{
+    QTextStream stream(&text);
+    auto cursor = makeCursor<QChar>(&stream);
+    grammar.readGrammar(cursor);
+
+    auto flattenPass = pass::Flatten<TokenType, QString>({
+        TokenType::Alternative,
+        TokenType::Sequence
+    });
+    flattenPass(grammar);
+    pass::LeftRecursion()(grammar);
+    flattenPass(grammar);
+    grammar.build();
+    grammar.buildLexer();
+}
+
+long countNodes(const PNode& node)
+{
+    long count = 1;
+    for (auto& child : node.children()) {
+        count += countNodes(child);
+    }
+    return count;
+}
+
+/**
+ * Resets the peak resident set size to what's resident now, so that the next call
+ * to peakRSS() measures only what was run since. Returns false if the peak can't be
+ * reset, as on kernels older than Linux 4.0, in which case peakRSS() is the peak of
+ * the whole process.
+ */
+bool resetPeakRSS()
+{
+    std::ofstream refs("/proc/self/clear_refs");
+    refs << "5";
+    refs.flush();
+    return static_cast<bool>(refs);
+}
+
+/**
+ * Returns the peak resident set size in bytes, since it was last reset.
+ */
+long peakRSS()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stol(line.substr(6)) * 1024L;
+        }
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // Linux reports kilobytes
+    return usage.ru_maxrss * 1024L;
+}
+
+struct Corpus
+{
+    std::string name;
+    QString text;
+};
+
+/**
+ * Parses the corpus once, returning the number of nodes that were produced. Returns
+ * -1 if the corpus was not parsed completely.
+ */
+template <class Parser>
+long verify(Parser& parser, const QString& text)
+{
+    auto cursor = makeCursor<QChar>(&text);
+    Result<PNode> nodes;
+    if (!parser(cursor, nodes) || cursor) {
+        return -1;
+    }
+    long count = 0;
+    while (nodes) {
+        count += countNodes(*nodes++);
+    }
+    return count;
+}
+
+/**
+ * Lexes and then parses the corpus once, returning the number of nodes that were
+ * produced. Returns -1 if the corpus was not lexed and parsed completely.
+ */
+template <class Parser>
+long verifyLexed(const Lexer<PNode>& lexer, Parser& parser, const QString& text)
+{
+    auto cursor = makeCursor<QChar>(&text);
+    std::vector<LuaLexeme> lexemes;
+    if (!lexer(cursor, lexemes)) {
+        return -1;
+    }
+    auto tokens = makeCursor<LuaLexeme>(&lexemes);
+    Result<PNode> nodes;
+    if (!parser(tokens, nodes) || tokens) {
+        return -1;
+    }
+    long count = 0;
+    while (nodes) {
+        count += countNodes(*nodes++);
+    }
+    return count;
+}
+
+} // namespace anonymous
+
+int usage(const char* program)
+{
+    std::cerr << "usage: " << program << " GRAMMAR [FILE...] [--max-size BYTES] [--samples N] [--json FILE]\n";
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    bench::Harness harness;
+    harness.setSamples(5);
+    harness.setWarmup(1);
+    harness.setMinSampleTime(0);
+
+    QString jsonPath;
+    int maxSize = 1 << 20;
+
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if (arg == "--max-size" && hasValue) {
+            maxSize = std::stoi(argv[++i]);
+        } else if (arg == "--samples" && hasValue) {
+            harness.setSamples(std::stoi(argv[++i]));
+        } else if (arg == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (arg.substr(0, 2) == "--") {
+            return usage(argv[0]);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        return usage(argv[0]);
+    }
+
+    LuaGrammar grammar;
+    {
+        QString text;
+        if (!readFile(files[0], text)) {
+            std::cerr << "I couldn't open " << files[0] << " for reading\n";
+            return 1;
+        }
+        loadGrammar(grammar, text);
+    }
+
+    auto ws = rule::discard(rule::optional(rule::multiple(rule::tupleAlternative<QChar, PNode>(
+        rule::whitespace<PNode>(),
+        rule::convert<PNode>(rule::lineComment("--"), [](const QString&) {
+            return PNode();
+        })
+    ))));
+    auto parser = rule::proxySequence<QChar, PNode>(
+        ws,
+        grammar["main"]
+    );
+
+    auto lexedParser = grammar.lexed("main");
+    auto statementParser = grammar.lexed("statement");
+
+    std::vector<Corpus> corpora;
+    for (unsigned int i = 1; i < files.size(); ++i) {
+        Corpus corpus;
+        corpus.name = files[i];
+        if (!readFile(files[i], corpus.text)) {
+            std::cerr << "I couldn't open " << files[i] << " for reading\n";
+            return 1;
+        }
+        corpora.push_back(corpus);
+    }
+    for (int size = 1 << 10; size <= maxSize; size *= 4) {
+        Corpus corpus;
+        corpus.name = "synthetic-" + std::to_string(size / 1024) + "k";
+        corpus.text = generateCorpus(size);
+        corpora.push_back(corpus);
+    }
+
+    for (auto& corpus : corpora) {
+        harness.setGroup(corpus.name);
+
+        const QString& text = corpus.text;
+        long nodes = verify(parser, text);
+        if (nodes < 0) {
+            std::cout << "Failed to parse " << corpus.name << " completely, so it was skipped\n";
+            continue;
+        }
+
+        // Bytes are those of the source as UTF-8, as it would be read from a file,
+        // rather than the UTF-16 that the parser scans, which is twice as large for ASCII
+        long long bytes = text.toUtf8().size();
+
+        // The peak is reset before each backend runs, so it includes the corpus and
+        // grammar that are already resident, but not what earlier runs allocated
+        bool peakIsPerRun = resetPeakRSS();
+        auto report = [&]() {
+            auto& measurement = harness.measurements().back();
+            double seconds = measurement.median / 1e9;
+            double megabytes = bytes / (1024.0 * 1024.0);
+            long peak = peakRSS();
+
+            harness.setMetric("MBps", megabytes / seconds);
+            harness.setMetric("nodesPerSecond", nodes / seconds);
+            harness.setMetric(peakIsPerRun ? "peakRSS" : "processPeakRSS", peak);
+
+            auto flags = std::cout.flags();
+            std::cout << std::fixed << std::setprecision(2)
+                << std::setw(20) << megabytes / seconds << " MB/s"
+                << std::setw(14) << std::setprecision(0) << nodes / seconds << " nodes/s"
+                << std::setw(10) << peak / (1024 * 1024)
+                << (peakIsPerRun ? " MB peak RSS\n" : " MB process peak RSS\n");
+            std::cout.flags(flags);
+
+            peakIsPerRun = resetPeakRSS();
+        };
+
+        harness.run("QString", [&]() {
+            auto cursor = makeCursor<QChar>(&text);
+            Result<PNode> results;
+            parser(cursor, results);
+        }, bytes);
+        report();
+
+        harness.run("Indexed", [&]() {
+            auto cursor = makeIndexedCursor<QChar>(&text);
+            Result<PNode> results;
+            parser(cursor, results);
+        }, bytes);
+        report();
+
+        harness.run("QTextStream", [&]() {
+            QString copy(text);
+            QTextStream stream(&copy);
+            auto cursor = makeCursor<QChar>(&stream);
+            Result<PNode> results;
+            parser(cursor, results);
+        }, bytes);
+        report();
+
+        // Keywords can't be used as names once they're lexed, so not every corpus
+        // that parses by character can be lexed
+        if (verifyLexed(grammar.lexer(), lexedParser, text) < 0) {
+            std::cout << "Failed to lex and parse " << corpus.name << " completely, so the lexed runs were skipped\n";
+            continue;
+        }
+        harness.run("Lexed", [&]() {
+            auto cursor = makeCursor<QChar>(&text);
+            std::vector<LuaLexeme> lexemes;
+            grammar.lexer()(cursor, lexemes);
+
+            auto tokens = makeCursor<LuaLexeme>(&lexemes);
+            Result<PNode> results;
+            lexedParser(tokens, results);
+        }, bytes);
+        report();
+
+        harness.run("Pipelined", [&]() {
+            auto cursor = makeCursor<QChar>(&text);
+            Result<PNode> results;
+            parsePipelined(grammar.lexer(), cursor, statementParser, results);
+        }, bytes);
+        report();
+
+        ParallelLexer<PNode> parallelLexer(grammar.lexer());
+        harness.run("ParallelLexed", [&]() {
+            std::vector<LuaLexeme> lexemes;
+            parallelLexer(text, lexemes);
+
+            auto tokens = makeCursor<LuaLexeme>(&lexemes);
+            Result<PNode> results;
+            lexedParser(tokens, results);
+        }, bytes);
+        report();
+    }
+
+    if (!jsonPath.isNull() && !harness.writeJson(jsonPath)) {
+        std::cerr << "I couldn't write benchmark results to " << jsonPath.toUtf8().constData() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+// vim: set ts=4 sw=4 :